@@ -1,6 +1,48 @@
 #pragma once
 
+#include "file_descriptor.hh"
 #include "socket.hh"
+#include "tcp_minnow_socket.hh"
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
 
 //! Copy socket input/output to stdin/stdout until finished
 void bidirectional_stream_copy( Socket& socket, std::string_view peer_name );
+
+//! Copy a TCPMinnowSocket's input/output to stdin/stdout until finished (a TCPMinnowSocket is not a file
+//! descriptor to poll, so stdin is copied by a thread of its own, with blocking calls)
+template<TCPDatagramAdapter AdaptT>
+void bidirectional_stream_copy( TCPMinnowSocket<AdaptT>& socket, std::string_view peer_name )
+{
+  constexpr size_t buffer_size = 1048576;
+
+  std::thread outbound( [&] {
+    FileDescriptor input { STDIN_FILENO };
+    std::string data;
+    while ( not input.eof() ) {
+      data.resize( buffer_size );
+      input.read( data );
+      if ( socket.write( data ) < data.size() ) {
+        break; // the connection can no longer send
+      }
+    }
+    socket.shutdown( SHUT_WR );
+    std::cerr << "DEBUG: Outbound stream to " << peer_name << " finished.\n";
+  } );
+
+  FileDescriptor output { STDOUT_FILENO };
+  std::string data;
+  while ( not socket.eof() ) {
+    data.resize( buffer_size );
+    socket.read( data );
+    output.write_all( data );
+  }
+  output.close();
+  std::cerr << "DEBUG: Inbound stream from " << peer_name << " finished.\n";
+
+  outbound.join();
+}
@@ -54,6 +54,19 @@ ttest(send_close)
 ttest(send_retx)
 ttest(send_extra)
 
+ttest(peer_delayed_ack)
+ttest(peer_receive_batch)
+ttest(peer_header_prediction)
+ttest(peer_memory_pressure)
+
+ttest(stack_connect)
+ttest(stack_four_tuple)
+ttest(stack_listen)
+ttest(syn_cookie)
+ttest(timer_wheel)
+ttest(byte_ring)
+ttest(socket_read_write)
+
 ttest(net_interface)
 
 ttest(router)
@@ -94,3 +107,10 @@ set_tests_properties(${compile_name_opt} PROPERTIES FIXTURES_SETUP compile_opt)
 
 stest(byte_stream_speed_test)
 stest(reassembler_speed_test)
+stest(tcp_sender_speed_test)
+stest(tcp_receiver_speed_test)
+stest(tcp_peer_speed_test)
+stest(tcp_minnow_socket_speed_test)
+stest(tcp_ecn_speed_test)
+stest(tcp_minnow_stack_speed_test)
+stest(tcp_timer_speed_test)
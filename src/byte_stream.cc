@@ -1,16 +1,17 @@
 #include "byte_stream.hh"
+
+#include <algorithm>
+
 using namespace std;
 
-ByteStream::ByteStream( uint64_t capacity ) : capacity_( capacity ), buffer( capacity, '\0' ){
-  buffer.clear();
-}
+ByteStream::ByteStream( uint64_t capacity ) : capacity_( capacity ), buffer() {}
 
 bool Writer::is_closed() const
 {
   return this->is_close;
 }
 
-void Writer::push( string data )
+void Writer::push( string_view data )
 {
   // Your code here.
   if ( this->error_ || this->is_closed() || ( this->available_capacity() <= 0 ) ) {
@@ -18,9 +19,15 @@ void Writer::push( string data )
   }
 
   uint64_t space_left = this->available_capacity();
+  // (data 只是视图：从中直接追加进 buffer，调用者不必先复制出一个临时字符串)
   if ( data.size() > space_left ) {
     data = data.substr( 0, space_left );
   }
+  // 若追加会超出已分配的空间，先删掉已释放的前缀，避免 buffer 增长；仍不够时按块扩容
+  if ( this->buffer.size() + data.size() > this->buffer.capacity() ) {
+    this->discard_head( true );
+    this->reserve_for( this->buffer.size() + data.size() );
+  }
   this->buffer.append( data );
   this->pushed += data.size();
 }
@@ -33,8 +40,26 @@ void Writer::close()
 
 uint64_t Writer::available_capacity() const
 {
+  return this->moderate_ ? this->available_within_budget() : this->room();
+}
 
-  return this->capacity_ - buffer.size();
+uint64_t Writer::available_within_budget() const
+{
+  // 内存预算紧张时：soft 只能写进已经持有的内存，hard 只能写到 MIN_BUFFER (都至少有 MIN_BUFFER)
+  const uint64_t available = this->room();
+  if ( available == 0 ) {
+    return 0;
+  }
+  const MemoryBudget::Pressure pressure = MemoryBudget::process().pressure();
+  if ( pressure == MemoryBudget::Pressure::None ) {
+    return available;
+  }
+  uint64_t held = MemoryBudget::MIN_BUFFER;
+  if ( pressure == MemoryBudget::Pressure::Soft ) {
+    held = max<uint64_t>( held, buffer.capacity() );
+  }
+  const uint64_t used = buffer.size() - head_;
+  return min( available, held > used ? held - used : 0 );
 }
 
 uint64_t Writer::bytes_pushed() const
@@ -44,7 +69,7 @@ uint64_t Writer::bytes_pushed() const
 }
 bool Reader::is_finished() const
 {
-  return this->is_close && ( buffer.size() == 0 );
+  return this->is_close && ( this->bytes_buffered() == 0 );
 }
 
 uint64_t Reader::bytes_popped() const
@@ -57,7 +82,7 @@ string_view Reader::peek() const
 {
   if ( this->is_finished() )
     return {};
-  return std::string_view( this->buffer.data(), this->bytes_buffered() );
+  return std::string_view( this->buffer.data() + head_ + retained_, this->bytes_buffered() );
 }
 
 void Reader::pop( uint64_t len )
@@ -69,11 +94,111 @@ void Reader::pop( uint64_t len )
   if ( len > this->bytes_buffered() ) {
     len = this->bytes_buffered();
   }
-  this->buffer.erase( 0, len );
   this->poped += len;
+  if ( this->retain_ ) {
+    this->retained_ += len;
+    return;
+  }
+  this->head_ += len;
+  this->discard_head( false );
+}
+
+string_view Reader::retained() const
+{
+  return std::string_view( this->buffer.data() + head_, retained_ );
+}
+
+void Reader::release( uint64_t len )
+{
+  len = std::min( len, this->retained_ );
+  this->retained_ -= len;
+  this->head_ += len;
+  this->discard_head( false );
+}
+
+uint64_t ByteStream::room() const
+{
+  // 容量可能被缩小到已占用的字节数以下
+  const uint64_t used = buffer.size() - head_;
+  return used < capacity_ ? capacity_ - used : 0;
+}
+
+void ByteStream::set_capacity( uint64_t capacity )
+{
+  capacity_ = capacity;
+  // 增长时不预先分配 (append 按几何级数扩容)；收缩时只有已分配的空间远大于需要时才重新分配一次
+  const uint64_t live = buffer.size() - head_;
+  const uint64_t needed = max( capacity, live );
+  if ( buffer.capacity() > 2 * needed ) {
+    reallocate( needed );
+  }
+}
+
+void ByteStream::shrink_to_fit()
+{
+  discard_head( true );
+  if ( buffer.empty() ) {
+    string {}.swap( buffer );
+  } else {
+    buffer.shrink_to_fit();
+  }
+  charge_.set( memory_usage() );
+}
+
+uint64_t ByteStream::memory_usage() const
+{
+  return string_memory_usage( buffer );
+}
+
+void ByteStream::reserve_for( uint64_t size )
+{
+  // 至少翻倍 (均摊 O(1))，取整到 CHUNK_SIZE，但不超过容量需要的大小；内存预算紧张时只增长需要的部分
+  uint64_t wanted = size;
+  if ( MemoryBudget::process().pressure() == MemoryBudget::Pressure::None ) {
+    wanted = max<uint64_t>( size, 2 * buffer.capacity() );
+  }
+  const uint64_t chunks = ( wanted + CHUNK_SIZE - 1 ) / CHUNK_SIZE * CHUNK_SIZE;
+  buffer.reserve( min( chunks, max( capacity_, size ) ) );
+  charge_.set( memory_usage() );
+}
+
+void ByteStream::reallocate( uint64_t size )
+{
+  string moved;
+  moved.reserve( size );
+  moved.append( buffer, head_ );
+  buffer.swap( moved );
+  head_ = 0;
+  charge_.set( memory_usage() );
+}
+
+void ByteStream::trim_if_pressured()
+{
+  // 超过内存预算的硬限制时，已分配的空间远大于剩余字节就立即归还 (读空时全部归还)，不等流读空或空闲
+  if ( buffer.capacity() <= MemoryBudget::MIN_BUFFER
+       || MemoryBudget::process().pressure() != MemoryBudget::Pressure::Hard ) {
+    return;
+  }
+  const uint64_t live = buffer.size() - head_;
+  if ( live == 0 ) {
+    string {}.swap( buffer );
+    head_ = 0;
+    charge_.set( 0 );
+  } else if ( buffer.capacity() > 2 * live + MemoryBudget::MIN_BUFFER ) {
+    reallocate( live );
+  }
+}
+
+void ByteStream::discard_head( bool force )
+{
+  if ( head_ > 0 && ( force || head_ >= buffer.size() - head_ ) ) {
+    buffer.erase( 0, head_ );
+    head_ = 0;
+    trim_if_pressured();
+  }
 }
 
 uint64_t Reader::bytes_buffered() const
 {
-  return buffer.size();
+  return buffer.size() - head_ - retained_;
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "memory_budget.hh"
+
 #include <cstdint>
 #include <string>
 #include <string_view>
@@ -21,24 +23,68 @@ public:
   void set_error() { error_ = true; };       // Signal that the stream suffered an error.
   bool has_error() const { return error_; }; // Has the stream had an error?
 
+  // While retention is on, popped bytes stay in the stream (and keep using its capacity) until released.
+  void set_retain( bool retain ) { retain_ = retain; }
+
+  // While the process's MemoryBudget is under pressure, a stream's share of it is the memory the stream already
+  // holds (past the hard limit, only MemoryBudget::MIN_BUFFER bytes). With moderation on, like a send buffer,
+  // pushes are held to that share.
+  void set_moderate( bool moderate ) { moderate_ = moderate; }
+
+  // Change the capacity at run time. Shrinking below what is already buffered only stops further pushes
+  // until enough has been popped; memory is returned only when the allocation is well above the new capacity.
+  void set_capacity( uint64_t capacity );
+  uint64_t capacity() const { return capacity_; }
+
+  // Return the memory that the buffered (and retained) bytes do not need; all of it, once none are left.
+  // The capacity is unchanged: later pushes allocate again.
+  void shrink_to_fit();
+
+  // Memory is allocated only as bytes are buffered, CHUNK_SIZE at a time (at least doubling), never the whole
+  // capacity up front; a new stream uses none, and shrink_to_fit() on a drained one returns all of it.
+  static constexpr uint64_t CHUNK_SIZE = 4096;
+
+  // Heap memory held by the stream (in bytes); it is charged to MemoryBudget::process()
+  uint64_t memory_usage() const;
+
 protected:
   // Please add any additional state to the ByteStream here, and not to the Writer and Reader interfaces.
   uint64_t capacity_;
   bool error_ {false};
   bool is_close {false};
+  bool retain_ {false};
+  bool moderate_ {false};
+  // buffer 布局: [已释放 (head_ 字节) | 已 pop 但保留 (retained_ 字节) | 未读]
+  // 已释放的前缀延迟到它不小于剩余部分时才一次性删除，pop 的均摊代价为 O(1)
   std::string buffer;
-  uint32_t pushed = 0;
-  uint32_t poped = 0;
+  uint64_t head_ {0};
+  uint64_t retained_ {0};
+  uint64_t pushed = 0;
+  uint64_t poped = 0;
+  MemoryCharge charge_ {};
+
+  uint64_t room() const;
+  void discard_head( bool force );
+  void reserve_for( uint64_t size );
+  void reallocate( uint64_t size );
+  void trim_if_pressured();
 };
 
+// Heap memory held by a string (none while its contents fit in the string object itself)
+inline uint64_t string_memory_usage( const std::string& str )
+{
+  return str.capacity() > std::string {}.capacity() ? str.capacity() + 1 : 0;
+}
+
 class Writer : public ByteStream
 {
 public:
-  void push( std::string data ); // Push data to stream, but only as much as available capacity allows.
-  void close();                  // Signal that the stream has reached its ending. Nothing more will be written.
+  void push( std::string_view data ); // Push data to stream, but only as much as available capacity allows.
+  void close();                       // Signal that the stream has reached its ending. Nothing more will be written.
 
   bool is_closed() const;              // Has the stream been closed?
   uint64_t available_capacity() const; // How many bytes can be pushed to the stream right now?
+  uint64_t available_within_budget() const; // How many of those fit in the stream's share of MemoryBudget?
   uint64_t bytes_pushed() const;       // Total number of bytes cumulatively pushed to the stream
 };
 
@@ -51,6 +97,9 @@ public:
   bool is_finished() const;        // Is the stream finished (closed and fully popped)?
   uint64_t bytes_buffered() const; // Number of bytes currently buffered (pushed and not popped)
   uint64_t bytes_popped() const;   // Total number of bytes cumulatively popped from stream
+
+  std::string_view retained() const; // Bytes popped but not yet released (only with retention on)
+  void release( uint64_t len );      // Free the first `len` retained bytes
 };
 
 /*
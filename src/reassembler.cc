@@ -23,43 +23,110 @@ void Reassembler::insert( uint64_t first_index, string data, bool is_last_substr
 
       uint64_t trunncated_end = min(end,max_capacity);
       uint64_t trunncated_start = start;
-      string truncated_data = data;
 
       if(end > max_capacity){
         const size_t truncated_size = max_capacity - start + 1;
-        truncated_data = data.substr(0,truncated_size);
+        data.resize(truncated_size);
         is_last_substring = false;
       }
       //
+      // last_index 是流结束的位置 (最后一个字节之后)，与空 FIN 报文的情况一致
       if(is_last_substring){
         is_last_ = true;
-        last_index = trunncated_end;
+        last_index = trunncated_end + 1;
       }
       //first condition
       if(trunncated_start > next_index){
-        this->add_to_buffer(trunncated_start,truncated_data);
+        // 超过内存预算的硬限制时不缓存乱序数据，已经缓存的也丢掉 (对端会重传)
+        if(MemoryBudget::process().pressure() == MemoryBudget::Pressure::Hard){
+          this->prune_if_pressured();
+          return;
+        }
+        this->add_to_buffer(trunncated_start,data);
+        this->update_charge();
         return;
       }
+      // 按顺序到达的数据直接移动进输出流，不产生临时副本
       const size_t offset = next_index - trunncated_start;
-      const string data_to_write = truncated_data.substr(offset);
-      output_.writer().push(data_to_write);
-      next_index += data_to_write.size();
+      data.erase(0,offset);
+      next_index += data.size();
+      output_.writer().push(std::move(data));
       
       this->flush_buffer_to_output();
+      this->prune_if_pressured();
+      this->update_charge();
 
       this->check_and_close();
 
 }
 
 
+bool Reassembler::insert_next( string& data )
+{
+  // 只在没有乱序数据、流的结尾未知且数据能整段写入时走快速路径
+  if(!buffer_.empty() || is_last_ || output_.writer().has_error()
+     || data.size() > output_.writer().available_capacity()){
+    return false;
+  }
+  next_index += data.size();
+  output_.writer().push(std::move(data));
+  return true;
+}
+
 uint64_t Reassembler::count_bytes_pending() const
 {
   // Your code here.
-  uint64_t total = 0;
-  for(const auto& p : buffer_){
-    total += p.second.size();
+  return bytes_pending_;
+}
+
+uint64_t Reassembler::memory_usage() const
+{
+  return output_.memory_usage() + stored_memory_;
+}
+
+uint64_t Reassembler::node_memory(const string& data)
+{
+  // 每个缓存的子串占一个红黑树节点 (节点头为颜色加三个指针) 加上字符串本身的堆内存
+  return 4 * sizeof(void*) + sizeof(std::pair<const int64_t,std::string>) + string_memory_usage(data);
+}
+
+std::map<int64_t,std::string>::iterator Reassembler::store(int64_t start,string data)
+{
+  auto [it,inserted] = buffer_.try_emplace(start);
+  if(!inserted){
+    bytes_pending_ -= it->second.size();
+    stored_memory_ -= node_memory(it->second);
+  }
+  it->second = std::move(data);
+  bytes_pending_ += it->second.size();
+  stored_memory_ += node_memory(it->second);
+  return it;
+}
+
+std::map<int64_t,std::string>::iterator Reassembler::unstore(std::map<int64_t,std::string>::iterator it)
+{
+  bytes_pending_ -= it->second.size();
+  stored_memory_ -= node_memory(it->second);
+  return buffer_.erase(it);
+}
+
+void Reassembler::update_charge()
+{
+  // MemoryCharge 只把与上次的差额计入预算
+  charge_.set(stored_memory_);
+}
+
+void Reassembler::prune_if_pressured()
+{
+  // 类似 Linux 的 tcp_prune_ofo_queue：内存预算超过硬限制时，归还所有缓存的乱序子串
+  // (它们仍在通告的窗口内，对端会重传；已收到的流结尾位置保留)
+  if(buffer_.empty() || MemoryBudget::process().pressure() != MemoryBudget::Pressure::Hard){
+    return;
   }
-  return total;
+  buffer_.clear();
+  bytes_pending_ = 0;
+  stored_memory_ = 0;
+  this->update_charge();
 }
 
 void Reassembler::add_to_buffer(uint64_t start,const string& data){
@@ -70,14 +137,12 @@ void Reassembler::add_to_buffer(uint64_t start,const string& data){
   auto it = buffer_.find(start);
   if( it != buffer_.end() ){
     if(data.size() > it->second.size()){
-      buffer_[start] = data;
-      it = buffer_.find(start);
+      it = store(start,data);
     }else{
       return ;
     }
   }else{
-    buffer_[start] = data;
-    it = buffer_.find(start);
+    it = store(start,data);
   }
 
   if(it != buffer_.begin()){
@@ -85,16 +150,15 @@ void Reassembler::add_to_buffer(uint64_t start,const string& data){
     uint64_t prev_end = prev->first + prev->second.size() -1;
     if(prev_end >= start -1){
       if(prev_end >= end){
-        buffer_.erase(it);
+        unstore(it);
         return ;
       }
       uint64_t offset = prev_end - start + 1;
       start = prev->first;
       end = max(end,prev_end);
       string merged = prev->second + data.substr(offset);
-      buffer_.erase(prev);
-      buffer_[start] = merged;
-      it = buffer_.find(start);
+      unstore(it);
+      it = store(start,std::move(merged));
     }
   }
 
@@ -104,18 +168,14 @@ void Reassembler::add_to_buffer(uint64_t start,const string& data){
   while(it != buffer_.end() && static_cast<uint64_t>(it->first) <= static_cast<uint64_t>(end + 1)){
     uint64_t curr_end = it->first + it->second.size() -1;
     if(curr_end <= end){
-      buffer_.erase(it);
-      it = buffer_.find(start);
-      ++it;
+      it = unstore(it);
       continue;
     }
     uint64_t offset = end - it->first + 1;
     string merged = buffer_[start]  + it->second.substr(offset);
     end = max(end,curr_end);
-    buffer_.erase(it);
-    buffer_[start] = merged;
-    it = buffer_.find(start);
-    ++it;
+    it = unstore(it);
+    store(start,std::move(merged));
   }
 
 
@@ -137,7 +197,7 @@ void Reassembler::flush_buffer_to_output(){
     const string &data = it->second;
     const size_t offset = next_index - start;
     if(offset >= data.size()){
-      buffer_.erase(it);
+      unstore(it);
       continue;
     }
     const string data_to_write = data.substr(offset);
@@ -145,10 +205,10 @@ void Reassembler::flush_buffer_to_output(){
     next_index += data_to_write.size();
     if(offset + data_to_write.size() < data.size()){
       // judge if there is remaining data
-      buffer_[start + offset + data_to_write.size()] = data.substr(offset + data_to_write.size());
+      store(start + offset + data_to_write.size(),data.substr(offset + data_to_write.size()));
     }
 
-    buffer_.erase(it);
+    unstore(it);
 }
 }
 
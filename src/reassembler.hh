@@ -33,6 +33,13 @@ public:
    */
   void insert( uint64_t first_index, std::string data, bool is_last_substring );
 
+  /*
+   * Fast path for the next substring in order: if nothing is stored in the Reassembler, the end of the stream
+   * is not yet known, and all of `data` fits in the available capacity, write it to the output and return true.
+   * Otherwise do nothing and return false (the caller should use insert()).
+   */
+  bool insert_next( std::string& data );
+
   // How many bytes are stored in the Reassembler itself?
   uint64_t count_bytes_pending() const;
 
@@ -49,10 +56,28 @@ public:
   void set_error(){
     output_.writer().set_error();
   }
+  // 归还输出流多余的内存 (缓存的子串在 map 的节点里，本来就是按需分配的)
+  void shrink_to_fit(){
+    output_.shrink_to_fit();
+  }
+  // Heap memory held by the output stream and the stored substrings (in bytes); both are charged to
+  // MemoryBudget::process(). Past the budget's hard limit, out-of-order substrings are not stored, and those
+  // already stored are dropped.
+  uint64_t memory_usage() const;
 private:
   ByteStream output_; // the Reassembler writes to this ByteStream
   uint64_t next_index = 0;
   std::map<int64_t,std::string> buffer_;
+  // 缓存子串的字节数和占用的堆内存，随每次放入和删除增减 (不用每次遍历 buffer_)
+  uint64_t bytes_pending_ = 0;
+  uint64_t stored_memory_ = 0;
+  MemoryCharge charge_ {};
+  static uint64_t node_memory(const string& data);
+  // buffer_ 只通过这两个函数修改：放入 (或替换) start 处的子串，删除一个子串并返回它的下一个
+  std::map<int64_t,std::string>::iterator store(int64_t start,string data);
+  std::map<int64_t,std::string>::iterator unstore(std::map<int64_t,std::string>::iterator it);
+  void update_charge();
+  void prune_if_pressured();
   bool is_last_ = false;
   uint64_t last_index = 0;
 };
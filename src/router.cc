@@ -57,11 +57,52 @@ void Router::route()
         Address next_hop = best_match->next_hop.has_value() 
                            ? best_match->next_hop.value() 
                            : Address::from_ipv4_numeric( dst_ip );
-        interface( best_match->interface_num )->send_datagram( dgram, next_hop );
+        forward( best_match->interface_num, std::move( dgram ), next_hop );
       }else{
 
       }
     }
   }
+
+  // 每个输出队列本轮最多发出 rate 个数据报
+  for(auto& [interface_num, output]: output_queues_){
+    for(size_t i = 0; i < output.rate && !output.datagrams.empty(); i++){
+      auto& [dgram, next_hop] = output.datagrams.front();
+      interface( interface_num )->send_datagram( std::move( dgram ), next_hop );
+      output.datagrams.pop();
+    }
+  }
   debug( "unimplemented route() called" );
 }
+
+void Router::set_output_queue( const size_t interface_num,
+                               const size_t rate,
+                               const size_t capacity,
+                               const size_t ecn_threshold )
+{
+  output_queues_.insert_or_assign( interface_num, OutputQueue { rate, capacity, ecn_threshold } );
+}
+
+void Router::forward( const size_t interface_num, InternetDatagram dgram, const Address& next_hop )
+{
+  auto it = output_queues_.find( interface_num );
+  if(it == output_queues_.end()){
+    interface( interface_num )->send_datagram( std::move( dgram ), next_hop );
+    return;
+  }
+
+  OutputQueue& output = it->second;
+  if(output.datagrams.size() >= output.capacity){
+    datagrams_dropped_++;
+    return;
+  }
+  // 队列超过阈值：ECN-capable 的数据报标记 CE (而不是等到队列溢出再丢包)
+  const uint8_t ecn = dgram.header.ecn();
+  if(output.datagrams.size() >= output.ecn_threshold
+     && (ecn == IPv4Header::ECN_ECT0 || ecn == IPv4Header::ECN_ECT1)){
+    dgram.header.set_ecn( IPv4Header::ECN_CE );
+    dgram.header.compute_checksum();
+    datagrams_marked_++;
+  }
+  output.datagrams.emplace( std::move( dgram ), next_hop );
+}
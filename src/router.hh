@@ -3,7 +3,11 @@
 #include "exception.hh"
 #include "network_interface.hh"
 
+#include <limits>
+#include <map>
 #include <optional>
+#include <queue>
+#include <utility>
 
 // \brief A router that has multiple network interfaces and
 // performs longest-prefix-match routing between them.
@@ -31,6 +35,19 @@ public:
   // Route packets between the interfaces
   void route();
 
+  // Give an interface an output queue, like a router port in front of a slower link: each route() sends at most
+  // `rate` datagrams out of the interface and queues the rest, up to `capacity` datagrams (tail drop beyond).
+  // Once `ecn_threshold` datagrams are queued, an ECN-capable datagram that joins the queue is marked
+  // Congestion Experienced (RFC 3168) instead, telling its sender to slow down before the queue overflows.
+  void set_output_queue( size_t interface_num,
+                         size_t rate,
+                         size_t capacity,
+                         size_t ecn_threshold = std::numeric_limits<size_t>::max() );
+
+  // Output queue statistics: datagrams dropped because a queue was full, and datagrams marked CE
+  uint64_t datagrams_dropped() const { return datagrams_dropped_; }
+  uint64_t datagrams_marked() const { return datagrams_marked_; }
+
 private:
   struct RouteEnrty{
     uint32_t route_prefix;
@@ -40,6 +57,19 @@ private:
   };
   std::vector<RouteEnrty> route_table_{};
 
+  // 输出队列：没有设置的接口直接发送
+  struct OutputQueue{
+    size_t rate;
+    size_t capacity;
+    size_t ecn_threshold;
+    std::queue<std::pair<InternetDatagram, Address>> datagrams {};
+  };
+  std::map<size_t, OutputQueue> output_queues_{};
+  uint64_t datagrams_dropped_{0};
+  uint64_t datagrams_marked_{0};
+
+  void forward( size_t interface_num, InternetDatagram dgram, const Address& next_hop );
+
   // first i need to maintain a table of the 
   // The router's collection of network interfaces
   std::vector<std::shared_ptr<NetworkInterface>> interfaces_ {};
@@ -0,0 +1,4 @@
+#include "tcp_minnow_stack_impl.hh"
+
+//! Specialization of TCPMinnowStack for IPv4OverTunFdDevice
+template class TCPMinnowStack<IPv4OverTunFdDevice>;
@@ -1,5 +1,6 @@
 #include "tcp_receiver.hh"
 #include "debug.hh"
+#include "ipv4_header.hh"
 
 using namespace std;
 
@@ -17,14 +18,24 @@ void TCPReceiver::receive( TCPSenderMessage message )
   }
   if(message.SYN){
     isn_ = message.seqno;
+    // TCP Fast Open：cookie 不对，SYN 携带的数据 (和 FIN) 不接受，只建立连接
+    if(fast_open_cookie_.has_value() && message.fast_open != fast_open_cookie_){
+      message.payload.clear();
+      message.FIN = false;
+    }
   }
   if(!isn_.has_value()){
     return;
   }
-  if(message.FIN){
-    is_finish = true;
+  // ECN (RFC 3168 6.1.3)：CWR 表示对端已经减小了拥塞窗口；之后再收到 CE 标记，重新开始回显 ECE
+  if(message.CWR && !message.SYN){
+    ece_ = false;
+  }
+  if(message.ecn == IPv4Header::ECN_CE){
+    ece_ = true;
   }
-  string data = message.payload;
+  // payload 一路移动到 ByteStream，不复制 (大报文的临时副本会让 malloc 反复归还、申请内存)
+  string data = std::move( message.payload );
   //because of the isn take over a bit so we need to -1 to get the data offset 
   uint64_t index;
   
@@ -33,14 +44,41 @@ void TCPReceiver::receive( TCPSenderMessage message )
   }else{
     index = message.seqno.unwrap(isn_.value(),checkpoint) -1;
   }
-  reassembler_.insert(index,data,is_finish);
-  checkpoint = index + data.size();
+  // 只有携带 FIN 的报文才标记流的结尾 (之后到达的重传报文不是最后一段)
+  const uint64_t length = data.size();
+  reassembler_.insert(index,std::move(data),message.FIN);
+  checkpoint = index + length;
   return ;
 
   debug( "unimplemented receive() called" );
   (void)message;
 }
 
+bool TCPReceiver::receive_in_order( TCPSenderMessage& message )
+{
+  if(message.SYN || message.FIN || message.RST || rst_ || message.payload.empty() || message.seqno != ackno()){
+    return false;
+  }
+  if(!reassembler_.insert_next(message.payload)){
+    return false;
+  }
+  checkpoint = reassembler_.writer().bytes_pushed();
+  return true;
+}
+
+optional<Wrap32> TCPReceiver::ackno() const
+{
+  if(!isn_.has_value()){
+    return nullopt;
+  }
+  uint32_t size = reassembler_.writer().bytes_pushed() + 1 ;
+  // FIN 占用一个序号：只有在整个流都已重组 (writer 已关闭) 时才确认它
+  if(reassembler_.writer().is_closed()){
+    size++;
+  }
+  return isn_.value() + size;
+}
+
 TCPReceiverMessage TCPReceiver::send() const
 {
   // Your code here.
@@ -48,17 +86,10 @@ TCPReceiverMessage TCPReceiver::send() const
   if(reassembler_.reader().has_error() || rst_){
       tsm_.RST = true;
   }
-  if(isn_.has_value()){
-    uint32_t size = reassembler_.writer().bytes_pushed() + 1 ;
-    if(is_finish && reassembler_.count_bytes_pending() == 0){
-      size++;
-    }
-    Wrap32 ackno = isn_.value() + size;
-    tsm_.ackno = ackno;
-  }else{
-    tsm_.ackno = nullopt;
-  }
-  uint64_t window_size_ = reassembler_.writer().available_capacity();
+  tsm_.ackno = ackno();
+  tsm_.ECE = ece_;
+  // 进程的内存预算紧张时 (类似 tcp_mem)，窗口不超过流在预算中的份额，连接的缓冲区不再增长
+  uint64_t window_size_ = reassembler_.writer().available_within_budget();
   if(window_size_ > UINT16_MAX){
     tsm_.window_size =UINT16_MAX;
   }else{
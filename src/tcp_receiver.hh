@@ -4,6 +4,9 @@
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
 
+#include <optional>
+#include <string>
+
 class TCPReceiver
 {
 public:
@@ -16,19 +19,48 @@ public:
    */
   void receive( TCPSenderMessage message );
 
-  // The TCPReceiver sends TCPReceiverMessages to the peer's TCPSender.
+  /*
+   * Header prediction: if `message` is the next segment in order, carrying only data that fits in the window,
+   * with nothing waiting in the Reassembler, hand its payload straight to the stream and return true.
+   * Otherwise leave `message` untouched and return false (the caller should use receive()).
+   */
+  bool receive_in_order( TCPSenderMessage& message );
+
+  /*
+   * TCP Fast Open (RFC 7413): once a cookie is set, payload on a SYN is accepted only if the SYN presents that
+   * cookie; otherwise only the SYN is, and the peer resends the data after the handshake. Without a cookie, the
+   * payload of a SYN is always accepted.
+   */
+  void set_fast_open_cookie( std::string cookie ) { fast_open_cookie_ = std::move( cookie ); }
+
+  // The TCPReceiver sends TCPReceiverMessages to the peer's TCPSender. (While the process's MemoryBudget is
+  // under pressure, the window grows no further than the memory that the stream already holds; TCPPeer still
+  // keeps the right edge of a window it has advertised, which the Reassembler accepts.)
   TCPReceiverMessage send() const;
 
+  // Just the acknowledgment number of send() (the next sequence number expected), without building the message
+  std::optional<Wrap32> ackno() const;
+
   // Access the output
   const Reassembler& reassembler() const { return reassembler_; }
   Reader& reader() { return reassembler_.reader(); }
   const Reader& reader() const { return reassembler_.reader(); }
   const Writer& writer() const { return reassembler_.writer(); }
 
+  // Return the memory of the stream and the Reassembler (e.g. once the stream has ended and been read)
+  void shrink_to_fit() { reassembler_.shrink_to_fit(); }
+
+  // Heap memory held by the stream and the Reassembler (in bytes)
+  uint64_t memory_usage() const
+  {
+    return reassembler_.memory_usage() + ( fast_open_cookie_ ? string_memory_usage( *fast_open_cookie_ ) : 0 );
+  }
+
 private:
   Reassembler reassembler_;
   std::optional<Wrap32> isn_ ;
   uint64_t checkpoint ;
   bool rst_ = false;
-  bool is_finish = false;
+  bool ece_ = false; // ECN：收到 CE 标记之后回显 ECE，直到对端发来 CWR
+  std::optional<std::string> fast_open_cookie_ {};
 };
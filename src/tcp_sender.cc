@@ -1,50 +1,105 @@
 #include "tcp_sender.hh"
 #include "debug.hh"
+#include "ipv4_header.hh"
 #include "tcp_config.hh"
 
 using namespace std;
 
 uint64_t TCPSender::sequence_numbers_in_flight() const { return in_flight_; }
 
-uint64_t TCPSender::consecutive_retransmissions() const { return consecutive_rexmit_cnt_; }
+// 没有得到回应的零窗口探测也算作重传：对端一直不回应时，连接照样会因为重传次数过多而放弃
+uint64_t TCPSender::consecutive_retransmissions() const { return consecutive_rexmit_cnt_ + probes_out_; }
 
 void TCPSender::push( const TransmitFunction& transmit )
 {
+  // 每次只构造一个报文，复用 scratch_ 的 payload 存储，避免每个报文都分配内存
+  while ( push( std::span { &scratch_, 1 } ) == 1 ) {
+    transmit( scratch_ );
+    if ( scratch_.RST ) {
+      break;
+    }
+  }
+}
+
+size_t TCPSender::push( std::span<TCPSenderMessage> out )
+{
+  if ( out.empty() ) {
+    return 0;
+  }
+
   // 1. 检查流错误，发送 RST 并立即返回 (不重传 RST)
   if (input_.writer().has_error()) {
-    TCPSenderMessage rst_msg;
-    rst_msg.seqno = Wrap32::wrap(next_seq_, isn_);
-    rst_msg.SYN = false;
-    rst_msg.FIN = false;
-    rst_msg.RST = true;
-    transmit(rst_msg);
-    return;
+    out.front() = make_empty_message();
+    return 1;
   }
 
   // 2. 防止下溢：计算可用窗口
-  uint64_t current_window_size = (window_size_ == 0) ? 1 : window_size_;
+  // persist 状态下窗口视为 1：最多只有一个 1 字节的探测报文在途
+  // TCP Fast Open：对端还没有通告窗口，SYN 也可以携带最多一个 MSS 的数据
+  uint64_t current_window_size = zero_window_ ? 1 : std::min<uint64_t>(window_size_, cwnd_);
+  if (!syn_sent_ && fast_open_data_) {
+    current_window_size = std::max<uint64_t>(current_window_size, 1 + mss_);
+  }
   uint64_t available_space = 0;
   if (current_window_size > in_flight_) {
       available_space = current_window_size - in_flight_;
   }
 
-  // 3. 填充窗口循环
-  while (available_space > 0) {
-    TCPSenderMessage msg;
+  // 3. 填充窗口循环：报文直接构造在调用方提供的槽位中
+  size_t count = 0;
+  // 对端没有接受随 SYN 发送的数据：不等超时，先把它作为普通报文重传 (已计入 in_flight_)
+  if (resend_front_) {
+    resend_front_ = false;
+    if (!rexmit_queue_.empty()) {
+      out[count++] = rebuild(rexmit_queue_.front(), acked_seq_ - rexmit_queue_.front().seqno);
+    }
+  }
+  while (available_space > 0 && count < out.size()) {
+    TCPSenderMessage& msg = out[count];
     msg.SYN = false;
     msg.FIN = false;
     msg.RST = false;
+    msg.fast_open.reset();
+    msg.CWR = false;
+    msg.ecn = IPv4Header::ECN_NOT_ECT;
 
     // 处理 SYN
     if (!syn_sent_) {
       msg.SYN = true;
+      msg.fast_open = fast_open_;
+      msg.CWR = ecn_ && !heard_from_peer_; // ECN-setup SYN (ECE 由 TCPPeer 设置)
       syn_sent_ = true;
       available_space--;
     }
 
-    // 计算 Payload (注意这里 MSS 的使用，如果 TCPConfig 可用建议替换 mss_)
-    uint64_t payload_size = std::min({mss_, available_space, input_.reader().bytes_buffered()});
-    msg.payload = input_.reader().peek().substr(0, payload_size);
+    // 计算 Payload (每个报文最多 mss_ 字节)
+    const uint64_t buffered = input_.reader().bytes_buffered();
+    uint64_t payload_size = std::min({segment_size_, available_space, buffered});
+
+    // 小报文合并：会清空发送缓冲区的不足 MSS 的部分可以先留着，等后续写入凑成更大的报文
+    // (受窗口限制而变小的报文不在此列；流关闭时总是立即发送)
+    if (!msg.SYN && payload_size % mss_ != 0 && payload_size == buffered
+        && !input_.writer().is_closed() && hold_small_segment()) {
+      payload_size -= payload_size % mss_;
+      if (payload_size == 0) {
+        break;
+      }
+    }
+
+    // 发送方 SWS 避免 (RFC 1122 4.2.3.4)：受窗口限制的小报文 (不足 MSS，也不足最大窗口的一半) 先不发，
+    // 等窗口变大，或者等 SWS_OVERRIDE_TIMEOUT 超时；
+    // 零窗口的第一个探测报文也等到 persist 定时器超时再发 (RFC 1122 4.2.2.17)，通常窗口更新会先到
+    const bool sws_small = !zero_window_ && payload_size < buffered && payload_size < mss_
+                           && payload_size < max_window_ / 2 && sws_elapsed_ms_ < TCPConfig::SWS_OVERRIDE_TIMEOUT;
+    const bool sws_probe = zero_window_ && payload_size > 0 && sws_elapsed_ms_ < persist_timeout_ms_;
+    if (sws_avoidance_ && !msg.SYN && (sws_small || sws_probe)) {
+      if (!sws_held_) {
+        sws_held_ = true;
+        sws_elapsed_ms_ = 0;
+      }
+      break;
+    }
+    msg.payload.assign(input_.reader().peek().substr(0, payload_size));
     input_.reader().pop(payload_size);
     available_space -= payload_size;
 
@@ -62,23 +117,117 @@ void TCPSender::push( const TransmitFunction& transmit )
       break;
     }
 
-    // 发送并更新状态
-    transmit(msg);
+    // ECN：新数据标记为 ECN-capable；减小拥塞窗口之后的第一个新数据报文带上 CWR
+    if (ecn_ && !msg.SYN && !msg.payload.empty()) {
+      msg.ecn = IPv4Header::ECN_ECT0;
+      msg.CWR = cwr_pending_;
+      cwr_pending_ = false;
+    }
+
+    // 交出报文并更新状态
+    count++;
+    sws_held_ = false;
+    sws_elapsed_ms_ = 0;
     next_seq_ += msg.sequence_length();
     in_flight_ += msg.sequence_length();
-    rexmit_queue_.push(msg);
+    rexmit_queue_.push_back({next_seq_ - msg.sequence_length(), msg.payload.size(), msg.SYN, msg.FIN});
+    if (msg.payload.size() % mss_ != 0) {
+      small_segment_end_ = next_seq_;
+      cork_elapsed_ms_ = 0;
+    }
 
     // 只有在定时器未运行时才启动
     if (!timer_running_) {
       timer_running_ = true;
       time_elapsed_ = 0;
     }
+    // 新的零窗口探测 (窗口视为 1，发出时没有其他报文在途)：persist 定时器从头计时
+    if (zero_window_) {
+      probe_in_flight_ = true;
+      persist_elapsed_ms_ = 0;
+    }
 
     // 如果发送了 FIN 或者窗口满了，停止
     if (fin_sent_ || available_space == 0) {
       break;
     }
   }
+  return count;
+}
+
+bool TCPSender::hold_small_segment() const
+{
+  // cork 优先于 nodelay，但最多持有 CORK_TIMEOUT
+  if (corked_) {
+    return cork_elapsed_ms_ < TCPConfig::CORK_TIMEOUT;
+  }
+  if (nodelay_) {
+    return false;
+  }
+  switch (coalescing_) {
+    case TCPCoalescing::Nagle:
+      return in_flight_ > 0;
+    case TCPCoalescing::Autocork:
+      return acked_seq_ < small_segment_end_;
+    case TCPCoalescing::NoDelay:
+      break;
+  }
+  return false;
+}
+
+const TCPSenderMessage& TCPSender::rebuild( const Outstanding& seg, uint64_t skip, uint64_t max_payload )
+{
+  // payload 在流中的位置：SYN 占用序号 0，流的第 i 个字节的序号是 i + 1
+  const uint64_t offset = skip > seg.SYN ? skip - seg.SYN : 0;
+  const uint64_t first_retained = input_.reader().bytes_popped() - input_.reader().retained().size();
+  const uint64_t start = seg.seqno + seg.SYN - 1 + offset - first_retained;
+  const uint64_t len = std::min(max_payload, seg.payload_size - offset);
+
+  scratch_.seqno = Wrap32::wrap(seg.seqno + skip, isn_);
+  scratch_.SYN = seg.SYN && skip == 0;
+  scratch_.payload.assign(input_.reader().retained().substr(start, len));
+  scratch_.FIN = seg.FIN && offset + len == seg.payload_size;
+  scratch_.RST = false;
+  // 重传的数据不标记 ECN-capable (RFC 3168 6.1.5)
+  scratch_.CWR = scratch_.SYN && ecn_ && !heard_from_peer_;
+  scratch_.ecn = IPv4Header::ECN_NOT_ECT;
+  if (scratch_.SYN) {
+    scratch_.fast_open = fast_open_;
+  } else {
+    scratch_.fast_open.reset();
+  }
+  return scratch_;
+}
+
+void TCPSender::merge_front()
+{
+  // 把队首和紧随其后的小报文 (以及 FIN) 合并为一个不超过 MSS 的报文；SYN 报文保持原样
+  if (rexmit_queue_.empty() || rexmit_queue_.front().SYN) {
+    return;
+  }
+  Outstanding merged = rexmit_queue_.front();
+  rexmit_queue_.pop_front();
+  while (!rexmit_queue_.empty() && !merged.FIN
+         && merged.payload_size + rexmit_queue_.front().payload_size <= mss_) {
+    merged.payload_size += rexmit_queue_.front().payload_size;
+    merged.FIN = rexmit_queue_.front().FIN;
+    rexmit_queue_.pop_front();
+  }
+  rexmit_queue_.push_front(merged);
+}
+
+void TCPSender::set_fast_open( std::string cookie )
+{
+  fast_open_data_ = !cookie.empty();
+  fast_open_ = std::move(cookie);
+}
+
+void TCPSender::set_cork( bool cork )
+{
+  if (cork && !corked_) {
+    cork_elapsed_ms_ = 0;
+  }
+  corked_ = cork;
 }
 
 void TCPSender::receive( const TCPReceiverMessage& msg )
@@ -90,13 +239,41 @@ void TCPSender::receive( const TCPReceiverMessage& msg )
       return; 
   }
 
+  // ECN (RFC 3168 6.1.2)：ECE 表示路径上出现了拥塞，拥塞窗口减半，每个窗口的数据最多一次
+  // (SYN 被确认之前的 ECE 属于 ECN 协商，不是拥塞信号)
+  heard_from_peer_ = true;
+  if (ecn_ && msg.ECE && acked_seq_ > 0 && acked_seq_ >= recover_) {
+    cwnd_ = std::max(std::min(cwnd_, in_flight_) / 2, 2 * mss_);
+    cwnd_acked_ = 0;
+    recover_ = next_seq_;
+    cwr_pending_ = true;
+  }
+
   // 更新窗口大小 (即使没有 ACK 新数据，窗口也可能更新)
-  raw_window_size_ = msg.window_size;
-  window_size_ = (msg.window_size == 0) ? 1 : msg.window_size;
+  const bool was_zero_window = zero_window_;
+  window_size_ = msg.window_size;
+  zero_window_ = (msg.window_size == 0);
+  max_window_ = std::max<uint64_t>(max_window_, msg.window_size);
+
+  // 窗口重新打开：立即离开 persist 状态，恢复正常的 RTO 计时，随后的 push 以全速发送
+  if (was_zero_window && !zero_window_) {
+    persist_timeout_ms_ = current_RTO_ms_;
+    persist_elapsed_ms_ = 0;
+    time_elapsed_ = 0;
+  }
+
+  if (!zero_window_) {
+    probe_in_flight_ = false;
+  }
 
   if (msg.ackno.has_value()) {
     uint64_t abs_ackno = msg.ackno.value().unwrap(isn_, acked_seq_);
 
+    // 对端有回应 (哪怕是没有确认新数据的零窗口 ACK)：未回应的探测计数清零
+    if (abs_ackno <= next_seq_ && abs_ackno >= acked_seq_) {
+      probes_out_ = 0;
+    }
+
     // 检查 ACK 合法性：不能小于已确认的，也不能大于已发送的
     if (abs_ackno > next_seq_ || abs_ackno <= acked_seq_) {
       return;
@@ -104,28 +281,47 @@ void TCPSender::receive( const TCPReceiverMessage& msg )
 
     // 更新 in_flight 和 acked_seq
     in_flight_ -= (abs_ackno - acked_seq_);
+    // 拥塞避免：每确认一个拥塞窗口的数据，窗口增长一个 MSS
+    if (cwnd_ != UINT64_MAX) {
+      cwnd_acked_ += abs_ackno - acked_seq_;
+      if (cwnd_acked_ >= cwnd_) {
+        cwnd_acked_ -= cwnd_;
+        cwnd_ += mss_;
+      }
+    }
     acked_seq_ = abs_ackno;
 
     // 清理重传队列
-    while (!rexmit_queue_.empty()) {
-      const auto &front_msg = rexmit_queue_.front();
-      // 这里的 checkpoint 用 acked_seq_ 更自然
-      uint64_t msg_end = front_msg.seqno.unwrap(isn_, acked_seq_) + front_msg.sequence_length();
-      
-      if (msg_end <= acked_seq_) {
-        rexmit_queue_.pop();
-      } else {
-        break;
-      }
+    while (!rexmit_queue_.empty() && rexmit_queue_.front().end() <= acked_seq_) {
+      rexmit_queue_.pop_front();
+    }
+
+    // TCP Fast Open：只确认了 SYN，没有确认随 SYN 发送的数据 (对端不接受 cookie)，剩下的数据成为普通报文
+    if (!rexmit_queue_.empty() && rexmit_queue_.front().SYN && acked_seq_ > rexmit_queue_.front().seqno) {
+      rexmit_queue_.front().seqno++;
+      rexmit_queue_.front().SYN = false;
+      resend_front_ = true;
     }
 
+    // 释放完全被确认的报文的数据 (部分确认的报文可能还要整段重传，先保留)
+    const uint64_t first_retained = input_.reader().bytes_popped() - input_.reader().retained().size();
+    const uint64_t keep_from = rexmit_queue_.empty()
+                                 ? input_.reader().bytes_popped()
+                                 : rexmit_queue_.front().seqno + rexmit_queue_.front().SYN - 1;
+    input_.reader().release(keep_from - first_retained);
+
     // RFC 6298: 有新数据被确认时，重置 RTO
     current_RTO_ms_ = initial_RTO_ms_;
     consecutive_rexmit_cnt_ = 0;
     time_elapsed_ = 0;
 
+    // 探测被确认说明对端仍然存活：persist 退避也重新开始
+    persist_timeout_ms_ = current_RTO_ms_;
+    persist_elapsed_ms_ = 0;
+
     // 如果还有未确认数据，重启定时器(通过置0已完成)；如果没有，关闭定时器
     timer_running_ = !rexmit_queue_.empty();
+    probe_in_flight_ = probe_in_flight_ && !rexmit_queue_.empty();
   }
 }
 
@@ -148,6 +344,29 @@ TCPSenderMessage TCPSender::make_empty_message() const
 
 void TCPSender::tick( uint64_t ms_since_last_tick, const TransmitFunction& transmit )
 {
+  // cork 计时：有数据被持有时才计时，超时后下一次 push 会把它发出去
+  if (corked_ && input_.reader().bytes_buffered() > 0) {
+    cork_elapsed_ms_ += ms_since_last_tick;
+  }
+  // SWS 避免的 override 计时同理
+  if (sws_held_) {
+    sws_elapsed_ms_ += ms_since_last_tick;
+  }
+
+  // persist 状态：唯一在途的报文是零窗口探测，使用独立的指数退避，不加倍 RTO；
+  // 对端回应 (即使仍是零窗口) 就可以无限期探测下去 (RFC 9293 3.8.6.1)，没有回应的探测计入连续重传次数。
+  // 对端通告零窗口时已经有数据在途，则不进入 persist 状态，照常按 RTO 重传
+  if(in_persist()){
+    persist_elapsed_ms_ += ms_since_last_tick;
+    if(persist_elapsed_ms_ >= persist_timeout_ms_){
+      transmit(rebuild(rexmit_queue_.front()));
+      probes_out_ += 1;
+      persist_timeout_ms_ = std::min(persist_timeout_ms_ * 2, TCPConfig::MAX_PERSIST_TIMEOUT);
+      persist_elapsed_ms_ = 0;
+    }
+    return;
+  }
+
   if(timer_running_){
     time_elapsed_ +=  ms_since_last_tick;
   }
@@ -155,14 +374,17 @@ void TCPSender::tick( uint64_t ms_since_last_tick, const TransmitFunction& trans
   // check if timeout
   if(timer_running_ && time_elapsed_ >= current_RTO_ms_ && !rexmit_queue_.empty()){
     // timeout , retransmit the oldest segment
-    const auto& msg = rexmit_queue_.front();
-    transmit(msg);
+    // (重新组包时先合并队首的小报文；super-segment 或重新组包时从第一个未确认的字节起重传最多一个 MSS)
+    if (repacketize_) {
+      merge_front();
+    }
+    const auto& seg = rexmit_queue_.front();
+    const bool trim = (repacketize_ || seg.payload_size > mss_) && acked_seq_ > seg.seqno;
+    transmit(rebuild(seg, trim ? acked_seq_ - seg.seqno : 0, mss_));
 
     // exponential backoff
-    if(raw_window_size_ != 0 ){
-      current_RTO_ms_ *= 2;
-      consecutive_rexmit_cnt_ += 1;
-    }
+    current_RTO_ms_ *= 2;
+    consecutive_rexmit_cnt_ += 1;
 
     // reset timer
     time_elapsed_ = 0;
@@ -177,6 +399,41 @@ void TCPSender::tick( uint64_t ms_since_last_tick, const TransmitFunction& trans
   (void)transmit;
 }
 
+void TCPSender::shrink_to_fit()
+{
+  input_.shrink_to_fit();
+  rexmit_queue_.shrink_to_fit();
+  std::string {}.swap(scratch_.payload);
+}
+
+uint64_t TCPSender::memory_usage() const
+{
+  return input_.memory_usage() + rexmit_queue_.memory_usage() + string_memory_usage(scratch_.payload)
+         + (fast_open_.has_value() ? string_memory_usage(*fast_open_) : 0);
+}
+
+std::optional<uint64_t> TCPSender::ms_until_next_timer() const
+{
+  std::optional<uint64_t> next;
+  // 还没超时的定时器才算：已经超时的在那次 tick 中处理过了
+  const auto consider = [&next](uint64_t elapsed, uint64_t timeout) {
+    if (elapsed < timeout) {
+      next = std::min(next.value_or(UINT64_MAX), timeout - elapsed);
+    }
+  };
+  if (in_persist()) {
+    consider(persist_elapsed_ms_, persist_timeout_ms_); // persist 状态下 RTO 不计时
+  } else if (timer_running_ && !rexmit_queue_.empty()) {
+    consider(time_elapsed_, current_RTO_ms_);
+  }
+  if (corked_ && input_.reader().bytes_buffered() > 0) {
+    consider(cork_elapsed_ms_, TCPConfig::CORK_TIMEOUT);
+  }
+  if (sws_held_) {
+    consider(sws_elapsed_ms_, zero_window_ ? persist_timeout_ms_ : TCPConfig::SWS_OVERRIDE_TIMEOUT);
+  }
+  return next;
+}
 
 // seq to write the function 
 // receive push tick
\ No newline at end of file
@@ -1,18 +1,28 @@
 #pragma once
 
 #include "byte_stream.hh"
+#include "tcp_config.hh"
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
 
-#include <functional>
-#include <queue>
+#include "function_ref.hh"
+
+#include <algorithm>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
 class TCPSender
 {
 public:
-  /* Construct TCP sender with given default Retransmission Timeout and possible ISN */
-  TCPSender( ByteStream&& input, Wrap32 isn, uint64_t initial_RTO_ms )
-    : input_( std::move( input ) ), isn_( isn ), initial_RTO_ms_( initial_RTO_ms ),current_RTO_ms_( initial_RTO_ms ),rexmit_queue_()
-  {}
+  /* Construct TCP sender with given default Retransmission Timeout, possible ISN, and maximum payload size */
+  TCPSender( ByteStream&& input, Wrap32 isn, uint64_t initial_RTO_ms, uint64_t mss = TCPConfig::MAX_PAYLOAD_SIZE )
+    : mss_( mss ), segment_size_( mss ), input_( std::move( input ) ), isn_( isn ), initial_RTO_ms_( initial_RTO_ms ),current_RTO_ms_( initial_RTO_ms ),rexmit_queue_{},persist_timeout_ms_( initial_RTO_ms )
+  {
+    // 在途数据只保存一份：留在 input_ 的保留区，直到被确认
+    input_.set_retain( true );
+    input_.set_moderate( true ); // 发送缓冲区：内存预算紧张时限制应用写入
+  }
 
   /* Generate an empty TCPSenderMessage */
   TCPSenderMessage make_empty_message() const;
@@ -21,17 +31,90 @@ public:
   void receive( const TCPReceiverMessage& msg );
 
   /* Type of the `transmit` function that the push and tick methods can use to send messages */
-  using TransmitFunction = std::function<void( const TCPSenderMessage& )>;
+  using TransmitFunction = FunctionRef<void( const TCPSenderMessage& )>;
 
   /* Push bytes from the outbound stream */
   void push( const TransmitFunction& transmit );
 
+  /*
+   * Push bytes from the outbound stream, building the messages directly in the caller's `out` slots
+   * (whose payload storage is reused). Returns how many slots were filled; if that equals `out.size()`,
+   * there may be more to send and the caller should call again.
+   */
+  size_t push( std::span<TCPSenderMessage> out );
+
   /* Time has passed by the given # of milliseconds since the last time the tick() method was called */
   void tick( uint64_t ms_since_last_tick, const TransmitFunction& transmit );
 
+  /*
+   * How long until the next of the sender's timers (retransmission, persist, cork or SWS override) expires, so
+   * that tick() need not be called before then; nothing if none is running.
+   */
+  std::optional<uint64_t> ms_until_next_timer() const;
+
+  /*
+   * Small-write coalescing. A segment (or the tail of a super-segment, see below) shorter than the MSS that
+   * would empty the outbound stream is held back (to be merged with later writes) according to the coalescing mode, unless nodelay is set; while corked,
+   * it is held regardless, until uncorked or for at most TCPConfig::CORK_TIMEOUT. Closing the stream always
+   * flushes. After turning nodelay on or cork off, call push() to send whatever was held.
+   */
+  void set_coalescing( TCPCoalescing mode ) { coalescing_ = mode; }
+  void set_nodelay( bool nodelay ) { nodelay_ = nodelay; }
+  void set_cork( bool cork );
+
+  /*
+   * Segmentation offload: build segments with up to `max_payload` bytes (a multiple of the MSS, except at the
+   * end of the stream), which the datagram adapter cuts into MSS-sized wire segments. A retransmission of such
+   * a super-segment resends only its first unacknowledged MSS.
+   */
+  void set_offload_size( uint64_t max_payload ) { segment_size_ = std::max( mss_, max_payload ); }
+
+  /*
+   * Repacketization: when the retransmission timer expires, merge the oldest outstanding segment with the
+   * small ones after it (and a FIN), up to the MSS, and retransmit them as one segment. Off by default for a
+   * bare TCPSender (a timeout then retransmits only the oldest outstanding segment); TCPPeer turns it on as
+   * TCPConfig::repacketize says.
+   */
+  void set_repacketize( bool repacketize ) { repacketize_ = repacketize; }
+
+  /*
+   * Sender-side silly window syndrome avoidance (RFC 1122 4.2.3.4): when the window is too small for all the
+   * buffered data, hold a segment that would be shorter than both the MSS and half the largest window the peer
+   * has offered, until the window grows or for at most TCPConfig::SWS_OVERRIDE_TIMEOUT (then call push()).
+   * A zero window is likewise first probed only when the persist timer expires, not at once.
+   */
+  void set_sws_avoidance( bool sws_avoidance ) { sws_avoidance_ = sws_avoidance; }
+
+  /*
+   * TCP Fast Open (RFC 7413), set before the first push. A client presents `cookie` on its SYN: a non-empty one,
+   * received from this server before, lets the SYN carry up to one MSS of the bytes already written; an empty one
+   * asks the server for a cookie. If the server acknowledges the SYN but not its data, the data is resent at once.
+   * A server grants `cookie` on its SYN instead, without sending data early.
+   */
+  void set_fast_open( std::string cookie );
+  void grant_fast_open( std::string cookie ) { fast_open_ = std::move( cookie ); }
+
+  /*
+   * Explicit Congestion Notification (RFC 3168). The sender marks new data ECN-capable (ECT(0)), and asks for
+   * ECN with the CWR flag on its SYN if it opens the connection. An ECN-Echo (ECE) from the peer halves the
+   * congestion window, at most once per window of data, and the next new segment carries CWR. The congestion
+   * window then grows by one MSS per window acknowledged. (Until the first ECE, the peer's window alone limits
+   * the sender, as without ECN: this sender does not react to loss.)
+   */
+  void set_ecn( bool ecn ) { ecn_ = ecn; }
+
+  /* Return the memory of the outbound stream and of the buffers kept for building messages (e.g. once the
+   * stream has been sent and acknowledged) */
+  void shrink_to_fit();
+
+  // Heap memory held by the outbound stream and the sender's own buffers (in bytes)
+  uint64_t memory_usage() const;
+
   // Accessors
   uint64_t sequence_numbers_in_flight() const;  // How many sequence numbers are outstanding?
   uint64_t consecutive_retransmissions() const; // How many consecutive retransmissions have happened?
+  uint64_t peer_window() const { return window_size_; } // Most recent window advertised by the peer
+  uint64_t congestion_window() const { return cwnd_; }   // UINT64_MAX until reduced by ECN
   const Writer& writer() const { return input_.writer(); }
   const Reader& reader() const { return input_.reader(); }
   Writer& writer() { return input_.writer(); }
@@ -43,18 +126,103 @@ private:
   uint64_t next_seq_{0};  // 下一个要发送的序列号
   uint64_t acked_seq_{0};// 已确认的序列号
   uint64_t in_flight_{0};// 未确认但已发送的字节数
-  uint64_t mss_{1000};
+  uint64_t mss_;
+  uint64_t segment_size_; // 每个报文的最大 payload：不启用 offload 时等于 mss_
 
-  int raw_window_size_{-1};
   uint16_t window_size_{1};
+  bool zero_window_{false}; // 对端通告零窗口：进入 persist 状态
   ByteStream input_;
   Wrap32 isn_;
   uint64_t initial_RTO_ms_;
   uint64_t current_RTO_ms_;
   uint64_t time_elapsed_{0};
   bool timer_running_{false};
-  std::queue<TCPSenderMessage> rexmit_queue_;
+  // 在途报文只记录位置和标志，payload 是 input_ 保留区中的一段 (不复制)
+  struct Outstanding
+  {
+    uint64_t seqno; // absolute seqno
+    uint64_t payload_size;
+    bool SYN;
+    bool FIN;
+
+    uint64_t end() const { return seqno + SYN + payload_size + FIN; }
+  };
+  // 在途报文队列：vector 加队首下标。std::deque 即使为空也要分配约 600 字节，这里没有报文在途时不占内存
+  struct OutstandingQueue
+  {
+    std::vector<Outstanding> items {};
+    size_t head {0};
+
+    bool empty() const { return head == items.size(); }
+    Outstanding& front() { return items[head]; }
+    const Outstanding& front() const { return items[head]; }
+    void push_back( const Outstanding& o ) { items.push_back( o ); }
+    void push_front( const Outstanding& o )
+    {
+      if ( head > 0 ) {
+        items[--head] = o;
+      } else {
+        items.insert( items.begin(), o );
+      }
+    }
+    void pop_front()
+    {
+      // 出队的前缀延迟到它不小于剩余部分时才一次性删除；队列变空时直接清空
+      if ( ++head == items.size() ) {
+        items.clear();
+        head = 0;
+      } else if ( head >= items.size() - head ) {
+        items.erase( items.begin(), items.begin() + static_cast<std::ptrdiff_t>( head ) );
+        head = 0;
+      }
+    }
+    void shrink_to_fit() { items.shrink_to_fit(); }
+    uint64_t memory_usage() const { return items.capacity() * sizeof( Outstanding ); }
+  };
+  OutstandingQueue rexmit_queue_;
+  bool repacketize_{false};
+  void merge_front();
   uint64_t consecutive_rexmit_cnt_{0};// 连续重传计数
 
+  // push( transmit ) 逐个构造报文、以及重传时重建报文所复用的缓冲区
+  TCPSenderMessage scratch_ {};
+
+  // persist 定时器：零窗口期间的探测报文使用独立的指数退避
+  uint64_t persist_timeout_ms_;
+  uint64_t persist_elapsed_ms_{0};
+  bool probe_in_flight_{false}; // 在途的是零窗口探测 (而不是对端通告零窗口之前发出的数据)
+  uint64_t probes_out_{0};      // 连续没有得到回应的探测次数
+  bool in_persist() const { return zero_window_ && probe_in_flight_ && !rexmit_queue_.empty(); }
+
+  // 小报文合并：Nagle / autocork / cork
+  TCPCoalescing coalescing_{TCPCoalescing::NoDelay};
+  bool nodelay_{false};
+  bool corked_{false};
+  uint64_t cork_elapsed_ms_{0};
+  uint64_t small_segment_end_{0}; // 最近一个不足 MSS 的报文的结束序号 (absolute)
+  bool hold_small_segment() const;
+
+  // 发送方 SWS 避免
+  bool sws_avoidance_{false};
+  bool sws_held_{false}; // 当前是否因窗口太小而持有数据
+  uint64_t sws_elapsed_ms_{0};
+  uint64_t max_window_{0}; // 对端通告过的最大窗口
+
+  // TCP Fast Open：SYN 携带的 cookie 选项，以及 SYN 能否携带数据
+  std::optional<std::string> fast_open_ {};
+  bool fast_open_data_{false};
+  bool resend_front_{false}; // SYN 被确认而随 SYN 发送的数据没有：下一次 push 立即重传
+
+  // ECN：拥塞窗口 (第一次收到 ECE 之前不限制)，以及对 ECE 的响应
+  bool ecn_{false};
+  bool heard_from_peer_{false}; // 是否收到过对端的消息 (主动打开方的 SYN 才请求 ECN)
+  uint64_t cwnd_{UINT64_MAX};
+  uint64_t cwnd_acked_{0};      // 拥塞避免：自上次增长以来确认的字节数
+  uint64_t recover_{0};         // 这个序号之前发出的数据被确认之前，不再因 ECE 减小窗口
+  bool cwr_pending_{false};     // 下一个新数据报文设置 CWR
+
+  // 从保留区重建在途报文 (构造在 scratch_ 中)：跳过前 skip 个序号，payload 最多 max_payload 字节
+  const TCPSenderMessage& rebuild( const Outstanding& seg, uint64_t skip = 0, uint64_t max_payload = UINT64_MAX );
+
 
 };
@@ -0,0 +1,172 @@
+#include "byte_ring.hh"
+#include "eventfd.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <poll.h>
+
+using namespace std;
+
+namespace {
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "byte_ring: " + what );
+  }
+}
+
+// Has `fd` been notified since it was last cleared? (And clear it.)
+bool notified( EventFD& fd )
+{
+  pollfd pfd { .fd = fd.fd_num(), .events = POLLIN, .revents = 0 };
+  const bool ready = ::poll( &pfd, 1, 0 ) == 1;
+  fd.clear();
+  return ready;
+}
+
+// Read everything buffered, across the end of the ring if need be
+string read_all( ByteRing& ring )
+{
+  string out;
+  while ( ring.bytes_buffered() ) {
+    const string_view data = ring.peek();
+    out += data;
+    ring.pop( data.size() );
+  }
+  return out;
+}
+
+void wrap_around()
+{
+  EventFD reader;
+  EventFD writer;
+  ByteRing ring { 6, reader, writer };
+  expect( ring.capacity() == 8, "capacity is rounded up to a power of two" );
+  expect( ring.available_capacity() == 8, "an empty ring has room for its capacity" );
+
+  expect( ring.push( "abcdef" ) == 6, "push fits" );
+  ring.pop( 6 );
+  expect( ring.push( "ghijkl" ) == 6, "push across the end of the ring fits" );
+  expect( ring.peek() == "gh", "peek stops at the end of the ring" );
+  ring.pop( 2 );
+  expect( ring.peek() == "ijkl", "peek goes on from the start of the ring" );
+  expect( ring.push( "mnopqrst" ) == 4, "push is cut to the room left" );
+  expect( ring.available_capacity() == 0, "full ring has no room" );
+  expect( ring.push( "u" ) == 0, "push into a full ring" );
+  expect( read_all( ring ) == "ijklmnop", "bytes come out in order" );
+
+  // many passes around the ring, with every offset
+  string written;
+  string read;
+  for ( size_t i = 0; i < 1000; i++ ) {
+    const string data( 1 + i % 7, static_cast<char>( 'a' + i % 26 ) );
+    written += data.substr( 0, ring.push( data ) );
+    read += ring.peek().substr( 0, i % 3 );
+    ring.pop( min<size_t>( i % 3, ring.peek().size() ) );
+    if ( i % 5 == 0 ) {
+      read += read_all( ring );
+    }
+  }
+  read += read_all( ring );
+  expect( read == written, "bytes survive many passes around the ring" );
+}
+
+void notifications()
+{
+  EventFD reader;
+  EventFD writer;
+  ByteRing ring { 8, reader, writer };
+
+  expect( ring.push( "ab" ) > 0 and notified( reader ), "push into an empty ring wakes the reader" );
+  expect( ring.push( "cd" ) > 0 and not notified( reader ), "push into a ring with bytes does not wake the reader" );
+  ring.pop( 4 );
+  expect( not notified( writer ), "pop from a ring that was not full does not wake the writer" );
+  expect( ring.push( "efgh" ) > 0 and notified( reader ), "push after the reader caught up wakes it" );
+
+  expect( ring.push( "ijklmnop" ) == 4 and not notified( reader ), "push that fills the ring" );
+  ring.pop( 1 );
+  expect( notified( writer ), "pop from a full ring wakes the writer" );
+  ring.pop( 1 );
+  expect( not notified( writer ), "pop from a ring no longer full does not wake the writer" );
+  ring.pop( 6 );
+
+  ring.set_reader_polling( true );
+  expect( ring.push( "q" ) > 0 and not notified( reader ), "push does not wake a polling reader" );
+  ring.pop( 1 );
+  expect( ring.push( "r" ) > 0 and not notified( reader ), "... even once it has caught up" );
+  ring.pop( 1 );
+  ring.set_reader_polling( false );
+  expect( ring.push( "s" ) > 0 and notified( reader ), "push wakes the reader once it stops polling" );
+
+  ring.close();
+  expect( notified( reader ) and notified( writer ), "close wakes both sides" );
+  expect( ring.push( "t" ) == 0, "push after close" );
+  expect( not ring.is_finished(), "closed ring with bytes left is not finished" );
+  expect( read_all( ring ) == "s", "bytes pushed before close are read" );
+  expect( ring.is_finished(), "closed ring read to the end is finished" );
+}
+
+// A writer thread and a reader thread that sleep on their EventFDs whenever the ring is full or empty, as
+// TCPMinnowSocket's write() and read() do: every byte must arrive, and neither side may sleep forever.
+void threads()
+{
+  EventFD reader_wakeup;
+  EventFD writer_wakeup;
+  ByteRing ring { 64, reader_wakeup, writer_wakeup };
+  constexpr size_t total = 1 << 20;
+
+  thread writer( [&] {
+    for ( size_t written = 0; written < total; ) {
+      const string data( 1 + written % 100, static_cast<char>( written % 251 ) );
+      const string_view chunk = string_view { data }.substr( 0, min( data.size(), total - written ) );
+      for ( size_t pushed = 0; pushed < chunk.size(); ) {
+        if ( ring.available_capacity() == 0 ) {
+          writer_wakeup.wait();
+          continue;
+        }
+        pushed += ring.push( chunk.substr( pushed ) );
+      }
+      written += chunk.size();
+    }
+    ring.close();
+  } );
+
+  string read;
+  string expected;
+  for ( size_t written = 0; written < total; ) {
+    const size_t len = min<size_t>( 1 + written % 100, total - written );
+    expected.append( len, static_cast<char>( written % 251 ) );
+    written += len;
+  }
+  while ( not ring.is_finished() ) {
+    while ( ring.bytes_buffered() == 0 and not ring.is_closed() ) {
+      reader_wakeup.wait();
+    }
+    read += read_all( ring );
+  }
+  writer.join();
+  expect( read == expected, "a writer and a reader on two threads pass every byte in order" );
+}
+} // namespace
+
+int main()
+{
+  try {
+    wrap_around();
+    notifications();
+    threads();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
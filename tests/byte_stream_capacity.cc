@@ -2,6 +2,7 @@
 
 #include <exception>
 #include <iostream>
+#include <string>
 
 using namespace std;
 
@@ -96,6 +97,108 @@ int main()
       test.execute( BytesBuffered { 1 } );
     }
 
+    {
+      ByteStreamTestHarness test { "grow capacity", 2 };
+
+      test.execute( Push { "cat" } );
+      test.execute( BytesPushed { 2 } );
+      test.execute( SetCapacity { 5 } );
+      test.execute( AvailableCapacity { 3 } );
+      test.execute( Push { "tacos" } );
+      test.execute( BytesPushed { 5 } );
+      test.execute( AvailableCapacity { 0 } );
+      test.execute( Peek { "catac" } );
+    }
+
+    {
+      ByteStreamTestHarness test { "shrink capacity below what is buffered", 6 };
+
+      test.execute( Push { "burrit" } );
+      test.execute( SetCapacity { 2 } );
+      test.execute( AvailableCapacity { 0 } );
+      test.execute( BytesBuffered { 6 } );
+      test.execute( Push { "o" } );
+      test.execute( BytesPushed { 6 } );
+      test.execute( Peek { "burrit" } );
+      test.execute( Pop { 3 } );
+      test.execute( AvailableCapacity { 0 } );
+      test.execute( Pop { 2 } );
+      test.execute( AvailableCapacity { 1 } );
+      test.execute( Push { "os" } );
+      test.execute( Peek { "to" } );
+      test.execute( BytesPushed { 7 } );
+    }
+
+    {
+      ByteStreamTestHarness test { "shrink and grow a large stream", 100000 };
+
+      test.execute( Push { string( 100000, 'x' ) } );
+      test.execute( Pop { 99990 } );
+      test.execute( SetCapacity { 20 } );
+      test.execute( AvailableCapacity { 10 } );
+      test.execute( Push { "0123456789abc" } );
+      test.execute( Peek { "xxxxxxxxxx0123456789" } );
+      test.execute( SetCapacity { 100000 } );
+      test.execute( Push { string( 50000, 'y' ) } );
+      test.execute( BytesBuffered { 50020 } );
+      test.execute( AvailableCapacity { 49980 } );
+    }
+
+    {
+      ByteStreamTestHarness test { "shrink to fit keeps the contents and the capacity", 10 };
+
+      test.execute( Push { "hello" } );
+      test.execute( Pop { 2 } );
+      test.execute( ShrinkToFit {} );
+      test.execute( Peek { "llo" } );
+      test.execute( AvailableCapacity { 7 } );
+      test.execute( Pop { 3 } );
+      test.execute( ShrinkToFit {} );
+      test.execute( Push { "0123456789!" } );
+      test.execute( Peek { "0123456789" } );
+      test.execute( Close {} );
+      test.execute( Pop { 10 } );
+      test.execute( ShrinkToFit {} );
+      test.execute( IsFinished { true } );
+      test.execute( BytesPopped { 15 } );
+    }
+
+    {
+      ByteStreamTestHarness test { "memory is allocated as bytes are buffered, not for the whole capacity", 64000 };
+
+      test.execute( MemoryUsage { 0 } );
+      test.execute( Push { "hello" } ); // (fits in the string itself)
+      test.execute( MemoryUsage { 0 } );
+      test.execute( Push { string( 100, 'x' ) } );
+      test.execute( MemoryUsage { ByteStream::CHUNK_SIZE + 1 } );
+      test.execute( Push { string( ByteStream::CHUNK_SIZE, 'y' ) } );
+      test.execute( MemoryUsage { 2 * ByteStream::CHUNK_SIZE + 1 } );
+      test.execute( Pop { 105 + ByteStream::CHUNK_SIZE } );
+      test.execute( ShrinkToFit {} );
+      test.execute( MemoryUsage { 0 } );
+      test.execute( AvailableCapacity { 64000 } );
+    }
+
+    {
+      ByteStreamTestHarness test { "a moderated stream keeps to MIN_BUFFER past the memory budget's hard limit", 64000 };
+
+      ByteStream ballast { 64000 }; // (holds some memory, which is past these limits)
+      ballast.writer().push( string( 100, 'b' ) );
+      MemoryBudget::process().set_limits( 1, 1 );
+      test.execute( SetModerate { true } );
+      test.execute( AvailableCapacity { MemoryBudget::MIN_BUFFER } );
+      test.execute( Push { string( 2 * MemoryBudget::MIN_BUFFER, 'x' ) } );
+      test.execute( BytesBuffered { MemoryBudget::MIN_BUFFER } );
+      test.execute( AvailableCapacity { 0 } );
+      test.execute( Pop { 100 } );
+      test.execute( AvailableCapacity { 100 } );
+      test.execute( SetModerate { false } );
+      test.execute( AvailableCapacity { 64000 - MemoryBudget::MIN_BUFFER + 100 } );
+      MemoryBudget::process().set_limits( 0, 0 );
+      test.execute( SetModerate { true } );
+      test.execute( AvailableCapacity { 64000 - MemoryBudget::MIN_BUFFER + 100 } );
+    }
+
   } catch ( const exception& e ) {
     cerr << "Exception: " << e.what() << "\n";
     return EXIT_FAILURE;
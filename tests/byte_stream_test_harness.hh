@@ -57,8 +57,32 @@ struct Pop : public Action<ByteStream>
   constexpr std::string obj() const override { return "Reader"; }
 };
 
+struct SetCapacity : public Action<ByteStream>
+{
+  uint64_t capacity_;
+
+  explicit SetCapacity( uint64_t capacity ) : capacity_( capacity ) {}
+  std::string description() const override { return "set_capacity( " + std::to_string( capacity_ ) + " )"; }
+  void execute( ByteStream& bs ) const override { bs.set_capacity( capacity_ ); }
+};
+
+struct ShrinkToFit : public Action<ByteStream>
+{
+  std::string description() const override { return "shrink_to_fit"; }
+  void execute( ByteStream& bs ) const override { bs.shrink_to_fit(); }
+};
+
 /* expectations */
 
+struct SetModerate : public Action<ByteStream>
+{
+  bool moderate_;
+
+  explicit SetModerate( bool moderate ) : moderate_( moderate ) {}
+  std::string description() const override { return "set_moderate( " + std::to_string( moderate_ ) + " )"; }
+  void execute( ByteStream& bs ) const override { bs.set_moderate( moderate_ ); }
+};
+
 struct Peek : public Expectation<ByteStream>
 {
   std::string output_;
@@ -182,6 +206,13 @@ struct BytesPopped : public ExpectNumber<ByteStream, uint64_t>
   constexpr std::string obj() const override { return "Reader"; }
 };
 
+struct MemoryUsage : public ExpectNumber<ByteStream, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "memory_usage"; }
+  size_t value( const ByteStream& bs ) const override { return bs.memory_usage(); }
+};
+
 struct ReadAll : public Action<ByteStream>
 {
   std::string output_;
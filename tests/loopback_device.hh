@@ -0,0 +1,117 @@
+#pragma once
+
+#include "exception.hh"
+#include "helpers.hh"
+#include "ipv4_datagram.hh"
+#include "socket.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_segment.hh"
+#include "tuntap_adapter.hh"
+
+#include <array>
+#include <cerrno>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A datagram device over a connected UDP socket on the loopback interface, so that two TCPMinnowStacks can
+// talk to each other in one process without a TUN device (a full socket buffer drops datagrams, like a network,
+// and so does an other end that has gone away).
+class LoopbackDevice
+{
+  UDPSocket socket_;
+
+  static bool refused( const unix_error& e ) { return e.code().value() == ECONNREFUSED; }
+
+public:
+  explicit LoopbackDevice( UDPSocket&& socket ) : socket_( std::move( socket ) ) {}
+
+  std::optional<InternetDatagram> read()
+  {
+    std::vector<std::string> strs( 3 );
+    strs[0].resize( IPv4Header::LENGTH );
+    strs[1].resize( TCPSegment::HEADER_LENGTH );
+    try {
+      socket_.read( strs );
+    } catch ( const unix_error& e ) {
+      if ( not refused( e ) ) {
+        throw;
+      }
+      return {};
+    }
+
+    InternetDatagram ip_dgram;
+    if ( parse( ip_dgram, std::move( strs ) ) ) {
+      return ip_dgram;
+    }
+    return {};
+  }
+
+  void write( std::string_view headers, std::string_view payload )
+  {
+    try {
+      if ( payload.empty() ) {
+        socket_.write( headers );
+      } else {
+        socket_.write( std::array<std::string_view, 2> { headers, payload } );
+      }
+    } catch ( const unix_error& e ) {
+      if ( not refused( e ) ) {
+        throw;
+      }
+    }
+  }
+
+  FileDescriptor& fd() { return socket_; }
+};
+
+static_assert( IPv4DatagramDevice<LoopbackDevice> );
+
+// A datagram adapter over a LoopbackDevice, so that two TCPMinnowSockets can talk to each other the same way.
+// The datagrams are the same IPv4-wrapped segments that TCPOverIPv4OverTunFdAdapter reads and writes.
+class LoopbackAdapter : public TCPOverIPv4Adapter
+{
+  LoopbackDevice device_;
+  std::string headers_ {};
+
+public:
+  explicit LoopbackAdapter( UDPSocket&& socket ) : device_( std::move( socket ) ) {}
+
+  std::optional<TCPMessage> read()
+  {
+    if ( auto ip_dgram = device_.read() ) {
+      return unwrap_tcp_in_ip( std::move( ip_dgram.value() ) );
+    }
+    return {};
+  }
+
+  void write( const TCPMessage& seg ) { write( std::span { &seg, 1 } ); }
+
+  void write( std::span<const TCPMessage> batch )
+  {
+    for ( const auto& seg : batch ) {
+      segment_tcp_in_ip( seg, headers_, [&]( std::string_view headers, std::string_view payload ) {
+        device_.write( headers, payload );
+      } );
+    }
+  }
+
+  FileDescriptor& fd() { return device_.fd(); }
+};
+
+static_assert( TCPDatagramAdapter<LoopbackAdapter> );
+
+// Two UDP sockets on 127.0.0.1, connected to each other
+inline std::pair<UDPSocket, UDPSocket> loopback_pair()
+{
+  UDPSocket a;
+  UDPSocket b;
+  a.bind( Address { "127.0.0.1", 0 } );
+  b.bind( Address { "127.0.0.1", 0 } );
+  a.connect( b.local_address() );
+  b.connect( a.local_address() );
+  return { std::move( a ), std::move( b ) };
+}
@@ -0,0 +1,128 @@
+#include "peer_test_harness.hh"
+#include "random.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+    const auto config = [&] {
+      TCPConfig cfg;
+      cfg.isn = Wrap32 { uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd ) };
+      cfg.mss = 100;
+      cfg.ack_delay = 40;
+      return cfg;
+    };
+
+    {
+      const TCPConfig cfg = config();
+      const Wrap32 isn = cfg.isn;
+      const Wrap32 rx( rd() );
+      TCPPeerTestHarness test { "In-order data is acknowledged once two full-sized segments have arrived", cfg };
+      handshake( test, isn, rx );
+      test.execute( SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 1 ).with_data( string( 100, 'a' ) ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( SegmentArrives {}.with_seqno( rx + 101 ).with_ackno( isn + 1 ).with_data( string( 100, 'b' ) ) );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ).with_data( "" ).with_ackno( rx + 201 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( SegmentArrives {}.with_seqno( rx + 201 ).with_ackno( isn + 1 ).with_data( string( 150, 'c' ) ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( SegmentArrives {}.with_seqno( rx + 351 ).with_ackno( isn + 1 ).with_data( string( 50, 'd' ) ) );
+      test.execute( ExpectMessage {}.with_data( "" ).with_ackno( rx + 401 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { cfg.ack_delay } );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      const TCPConfig cfg = config();
+      const Wrap32 isn = cfg.isn;
+      const Wrap32 rx( rd() );
+      TCPPeerTestHarness test { "A delayed ACK is sent on its own when the timer runs out", cfg };
+      handshake( test, isn, rx );
+      test.execute( SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 1 ).with_data( "hello" ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { cfg.ack_delay - 1 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( SegmentArrives {}.with_seqno( rx + 6 ).with_ackno( isn + 1 ).with_data( " world" ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ).with_data( "" ).with_ackno( rx + 12 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { cfg.ack_delay } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectInbound { "hello world" } );
+    }
+
+    {
+      const TCPConfig cfg = config();
+      const Wrap32 isn = cfg.isn;
+      const Wrap32 rx( rd() );
+      TCPPeerTestHarness test { "Outgoing data carries a pending ACK, which is then not sent again", cfg };
+      handshake( test, isn, rx );
+      test.execute( SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 1 ).with_data( "ping" ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { cfg.ack_delay / 2 } );
+      test.execute( Write { "pong" } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ).with_data( "pong" ).with_ackno( rx + 5 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { cfg.ack_delay } );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      const TCPConfig cfg = config();
+      const Wrap32 isn = cfg.isn;
+      const Wrap32 rx( rd() );
+      TCPPeerTestHarness test { "Out-of-order data, and data filling the hole, are acknowledged at once", cfg };
+      handshake( test, isn, rx );
+      test.execute( SegmentArrives {}.with_seqno( rx + 4 ).with_ackno( isn + 1 ).with_data( "def" ) );
+      test.execute( ExpectMessage {}.with_data( "" ).with_ackno( rx + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 1 ).with_data( "abc" ) );
+      test.execute( ExpectMessage {}.with_data( "" ).with_ackno( rx + 7 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectInbound { "abcdef" } );
+    }
+
+    {
+      const TCPConfig cfg = config();
+      const Wrap32 isn = cfg.isn;
+      const Wrap32 rx( rd() );
+      TCPPeerTestHarness test { "A FIN is acknowledged at once", cfg };
+      handshake( test, isn, rx );
+      test.execute( SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 1 ).with_data( "abc" ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( SegmentArrives {}.with_seqno( rx + 4 ).with_ackno( isn + 1 ).with_fin() );
+      test.execute( ExpectMessage {}.with_data( "" ).with_ackno( rx + 5 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectInboundFinished { true } );
+    }
+
+    {
+      TCPConfig cfg = config();
+      cfg.ack_delay = 0;
+      const Wrap32 isn = cfg.isn;
+      const Wrap32 rx( rd() );
+      TCPPeerTestHarness test { "With no ACK delay, every segment is acknowledged at once", cfg };
+      handshake( test, isn, rx );
+      test.execute( SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 1 ).with_data( "abc" ) );
+      test.execute( ExpectMessage {}.with_data( "" ).with_ackno( rx + 4 ) );
+      test.execute( SegmentArrives {}.with_seqno( rx + 4 ).with_ackno( isn + 1 ).with_data( "def" ) );
+      test.execute( ExpectMessage {}.with_data( "" ).with_ackno( rx + 7 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,144 @@
+#include "ipv4_header.hh"
+#include "peer_test_harness.hh"
+#include "random.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+    const auto config = [&] {
+      TCPConfig cfg;
+      cfg.isn = Wrap32 { uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd ) };
+      cfg.mss = 100;
+      cfg.ack_delay = 40;
+      return cfg;
+    };
+
+    {
+      const TCPConfig cfg = config();
+      const Wrap32 isn = cfg.isn;
+      const Wrap32 rx( rd() );
+      TCPPeerTestHarness test { "In-order data on an established connection takes the fast path", cfg };
+      handshake( test, isn, rx );
+      test.execute( ExpectFastPathHits { 0 } );
+      test.execute( SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 1 ).with_data( "abc" ) );
+      test.execute( ExpectFastPathHits { 1 } );
+      test.execute( SegmentArrives {}.with_seqno( rx + 4 ).with_ackno( isn + 1 ).with_data( "def" ) );
+      test.execute( ExpectFastPathHits { 2 } );
+      test.execute( ExpectSegmentsReceived { 4 } );
+      test.execute( ExpectInbound { "abcdef" } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { cfg.ack_delay } );
+      test.execute( ExpectMessage {}.with_data( "" ).with_ackno( rx + 7 ) );
+    }
+
+    {
+      TCPConfig cfg = config();
+      cfg.coalescing = TCPCoalescing::Nagle;
+      const Wrap32 isn = cfg.isn;
+      const Wrap32 rx( rd() );
+      TCPPeerTestHarness test { "A pure ACK for new data takes the fast path, and lets the sender go on", cfg };
+      handshake( test, isn, rx );
+      test.execute( Write { "abc" } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ).with_data( "abc" ) );
+      test.execute( Write { "def" } );
+      test.execute( ExpectNoSegment {} ); // (Nagle: held while "abc" is unacknowledged)
+      test.execute( SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 4 ) );
+      test.execute( ExpectFastPathHits { 1 } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 4 ).with_data( "def" ) );
+      test.execute( ExpectSeqnosInFlight { 3 } );
+      test.execute( SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 4 ) );
+      test.execute( ExpectFastPathHits { 1 } ); // (a duplicate ACK is not predicted)
+      test.execute( SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 7 ) );
+      test.execute( ExpectFastPathHits { 2 } );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      const TCPConfig cfg = config();
+      const Wrap32 isn = cfg.isn;
+      const Wrap32 rx( rd() );
+      TCPPeerTestHarness test { "Segments that are not in-order data or a pure new ACK take the general path", cfg };
+      handshake( test, isn, rx );
+
+      // out of order
+      test.execute( SegmentArrives {}.with_seqno( rx + 4 ).with_ackno( isn + 1 ).with_data( "def" ) );
+      test.execute( ExpectFastPathHits { 0 } );
+      test.execute( ExpectMessage {}.with_data( "" ).with_ackno( rx + 1 ) );
+
+      // filling the hole
+      test.execute( SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 1 ).with_data( "abc" ) );
+      test.execute( ExpectFastPathHits { 0 } );
+      test.execute( ExpectMessage {}.with_data( "" ).with_ackno( rx + 7 ) );
+
+      // a new window
+      test.execute( SegmentArrives {}.with_seqno( rx + 7 ).with_ackno( isn + 1 ).with_win( 1000 ).with_data( "g" ) );
+      test.execute( ExpectFastPathHits { 0 } );
+
+      // and then the same window again: predicted
+      test.execute( SegmentArrives {}.with_seqno( rx + 8 ).with_ackno( isn + 1 ).with_win( 1000 ).with_data( "h" ) );
+      test.execute( ExpectFastPathHits { 1 } );
+
+      // a congestion mark, echoed at once
+      test.execute(
+        SegmentArrives {}.with_seqno( rx + 9 ).with_ackno( isn + 1 ).with_win( 1000 ).with_data( "i" ).with_ecn(
+          IPv4Header::ECN_CE ) );
+      test.execute( ExpectFastPathHits { 1 } );
+      test.execute( ExpectMessage {}.with_data( "" ).with_ackno( rx + 10 ) );
+
+      // a FIN
+      test.execute( SegmentArrives {}.with_seqno( rx + 10 ).with_ackno( isn + 1 ).with_win( 1000 ).with_fin() );
+      test.execute( ExpectFastPathHits { 1 } );
+      test.execute( ExpectMessage {}.with_data( "" ).with_ackno( rx + 11 ) );
+      test.execute( ExpectInbound { "abcdefghi" } );
+      test.execute( ExpectInboundFinished { true } );
+      test.execute( ExpectSegmentsReceived { 8 } );
+    }
+
+    {
+      const TCPConfig cfg = config();
+      const Wrap32 isn = cfg.isn;
+      const Wrap32 rx( rd() );
+      TCPPeerTestHarness test { "A zero window is never predicted", cfg };
+      handshake( test, isn, rx );
+      test.execute( SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 1 ).with_win( 0 ).with_data( "abc" ) );
+      test.execute( ExpectFastPathHits { 0 } );
+      test.execute( SegmentArrives {}.with_seqno( rx + 4 ).with_ackno( isn + 1 ).with_win( 0 ).with_data( "def" ) );
+      test.execute( ExpectFastPathHits { 0 } );
+      test.execute( ExpectInbound { "abcdef" } );
+    }
+
+    {
+      TCPConfig cfg = config();
+      cfg.ecn = true;
+      const Wrap32 isn = cfg.isn;
+      const Wrap32 rx( rd() );
+      TCPPeerTestHarness test { "In-order data that echoes congestion takes the general path, and the sender heeds it",
+                                cfg };
+      test.execute( SegmentArrives {}.with_syn().with_cwr().with_ece().with_seqno( rx ) );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ).with_ackno( rx + 1 ) );
+      test.execute( SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 1 ) );
+      test.execute( Write { string( 600, 'x' ) } );
+      test.execute( ExpectSeqnosInFlight { 600 } );
+      test.execute( ExpectCongestionWindow { UINT64_MAX } );
+      test.execute( SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 1 ).with_ece().with_data( "abc" ) );
+      test.execute( ExpectFastPathHits { 0 } );
+      test.execute( ExpectCongestionWindow { 300 } );
+      test.execute( ExpectInbound { "abc" } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+#include "byte_stream.hh"
+#include "memory_budget.hh"
+#include "peer_test_harness.hh"
+#include "random.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+    const auto config = [&] {
+      TCPConfig cfg;
+      cfg.isn = Wrap32 { uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd ) };
+      cfg.mss = 100;
+      cfg.ack_delay = 0;
+      cfg.recv_capacity = 20000;
+      return cfg;
+    };
+
+    ByteStream ballast { 64000 }; // (holds some memory, which is past the limits set below)
+    ballast.writer().push( string( 100, 'b' ) );
+
+    {
+      const TCPConfig cfg = config();
+      const Wrap32 isn = cfg.isn;
+      const Wrap32 rx( rd() );
+      TCPPeerTestHarness test { "Memory pressure does not move back the right edge of the advertised window", cfg };
+      handshake( test, isn, rx );
+      MemoryBudget::process().set_limits( 1, 1 );
+      test.execute( SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 1 ).with_data( string( 100, 'a' ) ) );
+      test.execute( ExpectMessage {}.with_ackno( rx + 101 ).with_win( 19900 ) );
+      test.execute( SegmentArrives {}.with_seqno( rx + 5001 ).with_ackno( isn + 1 ).with_data( "z" ) );
+      test.execute( ExpectMessage {}.with_ackno( rx + 101 ).with_win( 19900 ) );
+      test.execute( SegmentArrives {}.with_seqno( rx + 101 ).with_ackno( isn + 1 ).with_data( string( 19900, 'c' ) ) );
+      test.execute( ExpectMessage {}.with_ackno( rx + 20001 ).with_win( 0 ) );
+      test.execute( ExpectInbound { string( 100, 'a' ) + string( 19900, 'c' ) } );
+      test.execute( ExpectNoSegment {} );
+      MemoryBudget::process().set_limits( 0, 0 );
+    }
+
+    {
+      const TCPConfig cfg = config();
+      const Wrap32 isn = cfg.isn;
+      const Wrap32 rx( rd() );
+      TCPPeerTestHarness test { "Past the hard limit, stored out-of-order data is dropped once the hole is filled",
+                                cfg };
+      handshake( test, isn, rx );
+      test.execute( SegmentArrives {}.with_seqno( rx + 4 ).with_ackno( isn + 1 ).with_data( "def" ) );
+      test.execute( ExpectMessage {}.with_ackno( rx + 1 ) );
+      test.execute( SegmentArrives {}.with_seqno( rx + 10 ).with_ackno( isn + 1 ).with_data( "jkl" ) );
+      test.execute( ExpectMessage {}.with_ackno( rx + 1 ) );
+      MemoryBudget::process().set_limits( 1, 1 );
+      test.execute( SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 1 ).with_data( "abc" ) );
+      test.execute( ExpectMessage {}.with_ackno( rx + 7 ) );
+      test.execute( SegmentArrives {}.with_seqno( rx + 7 ).with_ackno( isn + 1 ).with_data( "ghi" ) );
+      test.execute( ExpectMessage {}.with_ackno( rx + 10 ) );
+      test.execute( ExpectInbound { "abcdefghi" } );
+      MemoryBudget::process().set_limits( 0, 0 );
+    }
+
+    {
+      const TCPConfig cfg = config();
+      const Wrap32 isn = cfg.isn;
+      const Wrap32 rx( rd() );
+      TCPPeerTestHarness test { "Past the hard limit, more out-of-order data drops what is stored", cfg };
+      handshake( test, isn, rx );
+      test.execute( SegmentArrives {}.with_seqno( rx + 4 ).with_ackno( isn + 1 ).with_data( "def" ) );
+      test.execute( ExpectMessage {}.with_ackno( rx + 1 ) );
+      MemoryBudget::process().set_limits( 1, 1 );
+      test.execute( SegmentArrives {}.with_seqno( rx + 10 ).with_ackno( isn + 1 ).with_data( "jkl" ) );
+      test.execute( ExpectMessage {}.with_ackno( rx + 1 ) );
+      test.execute( SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 1 ).with_data( "abc" ) );
+      test.execute( ExpectMessage {}.with_ackno( rx + 4 ) );
+      test.execute( ExpectInbound { "abc" } );
+      MemoryBudget::process().set_limits( 0, 0 );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+#include "peer_test_harness.hh"
+#include "random.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+    const auto config = [&] {
+      TCPConfig cfg;
+      cfg.isn = Wrap32 { uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd ) };
+      cfg.mss = 100;
+      cfg.ack_delay = 40;
+      return cfg;
+    };
+
+    {
+      TCPConfig cfg = config();
+      cfg.ack_delay = 0;
+      const Wrap32 isn = cfg.isn;
+      const Wrap32 rx( rd() );
+      TCPPeerTestHarness test { "A run of in-order segments is received as one, and acknowledged once", cfg };
+      handshake( test, isn, rx );
+      test.execute( ExpectSegmentsReceived { 2 } );
+      test.execute( BatchArrives { {
+        SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 1 ).with_data( string( 40, 'a' ) ),
+        SegmentArrives {}.with_seqno( rx + 41 ).with_ackno( isn + 1 ).with_data( string( 40, 'b' ) ),
+        SegmentArrives {}.with_seqno( rx + 81 ).with_ackno( isn + 1 ).with_data( string( 40, 'c' ) ),
+      } } );
+      test.execute( ExpectSegmentsReceived { 3 } );
+      test.execute( ExpectMessage {}.with_data( "" ).with_ackno( rx + 121 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectInbound { string( 40, 'a' ) + string( 40, 'b' ) + string( 40, 'c' ) } );
+    }
+
+    {
+      const TCPConfig cfg = config();
+      const Wrap32 isn = cfg.isn;
+      const Wrap32 rx( rd() );
+      TCPPeerTestHarness test { "A merged run is held for a delayed ACK like a single segment", cfg };
+      handshake( test, isn, rx );
+      test.execute( BatchArrives { {
+        SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 1 ).with_data( "abc" ),
+        SegmentArrives {}.with_seqno( rx + 4 ).with_ackno( isn + 1 ).with_data( "def" ),
+      } } );
+      test.execute( ExpectSegmentsReceived { 3 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { cfg.ack_delay } );
+      test.execute( ExpectMessage {}.with_data( "" ).with_ackno( rx + 7 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( BatchArrives { {
+        SegmentArrives {}.with_seqno( rx + 7 ).with_ackno( isn + 1 ).with_data( string( 100, 'g' ) ),
+        SegmentArrives {}.with_seqno( rx + 107 ).with_ackno( isn + 1 ).with_data( string( 100, 'h' ) ),
+      } } );
+      test.execute( ExpectSegmentsReceived { 4 } );
+      test.execute( ExpectMessage {}.with_data( "" ).with_ackno( rx + 207 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      const TCPConfig cfg = config();
+      const Wrap32 isn = cfg.isn;
+      const Wrap32 rx( rd() );
+      TCPPeerTestHarness test { "A gap in the batch ends a run", cfg };
+      handshake( test, isn, rx );
+      test.execute( BatchArrives { {
+        SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 1 ).with_data( "abcde" ),
+        SegmentArrives {}.with_seqno( rx + 11 ).with_ackno( isn + 1 ).with_data( "klmno" ),
+        SegmentArrives {}.with_seqno( rx + 16 ).with_ackno( isn + 1 ).with_data( "pqrst" ),
+      } } );
+      test.execute( ExpectSegmentsReceived { 4 } );
+      test.execute( ExpectMessage {}.with_data( "" ).with_ackno( rx + 6 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectInbound { "abcde" } );
+      test.execute( SegmentArrives {}.with_seqno( rx + 6 ).with_ackno( isn + 1 ).with_data( "fghij" ) );
+      test.execute( ExpectMessage {}.with_data( "" ).with_ackno( rx + 21 ) );
+      test.execute( ExpectInbound { "abcdefghijklmnopqrst" } );
+    }
+
+    {
+      const TCPConfig cfg = config();
+      const Wrap32 isn = cfg.isn;
+      const Wrap32 rx( rd() );
+      TCPPeerTestHarness test { "Segments carrying a different acknowledgment are received separately", cfg };
+      handshake( test, isn, rx );
+      test.execute( Write { "xyz" } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ).with_data( "xyz" ) );
+      test.execute( ExpectSeqnosInFlight { 3 } );
+      test.execute( BatchArrives { {
+        SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 1 ).with_data( "abc" ),
+        SegmentArrives {}.with_seqno( rx + 4 ).with_ackno( isn + 4 ).with_data( "def" ),
+        SegmentArrives {}.with_seqno( rx + 7 ).with_ackno( isn + 4 ).with_data( "ghi" ),
+      } } );
+      test.execute( ExpectSegmentsReceived { 4 } );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+      test.execute( ExpectInbound { "abcdefghi" } );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      const TCPConfig cfg = config();
+      const Wrap32 isn = cfg.isn;
+      const Wrap32 rx( rd() );
+      TCPPeerTestHarness test { "A FIN may end a run, and is acknowledged at once", cfg };
+      handshake( test, isn, rx );
+      test.execute( BatchArrives { {
+        SegmentArrives {}.with_seqno( rx + 1 ).with_ackno( isn + 1 ).with_data( "abc" ),
+        SegmentArrives {}.with_seqno( rx + 4 ).with_ackno( isn + 1 ).with_data( "def" ).with_fin(),
+      } } );
+      test.execute( ExpectSegmentsReceived { 3 } );
+      test.execute( ExpectMessage {}.with_data( "" ).with_ackno( rx + 8 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectInbound { "abcdef" } );
+      test.execute( ExpectInboundFinished { true } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
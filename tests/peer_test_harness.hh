@@ -0,0 +1,373 @@
+#pragma once
+
+#include "common.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_receiver_message.hh"
+#include "tcp_segment.hh"
+#include "tcp_sender_message.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <optional>
+#include <queue>
+#include <span>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct PeerAndOutput
+{
+  TCPPeer peer;
+  std::queue<TCPMessage> output {};
+
+  auto make_transmit()
+  {
+    return [&]( std::span<const TCPMessage> batch ) {
+      for ( const auto& msg : batch ) {
+        output.push( { .sender = TCPSenderMessage( msg.sender.get() ),
+                       .receiver = TCPReceiverMessage( msg.receiver.get() ) } );
+      }
+    };
+  }
+
+  TCPMessage expect_message() const
+  {
+    if ( output.empty() ) {
+      throw ExpectationViolation( "should have sent a message" );
+    }
+    auto& mutable_output = const_cast<decltype( output )&>( output ); // NOLINT(*-const-cast)
+    TCPMessage ret { std::move( mutable_output.front() ) };
+    mutable_output.pop();
+    return ret;
+  }
+};
+
+class TCPPeerTestHarness : public TestHarness<PeerAndOutput>
+{
+public:
+  TCPPeerTestHarness( std::string name, const TCPConfig& config )
+    : TestHarness( move( name ),
+                   "ISN=" + to_string( config.isn ) + ", mss=" + std::to_string( config.mss )
+                     + " and ack_delay=" + std::to_string( config.ack_delay ),
+                   { .peer = TCPPeer { config } } )
+  {}
+};
+
+// A message from the remote end: a segment (with seqno, flags and payload) and its acknowledgment and window
+struct SegmentArrives : public Action<PeerAndOutput>
+{
+  TCPSenderMessage seg_ {};
+  TCPReceiverMessage ack_ { .ackno = {}, .window_size = UINT16_MAX };
+
+  SegmentArrives& with_syn()
+  {
+    seg_.SYN = true;
+    return *this;
+  }
+
+  SegmentArrives& with_fin()
+  {
+    seg_.FIN = true;
+    return *this;
+  }
+
+  SegmentArrives& with_cwr()
+  {
+    seg_.CWR = true;
+    return *this;
+  }
+
+  SegmentArrives& with_ece()
+  {
+    ack_.ECE = true;
+    return *this;
+  }
+
+  SegmentArrives& with_seqno( Wrap32 seqno )
+  {
+    seg_.seqno = seqno;
+    return *this;
+  }
+
+  SegmentArrives& with_seqno( uint32_t seqno ) { return with_seqno( Wrap32 { seqno } ); }
+
+  SegmentArrives& with_data( std::string data )
+  {
+    seg_.payload = move( data );
+    return *this;
+  }
+
+  SegmentArrives& with_ecn( uint8_t ecn )
+  {
+    seg_.ecn = ecn;
+    return *this;
+  }
+
+  SegmentArrives& with_ackno( Wrap32 ackno )
+  {
+    ack_.ackno = ackno;
+    return *this;
+  }
+
+  SegmentArrives& with_win( uint16_t win )
+  {
+    ack_.window_size = win;
+    return *this;
+  }
+
+  TCPMessage message() const
+  {
+    return { .sender = TCPSenderMessage( seg_ ), .receiver = TCPReceiverMessage( ack_ ) };
+  }
+
+  std::string description() const override
+  {
+    std::ostringstream desc;
+    desc << "receive " << to_string( seg_ ) << " with ack=" << to_string( ack_.ackno )
+         << ", win=" << ack_.window_size;
+    return desc.str();
+  }
+
+  void execute( PeerAndOutput& pa ) const override { pa.peer.receive( message(), pa.make_transmit() ); }
+
+  constexpr std::string obj() const override { return "TCPPeer"; }
+};
+
+// Messages from the remote end that arrived together, handed to TCPPeer::receive_batch
+struct BatchArrives : public Action<PeerAndOutput>
+{
+  std::vector<SegmentArrives> segments_;
+
+  explicit BatchArrives( std::vector<SegmentArrives> segments ) : segments_( move( segments ) ) {}
+
+  std::string description() const override
+  {
+    std::ostringstream desc;
+    desc << "receive a batch of " << segments_.size() << ":";
+    for ( const auto& seg : segments_ ) {
+      desc << "\n\t\t" << to_string( seg.seg_ );
+    }
+    return desc.str();
+  }
+
+  void execute( PeerAndOutput& pa ) const override
+  {
+    std::vector<TCPMessage> batch;
+    for ( const auto& seg : segments_ ) {
+      batch.push_back( seg.message() );
+    }
+    pa.peer.receive_batch( batch, pa.make_transmit() );
+  }
+
+  constexpr std::string obj() const override { return "TCPPeer"; }
+};
+
+struct Write : public Action<PeerAndOutput>
+{
+  std::string data_;
+
+  explicit Write( std::string data ) : data_( move( data ) ) {}
+  std::string description() const override { return "write \"" + pretty_print( data_ ) + "\", then push"; }
+
+  void execute( PeerAndOutput& pa ) const override
+  {
+    pa.peer.outbound_writer().push( data_ );
+    pa.peer.push( pa.make_transmit() );
+  }
+
+  constexpr std::string obj() const override { return "TCPPeer"; }
+};
+
+struct Tick : public Action<PeerAndOutput>
+{
+  uint64_t ms_;
+
+  explicit Tick( uint64_t ms ) : ms_( ms ) {}
+  std::string description() const override { return std::to_string( ms_ ) + " ms pass"; }
+  void execute( PeerAndOutput& pa ) const override { pa.peer.tick( ms_, pa.make_transmit() ); }
+  constexpr std::string obj() const override { return "TCPPeer"; }
+};
+
+struct ExpectMessage : public Expectation<PeerAndOutput>
+{
+  std::optional<bool> syn {};
+  std::optional<bool> fin {};
+  std::optional<Wrap32> seqno {};
+  std::optional<std::string> data {};
+  std::optional<Wrap32> ackno {};
+  std::optional<uint16_t> win {};
+
+  ExpectMessage& with_syn( bool syn_ )
+  {
+    syn = syn_;
+    return *this;
+  }
+
+  ExpectMessage& with_fin( bool fin_ )
+  {
+    fin = fin_;
+    return *this;
+  }
+
+  ExpectMessage& with_seqno( Wrap32 seqno_ )
+  {
+    seqno = seqno_;
+    return *this;
+  }
+
+  ExpectMessage& with_data( std::string data_ )
+  {
+    data = std::move( data_ );
+    return *this;
+  }
+
+  ExpectMessage& with_ackno( Wrap32 ackno_ )
+  {
+    ackno = ackno_;
+    return *this;
+  }
+
+  ExpectMessage& with_win( uint16_t win_ )
+  {
+    win = win_;
+    return *this;
+  }
+
+  std::string description() const override
+  {
+    std::ostringstream o;
+    o << "message sent";
+    if ( seqno.has_value() ) {
+      o << " seqno=" << seqno.value();
+    }
+    if ( syn.has_value() ) {
+      o << ( syn.value() ? " +SYN" : " -SYN" );
+    }
+    if ( data.has_value() ) {
+      o << ( data->empty() ? " (no payload)" : " payload=\"" + pretty_print( data.value(), 32 ) + "\"" );
+    }
+    if ( fin.has_value() ) {
+      o << ( fin.value() ? " +FIN" : " -FIN" );
+    }
+    if ( ackno.has_value() ) {
+      o << " ackno=" << ackno.value();
+    }
+    if ( win.has_value() ) {
+      o << " win=" << win.value();
+    }
+    return o.str();
+  }
+
+  void execute( const PeerAndOutput& pa ) const override
+  {
+    const TCPMessage msg = pa.expect_message();
+    const TCPSenderMessage& seg = msg.sender;
+    const std::string sent
+      = "sent a message " + to_string( seg ) + " with ack=" + to_string( msg.receiver->ackno );
+    if ( syn.has_value() and seg.SYN != syn.value() ) {
+      throw ExpectationViolation( sent + " that should have had SYN flag = " + to_string( syn.value() ) );
+    }
+    if ( fin.has_value() and seg.FIN != fin.value() ) {
+      throw ExpectationViolation( sent + " that should have had FIN flag = " + to_string( fin.value() ) );
+    }
+    if ( seqno.has_value() and seg.seqno != seqno.value() ) {
+      throw ExpectationViolation( sent + " that should have had seqno = " + to_string( seqno.value() ) );
+    }
+    if ( data.has_value() and seg.payload != data.value() ) {
+      throw ExpectationViolation( sent + " that should have had payload \"" + pretty_print( data.value(), 32 )
+                                  + "\"" );
+    }
+    if ( ackno.has_value() and msg.receiver->ackno != ackno ) {
+      throw ExpectationViolation( sent + " that should have had ackno = " + to_string( ackno.value() ) );
+    }
+    if ( win.has_value() and msg.receiver->window_size != win.value() ) {
+      throw ExpectationViolation( sent + " that should have had window " + std::to_string( win.value() )
+                                  + ", not " + std::to_string( msg.receiver->window_size ) );
+    }
+  }
+
+  constexpr std::string obj() const override { return "TCPPeer"; }
+};
+
+struct ExpectNoSegment : public Expectation<PeerAndOutput>
+{
+  std::string description() const override { return "nothing to send"; }
+  void execute( const PeerAndOutput& pa ) const override
+  {
+    if ( not pa.output.empty() ) {
+      throw ExpectationViolation( "sent a message " + to_string( pa.output.front().sender.get() )
+                                  + " with ack=" + to_string( pa.output.front().receiver->ackno )
+                                  + " when none was expected" );
+    }
+  }
+  constexpr std::string obj() const override { return "TCPPeer"; }
+};
+
+struct ExpectInbound : public Expectation<PeerAndOutput>
+{
+  std::string data_;
+
+  explicit ExpectInbound( std::string data ) : data_( move( data ) ) {}
+  std::string description() const override { return "inbound stream holds \"" + pretty_print( data_ ) + "\""; }
+  void execute( const PeerAndOutput& pa ) const override
+  {
+    const std::string_view buffered = pa.peer.receiver().reader().peek();
+    if ( buffered != data_ ) {
+      throw ExpectationViolation( "inbound stream", data_, std::string { buffered } );
+    }
+  }
+  constexpr std::string obj() const override { return "TCPPeer"; }
+};
+
+struct ExpectInboundFinished : public ExpectBool<PeerAndOutput>
+{
+  using ExpectBool::ExpectBool;
+  std::string name() const override { return "inbound writer closed"; }
+  bool value( const PeerAndOutput& pa ) const override { return pa.peer.receiver().writer().is_closed(); }
+  constexpr std::string obj() const override { return "TCPPeer"; }
+};
+
+struct ExpectSegmentsReceived : public ExpectNumber<PeerAndOutput, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "segments_received"; }
+  uint64_t value( const PeerAndOutput& pa ) const override { return pa.peer.segments_received(); }
+  constexpr std::string obj() const override { return "TCPPeer"; }
+};
+
+struct ExpectFastPathHits : public ExpectNumber<PeerAndOutput, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "fast_path_hits"; }
+  uint64_t value( const PeerAndOutput& pa ) const override { return pa.peer.fast_path_hits(); }
+  constexpr std::string obj() const override { return "TCPPeer"; }
+};
+
+struct ExpectCongestionWindow : public ExpectNumber<PeerAndOutput, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "congestion_window"; }
+  uint64_t value( const PeerAndOutput& pa ) const override { return pa.peer.sender().congestion_window(); }
+  constexpr std::string obj() const override { return "TCPPeer"; }
+};
+
+struct ExpectSeqnosInFlight : public ExpectNumber<PeerAndOutput, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "sequence_numbers_in_flight"; }
+  uint64_t value( const PeerAndOutput& pa ) const override { return pa.peer.sender().sequence_numbers_in_flight(); }
+  constexpr std::string obj() const override { return "TCPPeer"; }
+};
+
+// Take the peer through a passive open: the remote end's SYN (ISN `remote_isn`) arrives, the peer answers with
+// its SYN-ACK, and the remote end's ACK arrives. The peer is then established with nothing outstanding.
+inline void handshake( TCPPeerTestHarness& test, Wrap32 isn, Wrap32 remote_isn )
+{
+  test.execute( SegmentArrives {}.with_syn().with_seqno( remote_isn ) );
+  test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ).with_ackno( remote_isn + 1 ) );
+  test.execute( ExpectNoSegment {} );
+  test.execute( SegmentArrives {}.with_seqno( remote_isn + 1 ).with_ackno( isn + 1 ) );
+  test.execute( ExpectNoSegment {} );
+}
@@ -72,6 +72,14 @@ struct ExpectAckno : public ExpectNumber<TCPReceiver, std::optional<Wrap32>>
   std::optional<Wrap32> value( const TCPReceiver& rs ) const override { return rs.send().ackno; }
 };
 
+struct ExpectEce : public ExpectBool<TCPReceiver>
+{
+  using ExpectBool::ExpectBool;
+  std::string name() const override { return "ECE"; }
+
+  bool value( const TCPReceiver& rs ) const override { return rs.send().ECE; }
+};
+
 struct ExpectReset : public ExpectBool<TCPReceiver>
 {
   using ExpectBool::ExpectBool;
@@ -115,6 +123,15 @@ struct HasAckno : public ExpectBool<TCPReceiver>
   bool value( const TCPReceiver& rs ) const override { return rs.send().ackno.has_value(); }
 };
 
+struct SetFastOpenCookie : public Action<TCPReceiver>
+{
+  std::string cookie_;
+
+  explicit SetFastOpenCookie( std::string cookie ) : cookie_( move( cookie ) ) {}
+  std::string description() const override { return "set_fast_open_cookie(\"" + pretty_print( cookie_ ) + "\")"; }
+  void execute( TCPReceiver& rs ) const override { rs.set_fast_open_cookie( cookie_ ); }
+};
+
 struct SegmentArrives : public Action<TCPReceiver>
 {
   TCPSenderMessage msg_ {};
@@ -152,6 +169,24 @@ struct SegmentArrives : public Action<TCPReceiver>
     return *this;
   }
 
+  SegmentArrives& with_cwr()
+  {
+    msg_.CWR = true;
+    return *this;
+  }
+
+  SegmentArrives& with_ecn( uint8_t ecn )
+  {
+    msg_.ecn = ecn;
+    return *this;
+  }
+
+  SegmentArrives& with_fast_open( std::string cookie )
+  {
+    msg_.fast_open = move( cookie );
+    return *this;
+  }
+
   SegmentArrives& without_ackno()
   {
     ackno_expected_ = HasAckno { false };
@@ -60,6 +60,23 @@ int main()
       test.execute( IsClosed { true } );
       test.execute( IsFinished { true } );
     }
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "retransmissions arriving after the FIN do not end the stream early", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 7 ).with_data( "ghi" ).with_fin() );
+      test.execute( ExpectAckno { Wrap32 { isn + 4 } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 4 ).with_data( "de" ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 6 } } );
+      test.execute( IsClosed { false } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 6 ).with_data( "f" ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 11 } } );
+      test.execute( IsClosed { true } );
+      test.execute( ReadAll { "abcdefghi" } );
+      test.execute( IsFinished { true } );
+    }
   } catch ( const exception& e ) {
     cerr << e.what() << "\n";
     return 1;
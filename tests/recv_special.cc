@@ -291,6 +291,50 @@ int main()
       test.execute( SegmentArrives {}.with_fin().with_seqno( isn + 2 ) );
       test.execute( ExpectAckno { Wrap32 { isn + 3 } } );
     }
+
+    // TCP Fast Open: data on the SYN only with the right cookie
+    {
+      const uint32_t isn = 5000;
+      TCPReceiverTestHarness test { "SYN data with a valid Fast Open cookie", 4000 };
+      test.execute( SetFastOpenCookie { "good" } );
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_data( "hello" ).with_fast_open( "good" ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 6 } } );
+      test.execute( ReadAll { "hello" } );
+    }
+
+    {
+      const uint32_t isn = 5000;
+      TCPReceiverTestHarness test { "SYN data with an invalid Fast Open cookie", 4000 };
+      test.execute( SetFastOpenCookie { "good" } );
+      test.execute(
+        SegmentArrives {}.with_syn().with_seqno( isn ).with_data( "hello" ).with_fin().with_fast_open( "bad" ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 1 } } );
+      test.execute( BytesPushed { 0 } );
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_data( "hello" ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 1 } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "hello" ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 6 } } );
+      test.execute( ReadAll { "hello" } );
+    }
+
+    // ECN: echo a congestion mark until the sender reduces its window
+    {
+      const uint32_t isn = 7000;
+      TCPReceiverTestHarness test { "ECE from a CE mark until CWR", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( ExpectEce { false } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "a" ).with_ecn( IPv4Header::ECN_ECT0 ) );
+      test.execute( ExpectEce { false } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 2 ).with_data( "b" ).with_ecn( IPv4Header::ECN_CE ) );
+      test.execute( ExpectEce { true } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 3 ).with_data( "c" ).with_ecn( IPv4Header::ECN_ECT0 ) );
+      test.execute( ExpectEce { true } );
+      test.execute(
+        SegmentArrives {}.with_seqno( isn + 4 ).with_data( "d" ).with_cwr().with_ecn( IPv4Header::ECN_ECT0 ) );
+      test.execute( ExpectEce { false } );
+      test.execute( ExpectAckno { Wrap32 { isn + 5 } } );
+      test.execute( ReadAll { "abcd" } );
+    }
   } catch ( const exception& e ) {
     cerr << e.what() << "\n";
     return 1;
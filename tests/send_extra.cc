@@ -331,7 +331,7 @@ int main()
       cfg.rt_timeout = rto;
 
       TCPSenderTestHarness test {
-        "When filling window, treat a '0' window size as equal to '1' but don't back off RTO", cfg };
+        "A '0' window is probed one byte at a time on the persist timer's own backoff", cfg };
       test.execute( Push {} );
       test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
       test.execute( Push( "abc" ) );
@@ -347,19 +347,23 @@ int main()
       test.execute( ExpectNoSegment {} );
 
       for ( unsigned int i = 0; i < 5; i++ ) {
-        test.execute( Tick { rto - 1 } );
+        const uint64_t probe_interval = min( uint64_t { rto } << i, TCPConfig::MAX_PERSIST_TIMEOUT );
+        test.execute( Tick { probe_interval - 1 } );
         test.execute( ExpectNoSegment {} );
         test.execute( Tick { 1 } );
         test.execute(
           ExpectMessage {}.with_payload_size( 1 ).with_data( "a" ).with_seqno( isn + 1 ).with_no_flags() );
       }
+      test.execute( ExpectConsecutiveRetransmissions { 5 } );
 
       test.execute( AckReceived { isn + 2 }.with_win( 0 ) );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
       test.execute(
         ExpectMessage {}.with_payload_size( 1 ).with_data( "b" ).with_seqno( isn + 2 ).with_no_flags() );
 
       for ( unsigned int i = 0; i < 5; i++ ) {
-        test.execute( Tick { rto - 1 } );
+        const uint64_t probe_interval = min( uint64_t { rto } << i, TCPConfig::MAX_PERSIST_TIMEOUT );
+        test.execute( Tick { probe_interval - 1 } );
         test.execute( ExpectNoSegment {} );
         test.execute( Tick { 1 } );
         test.execute(
@@ -371,7 +375,8 @@ int main()
         ExpectMessage {}.with_payload_size( 1 ).with_data( "c" ).with_seqno( isn + 3 ).with_no_flags() );
 
       for ( unsigned int i = 0; i < 5; i++ ) {
-        test.execute( Tick { rto - 1 } );
+        const uint64_t probe_interval = min( uint64_t { rto } << i, TCPConfig::MAX_PERSIST_TIMEOUT );
+        test.execute( Tick { probe_interval - 1 } );
         test.execute( ExpectNoSegment {} );
         test.execute( Tick { 1 } );
         test.execute(
@@ -383,7 +388,8 @@ int main()
         ExpectMessage {}.with_payload_size( 0 ).with_data( "" ).with_seqno( isn + 4 ).with_fin( true ) );
 
       for ( unsigned int i = 0; i < 5; i++ ) {
-        test.execute( Tick { rto - 1 } );
+        const uint64_t probe_interval = min( uint64_t { rto } << i, TCPConfig::MAX_PERSIST_TIMEOUT );
+        test.execute( Tick { probe_interval - 1 } );
         test.execute( ExpectNoSegment {} );
         test.execute( Tick { 1 } );
         test.execute(
@@ -391,6 +397,120 @@ int main()
       }
     }
 
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
+      cfg.isn = isn;
+      cfg.rt_timeout = rto;
+
+      TCPSenderTestHarness test { "Unanswered zero-window probes count as retransmissions", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Push( "abc" ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 0 ) );
+      test.execute(
+        ExpectMessage {}.with_payload_size( 1 ).with_data( "a" ).with_seqno( isn + 1 ).with_no_flags() );
+      for ( unsigned int i = 0; i < TCPConfig::MAX_RETX_ATTEMPTS; i++ ) {
+        const uint64_t probe_interval = min( uint64_t { rto } << i, TCPConfig::MAX_PERSIST_TIMEOUT );
+        test.execute( Tick { probe_interval - 1 }.with_max_retx_exceeded( false ) );
+        test.execute( ExpectNoSegment {} );
+        test.execute( Tick { 1 }.with_max_retx_exceeded( false ) );
+        test.execute(
+          ExpectMessage {}.with_payload_size( 1 ).with_data( "a" ).with_seqno( isn + 1 ).with_no_flags() );
+        test.execute( ExpectConsecutiveRetransmissions { i + 1 } );
+      }
+      test.execute( Tick { TCPConfig::MAX_PERSIST_TIMEOUT }.with_max_retx_exceeded( true ) );
+      test.execute(
+        ExpectMessage {}.with_payload_size( 1 ).with_data( "a" ).with_seqno( isn + 1 ).with_no_flags() );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
+      cfg.isn = isn;
+      cfg.rt_timeout = rto;
+
+      TCPSenderTestHarness test { "A receiver that answers zero-window probes is probed indefinitely", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Push( "abc" ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 0 ) );
+      test.execute(
+        ExpectMessage {}.with_payload_size( 1 ).with_data( "a" ).with_seqno( isn + 1 ).with_no_flags() );
+      for ( unsigned int i = 0; i < 2 * TCPConfig::MAX_RETX_ATTEMPTS; i++ ) {
+        test.execute( Tick { TCPConfig::MAX_PERSIST_TIMEOUT }.with_max_retx_exceeded( false ) );
+        test.execute(
+          ExpectMessage {}.with_payload_size( 1 ).with_data( "a" ).with_seqno( isn + 1 ).with_no_flags() );
+        test.execute( ExpectConsecutiveRetransmissions { 1 } );
+        test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 0 ) );
+        test.execute( ExpectConsecutiveRetransmissions { 0 } );
+      }
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
+      cfg.isn = isn;
+      cfg.rt_timeout = rto;
+
+      TCPSenderTestHarness test { "A window that closes with data outstanding keeps the retransmission timer", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10 ) );
+      test.execute( Push( "abcdefgh" ) );
+      test.execute(
+        ExpectMessage {}.with_payload_size( 8 ).with_data( "abcdefgh" ).with_seqno( isn + 1 ).with_no_flags() );
+      test.execute( Tick { rto / 2 } );
+      test.execute( AckReceived { Wrap32 { isn + 5 } }.with_win( 0 ) );
+      test.execute( ExpectSeqnosInFlight { 4 } );
+      test.execute( Tick { rto - 1 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute(
+        ExpectMessage {}.with_payload_size( 8 ).with_data( "abcdefgh" ).with_seqno( isn + 1 ).with_no_flags() );
+      test.execute( ExpectConsecutiveRetransmissions { 1 } );
+      test.execute( Tick { 2 * rto - 1 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute(
+        ExpectMessage {}.with_payload_size( 8 ).with_data( "abcdefgh" ).with_seqno( isn + 1 ).with_no_flags() );
+      test.execute( ExpectConsecutiveRetransmissions { 2 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
+      cfg.isn = isn;
+      cfg.rt_timeout = rto;
+
+      TCPSenderTestHarness test { "A window update ends the persist state and resumes full-rate sending", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Push( "abcdef" ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 0 ) );
+      test.execute(
+        ExpectMessage {}.with_payload_size( 1 ).with_data( "a" ).with_seqno( isn + 1 ).with_no_flags() );
+      test.execute( Tick { rto } );
+      test.execute(
+        ExpectMessage {}.with_payload_size( 1 ).with_data( "a" ).with_seqno( isn + 1 ).with_no_flags() );
+      test.execute( Tick { rto } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10 ) );
+      test.execute(
+        ExpectMessage {}.with_payload_size( 5 ).with_data( "bcdef" ).with_seqno( isn + 2 ).with_no_flags() );
+      test.execute( ExpectSeqnosInFlight { 6 } );
+      test.execute( Tick { rto - 1 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute(
+        ExpectMessage {}.with_payload_size( 1 ).with_data( "a" ).with_seqno( isn + 1 ).with_no_flags() );
+      test.execute( ExpectConsecutiveRetransmissions { 1 } );
+    }
+
     {
       TCPConfig cfg;
       const Wrap32 isn( rd() );
@@ -778,6 +898,385 @@ int main()
       test.execute( ExpectMessage {}.with_payload_size( 2 ).with_data( "de" ).with_seqno( isn + 4 ) );
       test.execute( ExpectNoSegment {} );
     }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Nagle's algorithm holds small writes while data is unacknowledged", cfg };
+      test.execute( SetCoalescing { TCPCoalescing::Nagle } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( Push( "abc" ) );
+      test.execute( ExpectMessage {}.with_payload_size( 3 ).with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( Push( "def" ) );
+      test.execute( Push( "gh" ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 4 } }.with_win( 5000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 5 ).with_data( "defgh" ).with_seqno( isn + 4 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Push( string( 1500, 'x' ) ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 9 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Push( "y" ).with_close() );
+      test.execute( ExpectMessage {}.with_payload_size( 501 ).with_fin( true ).with_seqno( isn + 1009 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Autocork holds a small write only while an earlier small one is unacknowledged",
+                                  cfg };
+      test.execute( SetCoalescing { TCPCoalescing::Autocork } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( Push( string( 1000, 'x' ) ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( Push( "abc" ) );
+      test.execute( ExpectMessage {}.with_payload_size( 3 ).with_data( "abc" ).with_seqno( isn + 1001 ) );
+      test.execute( Push( "def" ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 1001 } }.with_win( 5000 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 1004 } }.with_win( 5000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 3 ).with_data( "def" ).with_seqno( isn + 1004 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Nodelay overrides Nagle's algorithm", cfg };
+      test.execute( SetCoalescing { TCPCoalescing::Nagle } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( Push( "abc" ) );
+      test.execute( ExpectMessage {}.with_payload_size( 3 ).with_data( "abc" ) );
+      test.execute( Push( "def" ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( SetNodelay { true } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_payload_size( 3 ).with_data( "def" ) );
+      test.execute( Push( "ghi" ) );
+      test.execute( ExpectMessage {}.with_payload_size( 3 ).with_data( "ghi" ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "A corked sender holds partial segments until uncorked or the cork times out",
+                                  cfg };
+      test.execute( SetNodelay { true } );
+      test.execute( SetCork { true } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( Push( "abc" ) );
+      test.execute( Push( "def" ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( SetCork { false } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_payload_size( 6 ).with_data( "abcdef" ).with_seqno( isn + 1 ) );
+      test.execute( SetCork { true } );
+      test.execute( Push( "xyz" ) );
+      test.execute( Tick { TCPConfig::CORK_TIMEOUT - 1 } );
+      test.execute( Push {} );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_payload_size( 3 ).with_data( "xyz" ).with_seqno( isn + 7 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
+      cfg.isn = isn;
+      cfg.rt_timeout = rto;
+
+      TCPSenderTestHarness test { "Offloaded super-segments are retransmitted one MSS at a time", cfg };
+      test.execute( SetOffloadSize { 4000 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( Push( string( 4500, 'x' ) ) );
+      test.execute( ExpectMessage {}.with_payload_size( 4000 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 500 ).with_seqno( isn + 4001 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { rto } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( AckReceived { Wrap32 { isn + 1001 } }.with_win( 5000 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { rto } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1001 ) );
+      test.execute( AckReceived { Wrap32 { isn + 4001 } }.with_win( 5000 ) );
+      test.execute( Push( string( 2000, 'y' ) ).with_close() );
+      test.execute( ExpectMessage {}.with_payload_size( 2000 ).with_seqno( isn + 4501 ).with_fin( true ) );
+      test.execute( ExpectSeqnosInFlight { 2501 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
+      cfg.isn = isn;
+      cfg.rt_timeout = rto;
+
+      TCPSenderTestHarness test { "Repacketization merges small outstanding segments and the FIN, up to the MSS",
+                                  cfg };
+      test.execute( SetRepacketize { true } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { rto } );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( Push( "ab" ) );
+      test.execute( Push( "cd" ) );
+      test.execute( Push( "ef" ).with_close() );
+      test.execute( ExpectMessage {}.with_data( "ab" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_data( "cd" ).with_seqno( isn + 3 ) );
+      test.execute( ExpectMessage {}.with_data( "ef" ).with_fin( true ).with_seqno( isn + 5 ) );
+      test.execute( AckReceived { Wrap32 { isn + 2 } }.with_win( 5000 ) );
+      test.execute( Tick { rto } );
+      test.execute( ExpectMessage {}.with_data( "bcdef" ).with_fin( true ).with_seqno( isn + 2 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 8 } }.with_win( 5000 ) );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
+      cfg.isn = isn;
+      cfg.rt_timeout = rto;
+
+      TCPSenderTestHarness test { "Repacketization never builds a segment longer than the MSS", cfg };
+      test.execute( SetRepacketize { true } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( Push( string( 600, 'x' ) ) );
+      test.execute( Push( string( 600, 'y' ) ) );
+      test.execute( ExpectMessage {}.with_payload_size( 600 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 600 ).with_seqno( isn + 601 ) );
+      test.execute( Tick { rto } );
+      test.execute( ExpectMessage {}.with_data( string( 600, 'x' ) ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "SWS avoidance holds a small window-limited segment until the override timer",
+                                  cfg };
+      test.execute( SetSwsAvoidance { true } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1500 ) );
+      test.execute( Push( string( 3000, 'x' ) ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { TCPConfig::SWS_OVERRIDE_TIMEOUT - 1 } );
+      test.execute( Push {} );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_payload_size( 500 ).with_seqno( isn + 1001 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "SWS avoidance sends once the window opens, and never holds the stream tail", cfg };
+      test.execute( SetSwsAvoidance { true } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1500 ) );
+      test.execute( Push( string( 3000, 'x' ) ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 1001 } }.with_win( 3000 ) );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1001 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 2001 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Push( "abc" ) );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 3001 ) );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "SWS avoidance probes a zero window only when the persist timer expires", cfg };
+      test.execute( SetSwsAvoidance { true } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 0 ) );
+      test.execute( Push( "abc" ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 999 } );
+      test.execute( Push {} );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_data( "a" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 2 } }.with_win( 1000 ) );
+      test.execute( ExpectMessage {}.with_data( "bc" ).with_seqno( isn + 2 ) );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "Without SWS avoidance a small window is filled at once", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1500 ) );
+      test.execute( Push( string( 3000, 'x' ) ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 500 ).with_seqno( isn + 1001 ) );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "Fast Open without a cookie asks for one, and sends data after the handshake", cfg };
+      test.execute( SetFastOpen { "" } );
+      test.execute( Push( "GET /" ) );
+      test.execute( ExpectMessage {}.with_syn( true ).with_payload_size( 0 ).with_fast_open( "" ).with_seqno( isn ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 1 } } );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "GET /" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "Fast Open with a cookie sends up to one MSS with the SYN", cfg };
+      test.execute( SetFastOpen { "cookie" } );
+      test.execute( Push( string( 1500, 'x' ) ).with_close() );
+      test.execute(
+        ExpectMessage {}.with_syn( true ).with_payload_size( 1000 ).with_fast_open( "cookie" ).with_seqno( isn ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 1001 } );
+      test.execute( AckReceived { Wrap32 { isn + 1001 } }.with_win( 1000 ) );
+      test.execute(
+        ExpectMessage {}.with_syn( false ).with_payload_size( 500 ).with_fin( true ).with_seqno( isn + 1001 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "Fast Open data that the server did not accept is resent at once", cfg };
+      test.execute( SetFastOpen { "stale" } );
+      test.execute( Push( "GET /" ) );
+      test.execute(
+        ExpectMessage {}.with_syn( true ).with_data( "GET /" ).with_fast_open( "stale" ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } } );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "GET /" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 5 } );
+      test.execute( Tick { 999 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "GET /" ).with_seqno( isn + 1 ) );
+      test.execute( AckReceived { Wrap32 { isn + 6 } } );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "ECN halves the congestion window once per window of data", cfg };
+      test.execute( SetEcn { true } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_cwr( true ).with_ecn( IPv4Header::ECN_NOT_ECT ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10000 ).with_ece() );
+      test.execute( ExpectCongestionWindow { UINT64_MAX } );
+      test.execute( Push( string( 4000, 'x' ) ) );
+      for ( uint32_t i = 0; i < 4; i++ ) {
+        test.execute( ExpectMessage {}
+                        .with_payload_size( 1000 )
+                        .with_seqno( isn + 1 + 1000 * i )
+                        .with_cwr( false )
+                        .with_ecn( IPv4Header::ECN_ECT0 ) );
+      }
+      test.execute( AckReceived { Wrap32 { isn + 1001 } }.with_win( 10000 ).with_ece() );
+      test.execute( ExpectCongestionWindow { 2000 } );
+      test.execute( Push( string( 1000, 'y' ) ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 4001 } }.with_win( 10000 ).with_ece() );
+      test.execute( ExpectCongestionWindow { 3000 } );
+      test.execute( ExpectMessage {}
+                      .with_data( string( 1000, 'y' ) )
+                      .with_seqno( isn + 4001 )
+                      .with_cwr( true )
+                      .with_ecn( IPv4Header::ECN_ECT0 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1000 } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 4001 ).with_cwr( false ).with_ecn( IPv4Header::ECN_NOT_ECT ) );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "Without ECN, nothing is marked and ECE is ignored", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_cwr( false ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10000 ) );
+      test.execute( Push( string( 2000, 'x' ) ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_ecn( IPv4Header::ECN_NOT_ECT ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_ecn( IPv4Header::ECN_NOT_ECT ) );
+      test.execute( AckReceived { Wrap32 { isn + 1001 } }.with_win( 10000 ).with_ece() );
+      test.execute( ExpectCongestionWindow { UINT64_MAX } );
+      test.execute( Push( string( 1000, 'y' ) ) );
+      test.execute( ExpectMessage {}.with_data( string( 1000, 'y' ) ).with_cwr( false ) );
+    }
   } catch ( const exception& e ) {
     cerr << e.what() << "\n";
     return 1;
@@ -7,6 +7,7 @@
 #include "tcp_sender.hh"
 #include "wrapping_integers.hh"
 
+#include <algorithm>
 #include <optional>
 #include <queue>
 #include <sstream>
@@ -18,6 +19,7 @@ struct SenderAndOutput
 {
   TCPSender sender;
   std::queue<TCPSenderMessage> output {};
+  uint64_t max_payload_size = TCPConfig::MAX_PAYLOAD_SIZE; // larger with segmentation offload
 
   auto make_transmit()
   {
@@ -104,6 +106,13 @@ struct ExpectConsecutiveRetransmissions : public ExpectNumber<TCPSender, uint64_
   uint64_t value( const TCPSender& sender ) const override { return sender.consecutive_retransmissions(); }
 };
 
+struct ExpectCongestionWindow : public ExpectNumber<TCPSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "congestion_window"; }
+  uint64_t value( const TCPSender& sender ) const override { return sender.congestion_window(); }
+};
+
 struct ExpectNoSegment : public Expectation<SenderAndOutput>
 {
   std::string description() const override { return "nothing to send"; }
@@ -122,6 +131,97 @@ struct SetError : public Action<TCPSender>
   void execute( TCPSender& sender ) const override { sender.writer().set_error(); }
 };
 
+struct SetCoalescing : public Action<TCPSender>
+{
+  TCPCoalescing mode_;
+
+  explicit SetCoalescing( TCPCoalescing mode ) : mode_( mode ) {}
+  std::string description() const override
+  {
+    switch ( mode_ ) {
+      case TCPCoalescing::Nagle:
+        return "set_coalescing(Nagle)";
+      case TCPCoalescing::Autocork:
+        return "set_coalescing(Autocork)";
+      case TCPCoalescing::NoDelay:
+        break;
+    }
+    return "set_coalescing(NoDelay)";
+  }
+  void execute( TCPSender& sender ) const override { sender.set_coalescing( mode_ ); }
+};
+
+struct SetNodelay : public Action<TCPSender>
+{
+  bool nodelay_;
+
+  explicit SetNodelay( bool nodelay ) : nodelay_( nodelay ) {}
+  std::string description() const override { return "set_nodelay(" + std::to_string( nodelay_ ) + ")"; }
+  void execute( TCPSender& sender ) const override { sender.set_nodelay( nodelay_ ); }
+};
+
+struct SetCork : public Action<TCPSender>
+{
+  bool cork_;
+
+  explicit SetCork( bool cork ) : cork_( cork ) {}
+  std::string description() const override { return "set_cork(" + std::to_string( cork_ ) + ")"; }
+  void execute( TCPSender& sender ) const override { sender.set_cork( cork_ ); }
+};
+
+struct SetOffloadSize : public Action<SenderAndOutput>
+{
+  uint64_t size_;
+
+  explicit SetOffloadSize( uint64_t size ) : size_( size ) {}
+  std::string description() const override { return "set_offload_size(" + std::to_string( size_ ) + ")"; }
+  void execute( SenderAndOutput& ss ) const override
+  {
+    ss.sender.set_offload_size( size_ );
+    ss.max_payload_size = std::max<uint64_t>( size_, TCPConfig::MAX_PAYLOAD_SIZE );
+  }
+  constexpr std::string obj() const override { return "TCPSender"; }
+};
+
+struct SetRepacketize : public Action<TCPSender>
+{
+  bool repacketize_;
+
+  explicit SetRepacketize( bool repacketize ) : repacketize_( repacketize ) {}
+  std::string description() const override { return "set_repacketize(" + std::to_string( repacketize_ ) + ")"; }
+  void execute( TCPSender& sender ) const override { sender.set_repacketize( repacketize_ ); }
+};
+
+struct SetSwsAvoidance : public Action<TCPSender>
+{
+  bool sws_avoidance_;
+
+  explicit SetSwsAvoidance( bool sws_avoidance ) : sws_avoidance_( sws_avoidance ) {}
+  std::string description() const override
+  {
+    return "set_sws_avoidance(" + std::to_string( sws_avoidance_ ) + ")";
+  }
+  void execute( TCPSender& sender ) const override { sender.set_sws_avoidance( sws_avoidance_ ); }
+};
+
+struct SetFastOpen : public Action<TCPSender>
+{
+  std::string cookie_;
+
+  explicit SetFastOpen( std::string cookie ) : cookie_( std::move( cookie ) ) {}
+  std::string description() const override { return "set_fast_open(\"" + pretty_print( cookie_ ) + "\")"; }
+  void execute( TCPSender& sender ) const override { sender.set_fast_open( cookie_ ); }
+};
+
+struct SetEcn : public Action<TCPSender>
+{
+  bool ecn_;
+
+  explicit SetEcn( bool ecn ) : ecn_( ecn ) {}
+  std::string description() const override { return "set_ecn(" + std::to_string( ecn_ ) + ")"; }
+  void execute( TCPSender& sender ) const override { sender.set_ecn( ecn_ ); }
+};
+
 struct HasError : public ExpectBool<TCPSender>
 {
   using ExpectBool::ExpectBool;
@@ -222,7 +322,8 @@ struct Receive : public Action<SenderAndOutput>
   std::string description() const override
   {
     std::ostringstream desc;
-    desc << "receive(ack=" << to_string( msg_.ackno ) << ", win=" << msg_.window_size << ")";
+    desc << "receive(ack=" << to_string( msg_.ackno ) << ", win=" << msg_.window_size << ( msg_.ECE ? ", ECE" : "" )
+         << ")";
     if ( push_ ) {
       desc << ", then push";
     }
@@ -235,6 +336,12 @@ struct Receive : public Action<SenderAndOutput>
     return *this;
   }
 
+  Receive& with_ece()
+  {
+    msg_.ECE = true;
+    return *this;
+  }
+
   void execute( SenderAndOutput& ss ) const override
   {
     ss.sender.receive( msg_ );
@@ -283,8 +390,11 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
   std::optional<Wrap32> seqno {};
   std::optional<std::string> data {};
   std::optional<size_t> payload_size {};
+  std::optional<std::string> fast_open {};
+  std::optional<bool> cwr {};
+  std::optional<uint8_t> ecn {};
 
-  bool empty() const { return not( syn or fin or rst or seqno or data or payload_size ); }
+  bool empty() const { return not( syn or fin or rst or seqno or data or payload_size or fast_open or cwr or ecn ); }
 
   ExpectMessage& with_syn( bool syn_ )
   {
@@ -330,6 +440,24 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
     return *this;
   }
 
+  ExpectMessage& with_fast_open( std::string cookie_ )
+  {
+    fast_open = std::move( cookie_ );
+    return *this;
+  }
+
+  ExpectMessage& with_cwr( bool cwr_ )
+  {
+    cwr = cwr_;
+    return *this;
+  }
+
+  ExpectMessage& with_ecn( uint8_t ecn_ )
+  {
+    ecn = ecn_;
+    return *this;
+  }
+
   std::string message_description() const
   {
     std::ostringstream o;
@@ -361,6 +489,15 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
     if ( rst.has_value() ) {
       o << ( rst.value() ? " +RST" : " -RST" );
     }
+    if ( fast_open.has_value() ) {
+      o << " TFO<" << pretty_print( fast_open.value() ) << ">";
+    }
+    if ( cwr.has_value() ) {
+      o << ( cwr.value() ? " +CWR" : " -CWR" );
+    }
+    if ( ecn.has_value() ) {
+      o << " ecn=" << +ecn.value();
+    }
     return o.str();
   }
 
@@ -377,10 +514,10 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
 
     const TCPSenderMessage seg = ss.expect_message();
 
-    if ( seg.payload.size() > TCPConfig::MAX_PAYLOAD_SIZE ) {
+    if ( seg.payload.size() > ss.max_payload_size ) {
       throw ExpectationViolation( "sent a message with a " + std::to_string( seg.payload.size() )
                                   + "-byte payload, which is longer than the maximum ("
-                                  + std::to_string( TCPConfig::MAX_PAYLOAD_SIZE ) + ")" );
+                                  + std::to_string( ss.max_payload_size ) + ")" );
     }
     if ( syn.has_value() and seg.SYN != syn.value() ) {
       throw MessageExpectationViolation( seg, "SYN flag", syn.value(), seg.SYN );
@@ -400,6 +537,16 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
     if ( data.has_value() and data.value() != static_cast<std::string>( seg.payload ) ) {
       throw MessageExpectationViolation( seg, "payload", data.value(), static_cast<std::string>( seg.payload ) );
     }
+    if ( fast_open.has_value() and seg.fast_open != fast_open ) {
+      throw MessageExpectationViolation(
+        seg, "Fast Open cookie", fast_open.value(), seg.fast_open.value_or( "(none)" ) );
+    }
+    if ( cwr.has_value() and seg.CWR != cwr.value() ) {
+      throw MessageExpectationViolation( seg, "CWR flag", cwr.value(), seg.CWR );
+    }
+    if ( ecn.has_value() and seg.ecn != ecn.value() ) {
+      throw MessageExpectationViolation( seg, "ECN field", +ecn.value(), +seg.ecn );
+    }
   }
 
   constexpr std::string obj() const override { return "TCPSender"; }
@@ -0,0 +1,176 @@
+#include "eventloop.hh"
+#include "loopback_device.hh"
+#include "random.hh"
+#include "tcp_minnow_socket_impl.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+using namespace std;
+
+namespace {
+using MinnowSocket = TCPMinnowSocket<LoopbackAdapter>;
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "socket_read_write: " + what );
+  }
+}
+
+TCPConfig config()
+{
+  TCPConfig cfg;
+  cfg.rt_timeout = 10;
+  auto rd = get_random_engine();
+  cfg.isn = Wrap32 { uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd ) };
+  return cfg;
+}
+
+// Connect `client` to `server` (which accepts on a thread of its own meanwhile)
+void connect_pair( MinnowSocket& client, MinnowSocket& server )
+{
+  FdAdapterConfig client_ad;
+  client_ad.source = { "169.254.144.9", "9000" };
+  client_ad.destination = { "169.254.144.1", "9001" };
+  FdAdapterConfig server_ad;
+  server_ad.source = { "169.254.144.1", "9001" };
+
+  thread accept( [&] { server.listen_and_accept( config(), server_ad ); } );
+  client.connect( config(), client_ad );
+  accept.join();
+}
+
+// Write all of `data` (which must be accepted in full)
+void write_all( MinnowSocket& socket, string_view data )
+{
+  expect( socket.write( data ) == data.size(), "write should take all of the data on an open stream" );
+}
+
+// Read `len` bytes, in reads of at most `read_size` (0: let read() choose)
+string read_exactly( MinnowSocket& socket, size_t len, size_t read_size )
+{
+  string received;
+  string buffer;
+  while ( received.size() < len ) {
+    buffer.resize( read_size );
+    socket.read( buffer );
+    expect( not buffer.empty(), "read should not see the end of the stream before all the data" );
+    expect( buffer.size() <= ( read_size == 0 ? 16384 : read_size ), "read should fit the buffer it is given" );
+    received += buffer;
+  }
+  return received;
+}
+
+// Wait for both ends to close
+void close_both( MinnowSocket& a, MinnowSocket& b )
+{
+  thread closer( [&] { b.wait_until_closed(); } );
+  a.wait_until_closed();
+  closer.join();
+}
+
+string payload( size_t len )
+{
+  string data( len, 0 );
+  auto rd = get_random_engine();
+  for ( auto& ch : data ) {
+    ch = static_cast<char>( rd() );
+  }
+  return data;
+}
+} // namespace
+
+int main()
+{
+  try {
+    {
+      // Both ways, with a stream larger than the ring and the window (so that write() waits for room), then a
+      // half-close each way
+      auto [client_udp, server_udp] = loopback_pair();
+      MinnowSocket client { LoopbackAdapter { std::move( client_udp ) } };
+      MinnowSocket server { LoopbackAdapter { std::move( server_udp ) } };
+      connect_pair( client, server );
+
+      write_all( client, "hello" );
+      expect( read_exactly( server, 5, 0 ) == "hello", "server should read what the client wrote" );
+
+      const string data = payload( 1 << 20 );
+      thread writer( [&] { write_all( server, data ); } );
+      const string received = read_exactly( client, data.size(), 1000 );
+      writer.join();
+      expect( received == data, "client should read the server's stream intact" );
+
+      client.shutdown( SHUT_WR );
+      expect( client.write( "more" ) == 0, "write after SHUT_WR should write nothing" );
+      string buffer;
+      server.read( buffer );
+      expect( buffer.empty() and server.eof(), "server should see the end of the client's stream" );
+
+      write_all( server, "still here" );
+      expect( read_exactly( client, 10, 0 ) == "still here", "server should still write after the client's FIN" );
+      expect( not client.eof(), "client's inbound stream has not ended" );
+      server.shutdown( SHUT_WR );
+      client.read( buffer );
+      expect( buffer.empty() and client.eof(), "client should see the end of the server's stream" );
+
+      close_both( client, server );
+    }
+
+    {
+      // After SHUT_RD, read() returns at once, and whatever still arrives is taken and thrown away
+      auto [client_udp, server_udp] = loopback_pair();
+      MinnowSocket client { LoopbackAdapter { std::move( client_udp ) } };
+      MinnowSocket server { LoopbackAdapter { std::move( server_udp ) } };
+      connect_pair( client, server );
+
+      client.shutdown( SHUT_RD );
+      string buffer;
+      client.read( buffer );
+      expect( buffer.empty() and client.eof(), "read after SHUT_RD should return the end of the stream" );
+
+      write_all( server, payload( 1 << 20 ) ); // (more than the ring and window: the client must discard it)
+      write_all( client, "bye" );
+      expect( read_exactly( server, 3, 0 ) == "bye", "client should still write after SHUT_RD" );
+      server.shutdown( SHUT_WR );
+
+      close_both( client, server );
+    }
+
+    {
+      // In inline mode, the owner uses the streams instead of read() and write()
+      EventLoop eventloop;
+      auto [udp, unused] = loopback_pair();
+      MinnowSocket inline_socket { LoopbackAdapter { std::move( udp ) }, eventloop };
+      string buffer;
+      bool threw = false;
+      try {
+        inline_socket.read( buffer );
+      } catch ( const runtime_error& ) {
+        threw = true;
+      }
+      expect( threw, "read() in inline mode should throw" );
+      threw = false;
+      try {
+        inline_socket.write( "x" );
+      } catch ( const runtime_error& ) {
+        threw = true;
+      }
+      expect( threw, "write() in inline mode should throw" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,202 @@
+#include "loopback_device.hh"
+#include "tcp_minnow_stack_impl.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+using Stack = TCPMinnowStack<LoopbackDevice>;
+
+const Address server_address { "169.254.144.1", 9001 };
+const Address client_address { "169.254.144.9", 0 };
+
+TCPConfig config()
+{
+  TCPConfig cfg;
+  cfg.rt_timeout = 20;
+  return cfg;
+}
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "stack_connect: " + what );
+  }
+}
+
+TCPFourTuple reverse( const TCPFourTuple& tuple )
+{
+  return { .local_ip = tuple.remote_ip,
+           .remote_ip = tuple.local_ip,
+           .local_port = tuple.remote_port,
+           .remote_port = tuple.local_port };
+}
+
+// Write all of `data`, then read until `expected` bytes have arrived
+string exchange( Stack::Socket& socket, string_view data, size_t expected )
+{
+  for ( string_view rest = data; not rest.empty(); ) {
+    rest.remove_prefix( socket.write( rest ) );
+  }
+  string received;
+  string buffer;
+  while ( received.size() < expected ) {
+    buffer.resize( expected - received.size() );
+    socket.read( buffer );
+    if ( buffer.empty() ) {
+      break;
+    }
+    received += buffer;
+  }
+  return received;
+}
+
+// Wait (for at most a few seconds) until `stack` has forgotten all of its connections
+bool drains( const Stack& stack )
+{
+  const auto deadline = chrono::steady_clock::now() + chrono::seconds( 5 );
+  while ( stack.connection_count() > 0 ) {
+    if ( chrono::steady_clock::now() > deadline ) {
+      return false;
+    }
+    this_thread::sleep_for( chrono::milliseconds( 10 ) );
+  }
+  return true;
+}
+} // namespace
+
+int main()
+{
+  try {
+    {
+      // connect() and accept() give the two ends of one connection
+      auto [client_udp, server_udp] = loopback_pair();
+      Stack client { LoopbackDevice { std::move( client_udp ) } };
+      Stack server { LoopbackDevice { std::move( server_udp ) } };
+      auto listener = server.listen( config(), server_address );
+      expect( not listener.try_accept().has_value(), "nothing to accept before a connection" );
+
+      auto active = client.connect( config(), client_address, server_address );
+      auto passive = listener.accept();
+      expect( active.active() and passive.active(), "both ends should be active once connected" );
+      expect( active.tuple().remote_ip == server_address.ipv4_numeric()
+                and active.tuple().remote_port == server_address.port(),
+              "client should be connected to the server's address" );
+      expect( active.tuple().local_ip == client_address.ipv4_numeric() and active.tuple().local_port >= 49152,
+              "client should be given an ephemeral port" );
+      expect( passive.tuple() == reverse( active.tuple() ), "accepted tuple should be the client's, reversed" );
+      expect( client.connection_count() == 1 and server.connection_count() == 1, "one connection on each stack" );
+
+      expect( exchange( active, "hello", 0 ).empty(), "write" );
+      expect( exchange( passive, "world", 5 ) == "hello", "server should read what the client wrote" );
+      expect( exchange( active, "", 5 ) == "world", "client should read what the server wrote" );
+
+      expect( exchange( passive, "again", 0 ).empty(), "write" );
+      string buffer;
+      active.read( buffer );
+      expect( buffer == "again", "read into an empty buffer should read what is there, not nothing" );
+    }
+
+    {
+      // Several connections at once (to one listener, and between the same two addresses): each segment is
+      // demultiplexed to its own connection by the four-tuple
+      constexpr size_t connections = 8;
+      auto [client_udp, server_udp] = loopback_pair();
+      Stack client { LoopbackDevice { std::move( client_udp ) } };
+      Stack server { LoopbackDevice { std::move( server_udp ) } };
+      auto listener = server.listen( config(), server_address );
+
+      vector<Stack::Socket> actives;
+      vector<Stack::Socket> passives;
+      for ( size_t i = 0; i < connections; i++ ) {
+        actives.push_back( client.connect( config(), client_address, server_address ) );
+        passives.push_back( listener.accept() );
+      }
+      expect( client.connection_count() == connections and server.connection_count() == connections,
+              "every connection should be running" );
+
+      // Write everything first (in reverse order), so that the connections' segments are interleaved
+      for ( size_t i = connections; i-- > 0; ) {
+        const string request = "request " + to_string( i ) + " from port " + to_string( actives[i].tuple().local_port );
+        expect( actives[i].write( request ) == request.size(), "request should fit in the send buffer" );
+      }
+      for ( size_t i = 0; i < connections; i++ ) {
+        expect( passives[i].tuple() == reverse( actives[i].tuple() ), "accept order should match connect order" );
+        const string request = "request " + to_string( i ) + " from port " + to_string( actives[i].tuple().local_port );
+        const string response = "response " + to_string( i );
+        expect( exchange( passives[i], response, request.size() ) == request, "request " + to_string( i ) );
+      }
+      for ( size_t i = 0; i < connections; i++ ) {
+        const string response = "response " + to_string( i );
+        expect( exchange( actives[i], "", response.size() ) == response, "response " + to_string( i ) );
+      }
+    }
+
+    {
+      // A connection that has finished (in both directions, and lingered) is removed from both stacks
+      auto [client_udp, server_udp] = loopback_pair();
+      Stack client { LoopbackDevice { std::move( client_udp ) } };
+      Stack server { LoopbackDevice { std::move( server_udp ) } };
+      auto listener = server.listen( config(), server_address );
+
+      {
+        auto active = client.connect( config(), client_address, server_address );
+        auto passive = listener.accept();
+        expect( exchange( active, "bye", 0 ).empty(), "write" );
+        active.shutdown_write();
+        expect( exchange( passive, "", 3 ) == "bye", "server should read what the client wrote" );
+        string buffer( 1, '\0' );
+        passive.read( buffer );
+        expect( buffer.empty() and passive.eof(), "server should see the end of the client's stream" );
+        passive.shutdown_write();
+        buffer.resize( 1 );
+        active.read( buffer );
+        expect( buffer.empty() and active.eof(), "client should see the end of the server's stream" );
+
+        passive.wait_until_closed();
+        active.wait_until_closed();
+        expect( not active.active() and not passive.active(), "both ends should be closed" );
+      }
+      expect( drains( client ), "client stack should forget the finished connection" );
+      expect( drains( server ), "server stack should forget the finished connection" );
+
+      // and the listener still takes new connections afterwards
+      auto active = client.connect( config(), client_address, server_address );
+      auto passive = listener.accept();
+      expect( passive.tuple() == reverse( active.tuple() ), "a new connection after the first is removed" );
+      expect( client.connection_count() == 1 and server.connection_count() == 1, "one connection on each stack" );
+    }
+
+    {
+      // A socket let go of before its connection finishes is closed, and removed, by the stack on its own
+      auto [client_udp, server_udp] = loopback_pair();
+      Stack client { LoopbackDevice { std::move( client_udp ) } };
+      Stack server { LoopbackDevice { std::move( server_udp ) } };
+      auto listener = server.listen( config(), server_address );
+      {
+        auto active = client.connect( config(), client_address, server_address );
+        auto passive = listener.accept();
+        expect( exchange( passive, "unread", 0 ).empty(), "write" );
+      }
+      expect( drains( client ), "client stack should forget a released connection" );
+      expect( drains( server ), "server stack should forget a released connection" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+#include "flow_steering.hh"
+#include "random.hh"
+#include "tcp_over_ip.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+namespace {
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "stack_four_tuple: " + what );
+  }
+}
+
+TCPFourTuple reverse( const TCPFourTuple& tuple )
+{
+  return { .local_ip = tuple.remote_ip,
+           .remote_ip = tuple.local_ip,
+           .local_port = tuple.remote_port,
+           .remote_port = tuple.local_port };
+}
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+    uniform_int_distribution<uint32_t> ip_dist;
+    uniform_int_distribution<uint16_t> port_dist;
+
+    {
+      // Equal tuples hash equally, and each field changes the hash
+      const TCPFourTuple tuple {
+        .local_ip = ip_dist( rd ), .remote_ip = ip_dist( rd ), .local_port = 49152, .remote_port = 80 };
+      const TCPFourTuple copy = tuple;
+      expect( copy == tuple and copy.hash() == tuple.hash(), "equal tuples should hash equally" );
+      expect( TCPFourTupleHash {}( tuple ) == tuple.hash(), "TCPFourTupleHash should be TCPFourTuple::hash" );
+
+      TCPFourTuple other = tuple;
+      other.local_ip ^= 1;
+      expect( other != tuple and other.hash() != tuple.hash(), "local_ip should change the hash" );
+      other = tuple;
+      other.remote_ip ^= 1;
+      expect( other != tuple and other.hash() != tuple.hash(), "remote_ip should change the hash" );
+      other = tuple;
+      other.local_port ^= 1;
+      expect( other != tuple and other.hash() != tuple.hash(), "local_port should change the hash" );
+      other = tuple;
+      other.remote_port ^= 1;
+      expect( other != tuple and other.hash() != tuple.hash(), "remote_port should change the hash" );
+      expect( reverse( tuple ) != tuple and reverse( tuple ).hash() != tuple.hash(),
+              "the two ends of a connection are different keys" );
+    }
+
+    {
+      // Connections from one client address to one server port (differing only in the ephemeral port) are
+      // spread evenly: no two of them collide, and every bucket of the low bits is used about equally
+      constexpr size_t connections = 16384;
+      constexpr size_t buckets = 64;
+      const uint32_t client_ip = ip_dist( rd );
+      const uint32_t server_ip = ip_dist( rd );
+      unordered_set<uint64_t> hashes;
+      vector<size_t> per_bucket( buckets );
+      for ( size_t i = 0; i < connections; i++ ) {
+        const TCPFourTuple tuple { .local_ip = client_ip,
+                                   .remote_ip = server_ip,
+                                   .local_port = static_cast<uint16_t>( 49152 + i ),
+                                   .remote_port = 443 };
+        hashes.insert( tuple.hash() );
+        per_bucket[tuple.hash() % buckets]++;
+      }
+      expect( hashes.size() == connections, "tuples differing in one port should not collide" );
+      for ( const size_t count : per_bucket ) {
+        // (the expectation is 256 per bucket, and the standard deviation about 16)
+        expect( count > 160 and count < 352, "bucket of " + to_string( count ) + " tuples is too uneven" );
+      }
+    }
+
+    {
+      // A connection is assigned to the same shard from either end, and the shards share out connections
+      constexpr size_t shards = 4;
+      constexpr size_t connections = 4000;
+      const FlowSteering steering { shards };
+      vector<size_t> per_shard( shards );
+      for ( size_t i = 0; i < connections; i++ ) {
+        const TCPFourTuple tuple { .local_ip = ip_dist( rd ),
+                                   .remote_ip = ip_dist( rd ),
+                                   .local_port = port_dist( rd ),
+                                   .remote_port = port_dist( rd ) };
+        const size_t shard = steering.shard_of( tuple );
+        expect( shard < shards, "shard out of range" );
+        expect( steering.shard_of( reverse( tuple ) ) == shard, "shard_of should be symmetric" );
+        per_shard[shard]++;
+      }
+      for ( const size_t count : per_shard ) {
+        expect( count > 800 and count < 1200, "shard of " + to_string( count ) + " connections is too uneven" );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
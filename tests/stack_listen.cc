@@ -0,0 +1,210 @@
+#include "loopback_device.hh"
+#include "tcp_minnow_stack_impl.hh"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+using Stack = TCPMinnowStack<LoopbackDevice>;
+
+const Address server_address { "169.254.144.1", 9001 };
+const Address client_address { "169.254.144.9", 0 };
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "stack_listen: " + what );
+  }
+}
+
+// Wait (for at most a few seconds) until `condition` holds
+void eventually( const function<bool()>& condition, const string& what )
+{
+  const auto deadline = chrono::steady_clock::now() + chrono::seconds( 5 );
+  while ( not condition() ) {
+    expect( chrono::steady_clock::now() < deadline, "timed out waiting until " + what );
+    this_thread::sleep_for( chrono::milliseconds( 5 ) );
+  }
+}
+
+// The far end of a server stack's link, without a stack: writes segments of its own making, and reads the
+// server's answers
+class RawClient
+{
+  FileDescriptor link_;
+  string headers_ {};
+
+public:
+  explicit RawClient( FileDescriptor&& link ) : link_( std::move( link ) ) {}
+
+  //! The connection from `port` on the client's address to the server
+  static TCPFourTuple tuple( uint16_t port )
+  {
+    return { .local_ip = client_address.ipv4_numeric(),
+             .remote_ip = server_address.ipv4_numeric(),
+             .local_port = port,
+             .remote_port = server_address.port() };
+  }
+
+  void send( uint16_t port, const TCPMessage& msg )
+  {
+    TCPOverIPv4Adapter::segment_tcp_in_ip(
+      tuple( port ), TCPConfig::MAX_PAYLOAD_SIZE, msg, headers_, [&]( string_view headers, string_view payload ) {
+        if ( payload.empty() ) {
+          link_.write( headers );
+        } else {
+          link_.write( array<string_view, 2> { headers, payload } );
+        }
+      } );
+  }
+
+  void send_syn( uint16_t port, Wrap32 isn )
+  {
+    send( port,
+          { TCPSenderMessage { .seqno = isn, .SYN = true }, TCPReceiverMessage { .window_size = UINT16_MAX } } );
+  }
+
+  //! The next segment from the server to `port` (skipping any to other ports)
+  TCPMessage receive( uint16_t port )
+  {
+    while ( true ) {
+      string datagram;
+      link_.read( datagram );
+      InternetDatagram ip_dgram;
+      if ( not parse( ip_dgram, vector<string> { std::move( datagram ) } ) ) {
+        continue;
+      }
+      TCPFourTuple from {};
+      auto msg = TCPOverIPv4Adapter::unwrap_tcp_in_ip( std::move( ip_dgram ), from );
+      if ( msg.has_value() and from == tuple( port ) ) {
+        return std::move( msg.value() );
+      }
+    }
+  }
+};
+} // namespace
+
+int main()
+{
+  try {
+    TCPConfig cfg;
+    cfg.rt_timeout = 20;
+
+    {
+      // Without SYN cookies, SYNs beyond the backlog of half-open connections are dropped
+      auto [client_udp, server_udp] = loopback_pair();
+      RawClient client { std::move( client_udp ) };
+      Stack server { LoopbackDevice { std::move( server_udp ) } };
+      auto listener = server.listen( cfg, server_address, 2, false );
+      for ( uint16_t port = 50000; port < 50005; port++ ) {
+        client.send_syn( port, Wrap32 { port * 1000U } );
+      }
+      eventually( [&] { return listener.stats().syns_dropped == 3; }, "three SYNs are dropped" );
+      const auto stats = listener.stats();
+      expect( stats.half_open == 2 and stats.queued == 0, "two connections should be half-open" );
+      expect( stats.syn_cookies_sent == 0, "no SYN cookies should be sent" );
+      expect( server.connection_count() == 2, "only the half-open connections should be kept" );
+      const TCPMessage syn_ack = client.receive( 50000 );
+      expect( syn_ack.sender->SYN and client.receive( 50001 ).sender->SYN, "the first two SYNs should be answered" );
+
+      // Completing a handshake moves its connection to the accept queue, making room for another SYN
+      client.send( 50000,
+                   { TCPSenderMessage { .seqno = Wrap32 { 50000 * 1000U + 1 } },
+                     TCPReceiverMessage { .ackno = syn_ack.sender->seqno + 1, .window_size = UINT16_MAX } } );
+      eventually( [&] { return listener.stats().queued == 1; }, "the completed connection is queued" );
+      expect( listener.stats().half_open == 1, "one connection should be left half-open" );
+      client.send_syn( 50005, Wrap32 { 0 } );
+      eventually( [&] { return listener.stats().half_open == 2; }, "the next SYN takes the free place" );
+      expect( listener.stats().syns_dropped == 3, "no more SYNs should be dropped" );
+
+      const auto accepted = listener.try_accept();
+      expect( accepted.has_value() and accepted->tuple().remote_port == 50000, "the completed connection" );
+      expect( not listener.try_accept().has_value(), "only one connection should be established" );
+    }
+
+    {
+      // SYNs beyond the backlog of established connections waiting for accept() are dropped, even with cookies
+      auto [client_udp, server_udp] = loopback_pair();
+      RawClient raw { client_udp.duplicate() };
+      Stack client { LoopbackDevice { std::move( client_udp ) } };
+      Stack server { LoopbackDevice { std::move( server_udp ) } };
+      auto listener = server.listen( cfg, server_address, 2 );
+      auto first = client.connect( cfg, client_address, server_address );
+      auto second = client.connect( cfg, client_address, server_address );
+      eventually( [&] { return listener.stats().queued == 2; }, "both connections are queued" );
+
+      raw.send_syn( 40000, Wrap32 { 1 } );
+      eventually( [&] { return listener.stats().syns_dropped == 1; }, "a SYN to a full accept queue is dropped" );
+      expect( listener.stats().half_open == 0 and listener.stats().syn_cookies_sent == 0, "and not answered" );
+
+      const auto accepted = listener.accept();
+      expect( accepted.tuple().remote_port == first.tuple().local_port, "accept() takes the oldest connection" );
+      raw.send_syn( 40001, Wrap32 { 1 } );
+      eventually( [&] { return listener.stats().half_open == 1; }, "a SYN is taken once there is room" );
+      expect( listener.stats().queued == 1 and listener.stats().syns_dropped == 1, "one connection still queued" );
+    }
+
+    {
+      // With SYN cookies, a SYN that finds the SYN queue full is answered statelessly, and the ACK that
+      // acknowledges the cookie opens its connection
+      auto [client_udp, server_udp] = loopback_pair();
+      RawClient client { std::move( client_udp ) };
+      Stack server { LoopbackDevice { std::move( server_udp ) } };
+      auto listener = server.listen( cfg, server_address, 1 );
+      client.send_syn( 50000, Wrap32 { 7 } );
+      eventually( [&] { return listener.stats().half_open == 1; }, "the first SYN is half-open" );
+
+      const Wrap32 client_isn { 123456 };
+      client.send_syn( 50001, client_isn );
+      const TCPMessage cookie = client.receive( 50001 );
+      expect( cookie.sender->SYN and cookie.receiver->ackno == client_isn + 1, "the SYN should be answered" );
+      auto stats = listener.stats();
+      expect( stats.syn_cookies_sent == 1 and stats.half_open == 1, "with a cookie, and no state" );
+      expect( server.connection_count() == 1, "only the first SYN should be kept" );
+
+      // An ACK that does not acknowledge a cookie is ignored
+      client.send( 50002,
+                   { TCPSenderMessage { .seqno = Wrap32 { 1 } },
+                     TCPReceiverMessage { .ackno = cookie.sender->seqno + 1, .window_size = UINT16_MAX } } );
+      client.send( 50001,
+                   { TCPSenderMessage { .seqno = client_isn + 1 },
+                     TCPReceiverMessage { .ackno = cookie.sender->seqno + 2, .window_size = UINT16_MAX } } );
+
+      // and the right one opens the connection, with data
+      client.send( 50001,
+                   { TCPSenderMessage { .seqno = client_isn + 1, .payload = "after the cookie" },
+                     TCPReceiverMessage { .ackno = cookie.sender->seqno + 1, .window_size = UINT16_MAX } } );
+      auto accepted = listener.accept();
+      expect( accepted.tuple() == TCPFourTuple { .local_ip = server_address.ipv4_numeric(),
+                                                 .remote_ip = client_address.ipv4_numeric(),
+                                                 .local_port = server_address.port(),
+                                                 .remote_port = 50001 },
+              "the connection should be the cookie's" );
+      string buffer( 64, '\0' );
+      accepted.read( buffer );
+      expect( buffer == "after the cookie", "the data of the ACK should be received" );
+      stats = listener.stats();
+      expect( stats.syn_cookies_accepted == 1, "one cookie should be accepted, and no forged ones" );
+      expect( server.connection_count() == 2, "no connection should be opened by a forged ACK" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
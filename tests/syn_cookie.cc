@@ -0,0 +1,113 @@
+#include "random.hh"
+#include "tcp_syn_cookie.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "syn_cookie: " + what );
+  }
+}
+
+void expect_valid( const optional<bool>& ecn, bool expected, const string& what )
+{
+  expect( ecn.has_value(), what + ": cookie should be valid" );
+  expect( ecn.value() == expected, what + ": cookie should carry ECN = " + to_string( expected ) );
+}
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+    const SynCookieGenerator cookies { { 0x0123456789abcdefULL, 0xfedcba9876543210ULL } };
+    const TCPFourTuple tuple {
+      .local_ip = 0xa9fe9001, .remote_ip = 0xa9fe9009, .local_port = 9001, .remote_port = 50000 };
+    const Wrap32 client_isn { 0xdeadbeef };
+    constexpr uint64_t period = SynCookieGenerator::PERIOD_MS;
+    const uint64_t now = 1000 * period + 123;
+
+    {
+      // A cookie is checked against what it was issued for, and tells whether the SYN asked for ECN
+      const Wrap32 isn = cookies.cookie( tuple, client_isn, false, now );
+      const Wrap32 ecn_isn = cookies.cookie( tuple, client_isn, true, now );
+      expect_valid( cookies.check( tuple, client_isn, isn, now ), false, "round trip" );
+      expect_valid( cookies.check( tuple, client_isn, ecn_isn, now ), true, "round trip with ECN" );
+      expect( isn == cookies.cookie( tuple, client_isn, false, now + 1 ), "cookie should be stable in a period" );
+      expect( isn != ecn_isn, "ECN should change the cookie" );
+
+      // (the ECN bit is the only difference in the layout that is not hashed)
+      const uint32_t raw = static_cast<uint32_t>( isn.unwrap( Wrap32 { 0 }, 0 ) );
+      const uint32_t ecn_raw = static_cast<uint32_t>( ecn_isn.unwrap( Wrap32 { 0 }, 0 ) );
+      expect( ( raw >> 27U ) == ( ecn_raw >> 27U ), "ECN should not change the timestamp" );
+      expect( ( ecn_raw & ( 1U << 26U ) ) and not( raw & ( 1U << 26U ) ), "ECN should set bit 26" );
+      expect( not cookies.check( tuple, client_isn, Wrap32 { raw | ( 1U << 26U ) }, now ).has_value(),
+              "setting the ECN bit of a cookie should invalidate it" );
+      expect( not cookies.check( tuple, client_isn, Wrap32 { ecn_raw & ~( 1U << 26U ) }, now ).has_value(),
+              "clearing the ECN bit of a cookie should invalidate it" );
+    }
+
+    {
+      // A cookie is valid in the period it was issued in and the next one, and not afterwards
+      const Wrap32 isn = cookies.cookie( tuple, client_isn, false, now );
+      const uint64_t start = now - now % period;
+      expect_valid( cookies.check( tuple, client_isn, isn, start ), false, "start of the period" );
+      expect_valid( cookies.check( tuple, client_isn, isn, start + period - 1 ), false, "end of the period" );
+      expect_valid( cookies.check( tuple, client_isn, isn, start + period ), false, "next period" );
+      expect_valid( cookies.check( tuple, client_isn, isn, start + 2 * period - 1 ), false, "end of next period" );
+      expect( not cookies.check( tuple, client_isn, isn, start + 2 * period ).has_value(), "two periods later" );
+      expect( not cookies.check( tuple, client_isn, isn, start - 1 ).has_value(), "before it was issued" );
+      // (the timestamp bits wrap around after 32 periods, but the hash covers the whole period)
+      expect( not cookies.check( tuple, client_isn, isn, start + 32 * period ).has_value(), "32 periods later" );
+      expect( not cookies.check( tuple, client_isn, isn, start + 33 * period ).has_value(), "33 periods later" );
+    }
+
+    {
+      // A cookie is only good for its own connection, client ISN and key
+      const Wrap32 isn = cookies.cookie( tuple, client_isn, false, now );
+      TCPFourTuple other = tuple;
+      other.remote_port++;
+      expect( not cookies.check( other, client_isn, isn, now ).has_value(), "another port" );
+      other = tuple;
+      other.remote_ip++;
+      expect( not cookies.check( other, client_isn, isn, now ).has_value(), "another address" );
+      expect( not cookies.check( tuple, client_isn + 1, isn, now ).has_value(), "another client ISN" );
+      const SynCookieGenerator other_key { { 0x0123456789abcdefULL, 0xfedcba9876543211ULL } };
+      expect( not other_key.check( tuple, client_isn, isn, now ).has_value(), "another key" );
+      expect( other_key.cookie( tuple, client_isn, false, now ) != isn, "another key gives another cookie" );
+      const SynCookieGenerator same_key { { 0x0123456789abcdefULL, 0xfedcba9876543210ULL } };
+      expect_valid( same_key.check( tuple, client_isn, isn, now ), false, "the same key" );
+    }
+
+    {
+      // A forged ACK (guessing the cookie) is rejected: with 26 bits of hash, a random guess that also has the
+      // right timestamp passes once in 2^26 tries, so none of these should
+      uniform_int_distribution<uint32_t> dist;
+      const Wrap32 isn = cookies.cookie( tuple, client_isn, false, now );
+      unsigned accepted = 0;
+      for ( unsigned i = 0; i < 100000; i++ ) {
+        const Wrap32 guess { dist( rd ) };
+        accepted += guess != isn and cookies.check( tuple, client_isn, guess, now ).has_value();
+      }
+      for ( uint32_t i = 1; i < 4096; i++ ) {
+        accepted += cookies.check( tuple, client_isn, isn + i, now ).has_value();
+      }
+      expect( accepted == 0, to_string( accepted ) + " forged cookies were accepted" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,257 @@
+#include "helpers.hh"
+#include "router.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_peer.hh"
+#include "tcp_speed_test.hh"
+
+#include <array>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace std;
+
+namespace {
+// A point-to-point Ethernet link between two NetworkInterfaces, with a fixed delay in simulated milliseconds
+class DelayLink : public NetworkInterface::OutputPort
+{
+  uint64_t delay_ms_;
+  uint64_t now_ms_ {};
+  array<weak_ptr<NetworkInterface>, 2> ends_ {};
+  deque<tuple<uint64_t, NetworkInterface*, EthernetFrame>> in_flight_ {}; // (delivery time, receiver, frame)
+
+public:
+  explicit DelayLink( uint64_t delay_ms ) : delay_ms_( delay_ms ) {}
+
+  void connect( const shared_ptr<NetworkInterface>& a, const shared_ptr<NetworkInterface>& b ) { ends_ = { a, b }; }
+
+  void transmit( const NetworkInterface& sender, const EthernetFrame& frame ) override
+  {
+    const shared_ptr<NetworkInterface> receiver { ends_[0].lock().get() == &sender ? ends_[1] : ends_[0] };
+    in_flight_.emplace_back( now_ms_ + delay_ms_, receiver.get(), clone( frame ) );
+  }
+
+  void advance( uint64_t ms ) { now_ms_ += ms; }
+
+  void deliver()
+  {
+    while ( not in_flight_.empty() and get<0>( in_flight_.front() ) <= now_ms_ ) {
+      auto [when, receiver, frame] = std::move( in_flight_.front() );
+      in_flight_.pop_front();
+      receiver->recv_frame( std::move( frame ) );
+    }
+  }
+};
+
+EthernetAddress ethernet_address( uint8_t n )
+{
+  return { 0x02, 0, 0, 0, 0, n };
+}
+
+// A TCPPeer on a host with one NetworkInterface, sending its segments to a default router
+class Host
+{
+  shared_ptr<NetworkInterface> interface_;
+  Address router_;
+  TCPOverIPv4Adapter adapter_ {};
+  Wrap32 isn_;
+  uint64_t next_seqno_ {}; // one past the highest sequence number sent so far
+
+public:
+  TCPPeer peer;
+  uint64_t segments_sent {};
+  uint64_t retransmissions {};
+
+  Host( shared_ptr<NetworkInterface> interface, const Address& router, const TCPConfig& cfg, FdAdapterConfig ad )
+    : interface_( std::move( interface ) ), router_( router ), isn_( cfg.isn ), peer( cfg )
+  {
+    adapter_.config_mut() = std::move( ad );
+  }
+
+  auto transmit()
+  {
+    return [this]( span<const TCPMessage> batch ) {
+      for ( const auto& msg : batch ) {
+        const uint64_t seqno = msg.sender->seqno.unwrap( isn_, next_seqno_ );
+        if ( msg.sender->sequence_length() > 0 ) {
+          ++segments_sent;
+          retransmissions += seqno < next_seqno_;
+          next_seqno_ = max( next_seqno_, seqno + msg.sender->sequence_length() );
+        }
+        interface_->send_datagram( adapter_.wrap_tcp_in_ip( msg ), router_ );
+      }
+    };
+  }
+
+  void receive()
+  {
+    auto& datagrams = interface_->datagrams_received();
+    while ( not datagrams.empty() ) {
+      auto msg = adapter_.unwrap_tcp_in_ip( std::move( datagrams.front() ) );
+      datagrams.pop();
+      if ( msg.has_value() ) {
+        peer.receive( std::move( *msg ), transmit() );
+      }
+    }
+  }
+
+  void tick( uint64_t ms )
+  {
+    interface_->tick( ms );
+    peer.tick( ms, transmit() );
+  }
+};
+
+// client -- router A ==(bottleneck)== router B -- server
+//
+// The client sends `total_bytes` to the server across two routers. Router A forwards at most `rate` datagrams
+// per millisecond towards router B, queueing up to `capacity` of them and dropping the rest; if `ecn` is set,
+// both peers negotiate ECN and router A marks datagrams CE once `ecn_threshold` are queued.
+void transfer( const string& benchmark, bool ecn, size_t rate, size_t capacity, size_t ecn_threshold )
+{
+  constexpr size_t total_bytes = 4 << 20;
+  constexpr uint64_t hop_delay_ms = 2;
+
+  const auto client_link = make_shared<DelayLink>( hop_delay_ms );
+  const auto middle_link = make_shared<DelayLink>( hop_delay_ms );
+  const auto server_link = make_shared<DelayLink>( hop_delay_ms );
+  const array links { client_link, middle_link, server_link };
+
+  const Address client_ip { "10.0.1.2" };
+  const Address server_ip { "10.0.3.2" };
+
+  const auto client_if = make_shared<NetworkInterface>( "client", client_link, ethernet_address( 1 ), client_ip );
+  const auto a0 = make_shared<NetworkInterface>( "a0", client_link, ethernet_address( 2 ), Address { "10.0.1.1" } );
+  const auto a1 = make_shared<NetworkInterface>( "a1", middle_link, ethernet_address( 3 ), Address { "10.0.2.1" } );
+  const auto b0 = make_shared<NetworkInterface>( "b0", middle_link, ethernet_address( 4 ), Address { "10.0.2.2" } );
+  const auto b1 = make_shared<NetworkInterface>( "b1", server_link, ethernet_address( 5 ), Address { "10.0.3.1" } );
+  const auto server_if = make_shared<NetworkInterface>( "server", server_link, ethernet_address( 6 ), server_ip );
+  client_link->connect( client_if, a0 );
+  middle_link->connect( a1, b0 );
+  server_link->connect( b1, server_if );
+
+  Router router_a;
+  router_a.add_interface( a0 );
+  router_a.add_interface( a1 );
+  router_a.add_route( Address { "10.0.1.0" }.ipv4_numeric(), 24, {}, 0 );
+  router_a.add_route( Address { "10.0.3.0" }.ipv4_numeric(), 24, Address { "10.0.2.2" }, 1 );
+  router_a.set_output_queue( 1, rate, capacity, ecn ? ecn_threshold : numeric_limits<size_t>::max() );
+
+  Router router_b;
+  router_b.add_interface( b0 );
+  router_b.add_interface( b1 );
+  router_b.add_route( Address { "10.0.3.0" }.ipv4_numeric(), 24, {}, 1 );
+  router_b.add_route( Address { "10.0.1.0" }.ipv4_numeric(), 24, Address { "10.0.2.1" }, 0 );
+
+  TCPConfig cfg;
+  cfg.rt_timeout = 50;
+  cfg.send_capacity = 256 * 1024;
+  cfg.recv_capacity = 256 * 1024;
+  cfg.ecn = ecn;
+
+  FdAdapterConfig client_ad;
+  client_ad.source = Address { client_ip.ip(), 9000 };
+  client_ad.destination = Address { server_ip.ip(), 9001 };
+  FdAdapterConfig server_ad;
+  server_ad.source = client_ad.destination;
+  server_ad.destination = client_ad.source;
+
+  cfg.isn = Wrap32 { 1000 };
+  Host client { client_if, Address { "10.0.1.1" }, cfg, client_ad };
+  cfg.isn = Wrap32 { 2000 };
+  Host server { server_if, Address { "10.0.3.1" }, cfg, server_ad };
+
+  const string data = random_payload( 65536, 1 );
+  uint64_t bytes_written = 0;
+  uint64_t bytes_read = 0;
+  uint64_t elapsed_ms = 0;
+
+  const SpeedTimer timer;
+  client.peer.push( client.transmit() );
+  while ( client.peer.active() or server.peer.active() ) {
+    Writer& outbound = client.peer.outbound_writer();
+    if ( bytes_written < total_bytes and outbound.available_capacity() > 0 ) {
+      const size_t len = min( { outbound.available_capacity(), data.size(), total_bytes - bytes_written } );
+      outbound.push( data.substr( 0, len ) );
+      bytes_written += len;
+      if ( bytes_written == total_bytes ) {
+        outbound.close();
+      }
+      client.peer.push( client.transmit() );
+    }
+
+    for ( const auto& link : links ) {
+      link->deliver();
+    }
+    router_a.route();
+    router_b.route();
+    client.receive();
+    server.receive();
+
+    Reader& inbound = server.peer.inbound_reader();
+    if ( inbound.bytes_buffered() ) {
+      bytes_read += inbound.bytes_buffered();
+      inbound.pop( inbound.bytes_buffered() );
+      server.peer.send_window_update( server.transmit() );
+    }
+    if ( inbound.is_finished() and not server.peer.outbound_writer().is_closed() ) {
+      server.peer.outbound_writer().close();
+      server.peer.push( server.transmit() );
+    }
+
+    for ( const auto& link : links ) {
+      link->advance( 1 );
+    }
+    for ( const auto& interface : { a0, a1, b0, b1 } ) {
+      interface->tick( 1 );
+    }
+    client.tick( 1 );
+    server.tick( 1 );
+    ++elapsed_ms;
+  }
+  const double seconds = timer.elapsed();
+
+  if ( bytes_read != total_bytes ) {
+    throw runtime_error( "transfer across the routers did not deliver the whole stream" );
+  }
+
+  SpeedResult result { .benchmark = benchmark,
+                       .parameters = { { "rate", rate },
+                                       { "capacity", capacity },
+                                       { "ecn_threshold", ecn ? ecn_threshold : 0 } },
+                       .seconds = seconds,
+                       .segments = client.segments_sent,
+                       .bytes = bytes_read };
+  result.extra["retransmissions"] = static_cast<double>( client.retransmissions );
+  result.extra["datagrams_dropped"] = static_cast<double>( router_a.datagrams_dropped() );
+  result.extra["datagrams_marked"] = static_cast<double>( router_a.datagrams_marked() );
+  result.extra["simulated_ms"] = static_cast<double>( elapsed_ms );
+  result.report();
+}
+
+void program_body()
+{
+  // The same bottleneck, signalling congestion by tail drop vs. by CE marks before the queue overflows
+  transfer( "ecn_multi_hop_drop", false, 4, 64, 0 );
+  transfer( "ecn_multi_hop_ecn", true, 4, 64, 16 );
+}
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
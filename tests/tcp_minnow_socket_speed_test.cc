@@ -0,0 +1,313 @@
+#include "eventfd.hh"
+#include "eventloop.hh"
+#include "helpers.hh"
+#include "loopback_device.hh"
+#include "tcp_minnow_socket_impl.hh"
+#include "tcp_speed_test.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+// A datagram adapter whose "wire" ends in a TCPPeer on the TCPMinnowSocket's own thread, which acknowledges the
+// segments as soon as they are written (its replies are read back through an EventFD) and throws their payload
+// away, or echoes it. There is no network in between, so what is left to measure is the path between the owner
+// and the wire.
+class PeerAdapter : public FdAdapterBase
+{
+  TCPPeer far_end_;
+  deque<TCPMessage> replies_ {};
+  EventFD replies_waiting_ {};
+  shared_ptr<atomic<uint64_t>> bytes_received_;
+  bool echo_;
+
+  void transmit( span<const TCPMessage> batch )
+  {
+    if ( replies_.empty() and not batch.empty() ) {
+      replies_waiting_.notify();
+    }
+    replies_.insert( replies_.end(), batch.begin(), batch.end() );
+  }
+
+  void receive( const TCPMessage& seg )
+  {
+    const auto reply = [&]( span<const TCPMessage> batch ) { transmit( batch ); };
+    far_end_.receive( seg, reply );
+    Reader& inbound = far_end_.inbound_reader();
+    bytes_received_->fetch_add( inbound.bytes_buffered() );
+    if ( echo_ ) {
+      far_end_.outbound_writer().push( inbound.peek() );
+    }
+    inbound.pop( inbound.bytes_buffered() );
+    if ( inbound.is_finished() and not far_end_.outbound_writer().is_closed() ) {
+      far_end_.outbound_writer().close();
+    }
+    far_end_.push( reply );
+  }
+
+public:
+  PeerAdapter( const TCPConfig& cfg, shared_ptr<atomic<uint64_t>> bytes_received, bool echo = false )
+    : far_end_( cfg ), bytes_received_( std::move( bytes_received ) ), echo_( echo )
+  {}
+
+  optional<TCPMessage> read()
+  {
+    if ( replies_.empty() ) {
+      return {};
+    }
+    TCPMessage reply = std::move( replies_.front() );
+    replies_.pop_front();
+    replies_waiting_.clear();
+    if ( not replies_.empty() ) {
+      replies_waiting_.notify();
+    }
+    return reply;
+  }
+
+  void write( const TCPMessage& seg ) { receive( seg ); }
+
+  void write( span<const TCPMessage> batch )
+  {
+    for ( const auto& seg : batch ) {
+      receive( seg );
+    }
+  }
+
+  void tick( size_t ms )
+  {
+    far_end_.tick( ms, [&]( span<const TCPMessage> batch ) { transmit( batch ); } );
+  }
+
+  FileDescriptor& fd() { return replies_waiting_; }
+};
+
+static_assert( TCPDatagramAdapter<PeerAdapter> );
+
+// The application writes `total_bytes` to a TCPMinnowSocket in writes of `write_size` bytes, as fast as it can,
+// to a PeerAdapter. Measures the throughput from the application to the wire (until the far end has received
+// every byte), which is bounded by the handoff of the bytes between the application and the TCPPeer thread.
+void app_to_wire( const string& benchmark, size_t write_size, size_t total_bytes )
+{
+  TCPConfig cfg;
+  cfg.rt_timeout = 10;
+  cfg.recv_capacity = 4 * 65536;
+  cfg.send_capacity = 4 * 65536;
+
+  FdAdapterConfig ad;
+  ad.source = { "169.254.144.9", "9000" };
+  ad.destination = { "169.254.144.1", "9001" };
+
+  auto bytes_received = make_shared<atomic<uint64_t>>();
+  TCPMinnowSocket<PeerAdapter> socket { PeerAdapter { cfg, bytes_received } };
+  socket.connect( cfg, ad );
+
+  const string data = random_payload( write_size, 1 );
+  uint64_t writes = 0;
+  const SpeedTimer timer;
+  for ( size_t written = 0; written < total_bytes; ++writes ) {
+    written += socket.write( string_view { data }.substr( 0, min( data.size(), total_bytes - written ) ) );
+  }
+  socket.shutdown( SHUT_WR );
+  string buffer;
+  while ( not socket.eof() ) {
+    socket.read( buffer );
+  }
+  const double seconds = timer.elapsed();
+  socket.wait_until_closed();
+
+  if ( bytes_received->load() != total_bytes ) {
+    throw runtime_error( "TCPMinnowSocket did not deliver the whole stream to the wire" );
+  }
+
+  SpeedResult result { .benchmark = benchmark,
+                       .parameters = { { "write_size", write_size } },
+                       .seconds = seconds,
+                       .bytes = total_bytes };
+  result.extra["ns_per_write"] = seconds * 1e9 / static_cast<double>( writes );
+  result.report();
+}
+
+// The application sends `round_trips` requests of `request_size` bytes, one at a time, to a PeerAdapter that
+// echoes them, and waits for each response. The TCPMinnowSocket runs either on its own thread (the application
+// reads and writes through the rings) or inline, in the application's EventLoop (it reads and writes the
+// TCPPeer's streams); on its own thread, it may busy-poll for `busy_poll_us` after each event. Measures the time
+// per round trip, and its distribution.
+void request_response( const string& benchmark,
+                       bool inline_mode,
+                       uint64_t busy_poll_us,
+                       size_t request_size,
+                       size_t round_trips )
+{
+  TCPConfig cfg;
+  cfg.rt_timeout = 10;
+
+  FdAdapterConfig ad;
+  ad.source = { "169.254.144.9", "9000" };
+  ad.destination = { "169.254.144.1", "9001" };
+
+  const string request = random_payload( request_size, 1 );
+  auto bytes_received = make_shared<atomic<uint64_t>>();
+  EventLoop eventloop;
+  optional<TCPMinnowSocket<PeerAdapter>> socket;
+  if ( inline_mode ) {
+    socket.emplace( PeerAdapter { cfg, bytes_received, true }, eventloop );
+  } else {
+    socket.emplace( PeerAdapter { cfg, bytes_received, true } );
+  }
+  socket->set_nodelay( true );
+  socket->set_busy_poll( busy_poll_us );
+  socket->connect( cfg, ad );
+
+  string buffer;
+  vector<double> latencies_us;
+  latencies_us.reserve( round_trips );
+  const SpeedTimer timer;
+  for ( size_t i = 0; i < round_trips; i++ ) {
+    const auto start = chrono::steady_clock::now();
+    if ( inline_mode ) {
+      socket->outbound_writer().push( request );
+      socket->push();
+      while ( socket->inbound_reader().bytes_buffered() < request_size ) {
+        eventloop.wait_next_event( TCP_TICK_MS );
+        socket->tick();
+      }
+      socket->inbound_reader().pop( request_size );
+    } else {
+      socket->write( request );
+      for ( size_t received = 0; received < request_size; received += buffer.size() ) {
+        buffer.resize( request_size - received );
+        socket->read( buffer );
+      }
+    }
+    latencies_us.push_back( chrono::duration<double, micro>( chrono::steady_clock::now() - start ).count() );
+  }
+  const double seconds = timer.elapsed();
+  socket->wait_until_closed();
+
+  if ( bytes_received->load() != request_size * round_trips ) {
+    throw runtime_error( "TCPMinnowSocket did not deliver every request" );
+  }
+
+  SpeedResult result { .benchmark = benchmark,
+                       .parameters = { { "request_size", request_size }, { "busy_poll_us", busy_poll_us } },
+                       .seconds = seconds,
+                       .bytes = 2 * request_size * round_trips };
+  result.extra["us_per_round_trip"] = seconds * 1e6 / static_cast<double>( round_trips );
+  ranges::sort( latencies_us );
+  for ( const auto& [name, quantile] :
+        { pair { "p50_us", 0.5 }, pair { "p99_us", 0.99 }, pair { "p999_us", 0.999 } } ) {
+    result.extra[name] = latencies_us[static_cast<size_t>( quantile * static_cast<double>( round_trips - 1 ) )];
+  }
+  result.report();
+}
+
+// The server's application writes `total_bytes` to its TCPMinnowSocket as fast as it can, and the client's
+// application reads them with a large buffer. Measures how many times the reader is woken up (reads that
+// return data) per megabyte, with the given receive low-watermark on the client and send low-watermark on the
+// server (1 byte: the default, hand over bytes as soon as there are any).
+void bulk_read( const string& benchmark, uint64_t receive_lowat, uint64_t send_lowat, size_t total_bytes )
+{
+  auto [client_udp, server_udp] = loopback_pair();
+
+  TCPConfig cfg;
+  cfg.rt_timeout = 10;
+  cfg.recv_capacity = 4 * 65536;
+  cfg.send_capacity = 4 * 65536;
+
+  FdAdapterConfig client_ad;
+  client_ad.source = { "169.254.144.9", "9000" };
+  client_ad.destination = { "169.254.144.1", "9001" };
+  FdAdapterConfig server_ad;
+  server_ad.source = { "169.254.144.1", "9001" };
+
+  TCPMinnowSocket<LoopbackAdapter> client { LoopbackAdapter { std::move( client_udp ) } };
+  TCPMinnowSocket<LoopbackAdapter> server { LoopbackAdapter { std::move( server_udp ) } };
+
+  const string data = random_payload( 65536, 1 );
+  const SpeedTimer timer;
+
+  thread server_app( [&] {
+    server.listen_and_accept( cfg, server_ad );
+    server.set_send_lowat( send_lowat );
+    for ( size_t written = 0; written < total_bytes; ) {
+      written += server.write( string_view { data }.substr( 0, min( data.size(), total_bytes - written ) ) );
+    }
+    server.wait_until_closed();
+  } );
+
+  cfg.isn = Wrap32 { 1000 };
+  client.connect( cfg, client_ad );
+  client.set_receive_lowat( receive_lowat );
+
+  uint64_t bytes_read = 0;
+  uint64_t wakeups = 0;
+  string buffer;
+  while ( not client.eof() ) {
+    buffer.resize( 1 << 20 );
+    client.read( buffer );
+    bytes_read += buffer.size();
+    wakeups += not buffer.empty();
+  }
+  const double seconds = timer.elapsed();
+  client.wait_until_closed();
+  server_app.join();
+
+  if ( bytes_read != total_bytes ) {
+    throw runtime_error( "TCPMinnowSocket pair did not deliver the whole stream" );
+  }
+
+  const double megabytes = static_cast<double>( bytes_read ) / ( 1 << 20 );
+  SpeedResult result { .benchmark = benchmark,
+                       .parameters = { { "receive_lowat", receive_lowat }, { "send_lowat", send_lowat } },
+                       .seconds = seconds,
+                       .bytes = bytes_read };
+  result.extra["reader_wakeups_per_mb"] = static_cast<double>( wakeups ) / megabytes;
+  result.extra["bytes_per_wakeup"] = static_cast<double>( bytes_read ) / static_cast<double>( wakeups );
+  result.report();
+}
+
+void program_body()
+{
+  // The owner's writes handed to the TCPPeer thread, small and large
+  app_to_wire( "socket_app_to_wire_1k", 1024, 1 << 26 );
+  app_to_wire( "socket_app_to_wire_64k", 65536, 1 << 28 );
+
+  // Requests and responses through the TCPPeer thread vs. with the TCPPeer driven inline
+  request_response( "socket_rpc_threaded", false, 0, 128, 20000 );
+  request_response( "socket_rpc_inline", true, 0, 128, 20000 );
+
+  // ... and with the TCPPeer thread (and the reader) busy-polling for 50 us after each event before sleeping
+  request_response( "socket_rpc_busy_poll", false, 50, 128, 20000 );
+
+  // Waking the reader whenever any bytes are ready vs. once 64 KiB are (and the writer likewise)
+  bulk_read( "socket_bulk_read_lowat_1", 1, 1, 1 << 24 );
+  bulk_read( "socket_bulk_read_lowat_64k", 65536, 65536, 1 << 24 );
+}
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,354 @@
+#include "loopback_device.hh"
+#include "sharded_tcp_minnow_stack.hh"
+#include "tcp_minnow_stack_impl.hh"
+#include "tcp_speed_test.hh"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <sys/socket.h>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+// Open `connections` concurrent connections from one TCPMinnowStack to another, exchange a small request and
+// response on each of them (while all are open), then close them all. Measures the rate of connection setup
+// and of request/response exchanges, with everything running on the two stacks' threads.
+void many_connections( size_t connections )
+{
+  constexpr size_t request_size = 64;
+  constexpr size_t wave = 100;
+  auto [client_udp, server_udp] = loopback_pair();
+
+  TCPConfig cfg;
+  cfg.rt_timeout = 20;
+  cfg.send_capacity = 4096;
+  cfg.recv_capacity = 4096;
+
+  const Address server_address { "169.254.144.1", 9001 };
+  const Address client_address { "169.254.144.9", 0 };
+
+  TCPMinnowStack<LoopbackDevice> client { LoopbackDevice { std::move( client_udp ) } };
+  TCPMinnowStack<LoopbackDevice> server { LoopbackDevice { std::move( server_udp ) } };
+  auto listener = server.listen( cfg, server_address );
+
+  // The server echoes each request and closes its end, then waits for the client to close.
+  thread server_app( [&] {
+    vector<TCPMinnowStack<LoopbackDevice>::Socket> sockets;
+    sockets.reserve( connections );
+    while ( sockets.size() < connections ) {
+      sockets.push_back( listener.accept() );
+    }
+    string buffer;
+    for ( auto& socket : sockets ) {
+      for ( size_t echoed = 0; echoed < request_size; ) {
+        buffer.resize( request_size );
+        socket.read( buffer );
+        if ( buffer.empty() ) {
+          throw runtime_error( "request ended early" );
+        }
+        echoed += buffer.size();
+        for ( string_view rest = buffer; not rest.empty(); ) {
+          rest.remove_prefix( socket.write( rest ) );
+        }
+      }
+      socket.shutdown_write();
+    }
+    for ( auto& socket : sockets ) {
+      socket.wait_until_closed();
+    }
+  } );
+
+  const SpeedTimer timer;
+  vector<TCPMinnowStack<LoopbackDevice>::Socket> sockets;
+  sockets.reserve( connections );
+  for ( size_t i = 0; i < connections; i++ ) {
+    sockets.push_back( client.connect( cfg, client_address, server_address ) );
+  }
+  const double connect_seconds = timer.elapsed();
+  const size_t peak_connections = client.connection_count();
+
+  // Each response ends with the server closing its end, and then the client closes its own. (In waves, so that
+  // a burst over every connection at once does not overflow the loopback socket's buffer.)
+  const string request = random_payload( request_size, 1 );
+  string buffer;
+  uint64_t bytes_read = 0;
+  for ( size_t start = 0; start < connections; start += wave ) {
+    const span wave_sockets = span { sockets }.subspan( start, min( wave, connections - start ) );
+    for ( auto& socket : wave_sockets ) {
+      if ( socket.write( request ) != request.size() ) {
+        throw runtime_error( "request did not fit in the send buffer" );
+      }
+    }
+    for ( auto& socket : wave_sockets ) {
+      while ( not socket.eof() ) {
+        buffer.resize( request_size );
+        socket.read( buffer );
+        bytes_read += buffer.size();
+      }
+      socket.shutdown_write();
+    }
+  }
+  const double exchange_seconds = timer.elapsed() - connect_seconds;
+
+  server_app.join();
+  for ( auto& socket : sockets ) {
+    socket.wait_until_closed();
+  }
+  const double seconds = timer.elapsed();
+
+  if ( bytes_read != connections * request_size or peak_connections != connections ) {
+    throw runtime_error( "TCPMinnowStack pair did not run every connection to completion" );
+  }
+
+  SpeedResult result { .benchmark = "stack_connections",
+                       .parameters = { { "connections", connections } },
+                       .seconds = seconds,
+                       .bytes = bytes_read };
+  result.extra["peak_connections"] = static_cast<double>( peak_connections );
+  result.extra["connections_per_second"] = static_cast<double>( connections ) / connect_seconds;
+  result.extra["exchanges_per_second"] = static_cast<double>( connections ) / exchange_seconds;
+  result.report();
+}
+
+// Spoofed SYNs from random addresses and ports, as fast as `per_ms` per millisecond, written straight into the
+// server's device until `stop` is set. None of them is ever followed by an ACK.
+uint64_t syn_flood( FileDescriptor& link, const Address& server, size_t per_ms, const atomic_bool& stop )
+{
+  minstd_rand rand { 1 };
+  TCPConfig cfg;
+  string headers;
+  uint64_t syns = 0;
+  while ( not stop ) {
+    for ( size_t i = 0; i < per_ms; i++ ) {
+      const TCPFourTuple tuple { .local_ip = static_cast<uint32_t>( rand() ),
+                                 .remote_ip = server.ipv4_numeric(),
+                                 .local_port = static_cast<uint16_t>( rand() ),
+                                 .remote_port = server.port() };
+      const TCPMessage syn { TCPSenderMessage { .seqno = Wrap32 { static_cast<uint32_t>( rand() ) }, .SYN = true },
+                             TCPReceiverMessage { .window_size = UINT16_MAX } };
+      TCPOverIPv4Adapter::segment_tcp_in_ip( tuple, cfg.mss, syn, headers, [&]( string_view hdrs, string_view ) {
+        link.write( hdrs );
+      } );
+      ++syns;
+    }
+    this_thread::sleep_for( chrono::milliseconds { 1 } );
+  }
+  return syns;
+}
+
+// Open and close `connections` connections one after another, each a full handshake through the listener,
+// optionally while a SYN flood keeps the listener's SYN queue full. Measures the handshake rate, and how much
+// state the server holds (with SYN cookies, the flood costs at most `backlog` half-open connections).
+void handshakes( const string& benchmark, size_t connections, size_t backlog, size_t flood_per_ms )
+{
+  auto [client_udp, server_udp] = loopback_pair();
+  FileDescriptor flood_link = client_udp.duplicate();
+
+  TCPConfig cfg;
+  cfg.rt_timeout = 20;
+  cfg.send_capacity = 4096;
+  cfg.recv_capacity = 4096;
+
+  const Address server_address { "169.254.144.1", 9001 };
+  const Address client_address { "169.254.144.9", 0 };
+
+  TCPMinnowStack<LoopbackDevice> client { LoopbackDevice { std::move( client_udp ) } };
+  TCPMinnowStack<LoopbackDevice> server { LoopbackDevice { std::move( server_udp ) } };
+  auto listener = server.listen( cfg, server_address, backlog );
+
+  thread server_app( [&] {
+    for ( size_t i = 0; i < connections; i++ ) {
+      listener.accept(); // and close it at once
+    }
+  } );
+
+  atomic_bool stop_flood { false };
+  uint64_t syns_flooded = 0;
+  thread flooder;
+  if ( flood_per_ms > 0 ) {
+    flooder = thread( [&] { syns_flooded = syn_flood( flood_link, server_address, flood_per_ms, stop_flood ); } );
+    while ( listener.stats().half_open < backlog ) {
+      this_thread::sleep_for( chrono::milliseconds { 1 } );
+    }
+  }
+
+  const SpeedTimer timer;
+  size_t peak_server_connections = 0;
+  for ( size_t i = 0; i < connections; i++ ) {
+    client.connect( cfg, client_address, server_address ); // and close it at once
+    if ( i % 64 == 0 ) {
+      peak_server_connections = max( peak_server_connections, server.connection_count() );
+    }
+  }
+  server_app.join();
+  const double seconds = timer.elapsed();
+
+  stop_flood = true;
+  if ( flooder.joinable() ) {
+    flooder.join();
+  }
+  const auto stats = listener.stats();
+  if ( flood_per_ms > 0 and stats.syn_cookies_accepted == 0 ) {
+    throw runtime_error( "no connection was opened with a SYN cookie during the SYN flood" );
+  }
+
+  SpeedResult result { .benchmark = benchmark,
+                       .parameters = { { "connections", connections },
+                                       { "backlog", backlog },
+                                       { "flood_syns_per_ms", flood_per_ms } },
+                       .seconds = seconds };
+  result.extra["connections_per_second"] = static_cast<double>( connections ) / seconds;
+  result.extra["syns_flooded"] = static_cast<double>( syns_flooded );
+  result.extra["syn_cookies_sent"] = static_cast<double>( stats.syn_cookies_sent );
+  result.extra["syn_cookies_accepted"] = static_cast<double>( stats.syn_cookies_accepted );
+  result.extra["peak_server_connections"] = static_cast<double>( peak_server_connections );
+  result.report();
+}
+
+// Send `bytes_per_connection` over each of `connections` connections at once, from one ShardedTCPMinnowStack
+// to another, each with `shards` shards (pinned to cores) linked pairwise by loopback sockets. The client
+// writes with one thread per shard, to the connections that shard owns; the server discards what it receives,
+// so that its side runs entirely on the shards' threads. Measures how the aggregate throughput scales with the
+// shards (up to the number of cores), and how many segments had to be handed from one shard to another: none,
+// unless the links are `crossed` (client shard i to server shard i + 1), when every segment is.
+void sharded_throughput( const string& benchmark,
+                         size_t shards,
+                         size_t connections,
+                         size_t bytes_per_connection,
+                         bool crossed )
+{
+  constexpr size_t write_size = 16384;
+  constexpr int socket_buffer = 4 << 20;
+
+  TCPConfig cfg;
+  cfg.rt_timeout = 20;
+  cfg.send_capacity = 16384;
+  cfg.recv_capacity = 16384;
+
+  const Address server_address { "169.254.144.1", 9001 };
+  const Address client_address { "169.254.144.9", 0 };
+
+  vector<LoopbackDevice> client_devices;
+  vector<LoopbackDevice> server_devices;
+  for ( size_t i = 0; i < shards; i++ ) {
+    auto [client_udp, server_udp] = loopback_pair();
+    // (room for every connection's window, so that the runs with fewer sockets do not lose more datagrams)
+    for ( const FileDescriptor* udp : { &client_udp, &server_udp } ) {
+      CheckSystemCall( "setsockopt",
+                       ::setsockopt( udp->fd_num(), SOL_SOCKET, SO_RCVBUF, &socket_buffer, sizeof( socket_buffer ) ) );
+    }
+    client_devices.emplace_back( std::move( client_udp ) );
+    server_devices.emplace_back( std::move( server_udp ) );
+  }
+  if ( crossed ) {
+    ranges::rotate( server_devices, server_devices.end() - 1 );
+  }
+  ShardedTCPMinnowStack<LoopbackDevice> client { std::move( client_devices ) };
+  ShardedTCPMinnowStack<LoopbackDevice> server { std::move( server_devices ) };
+  auto listeners = server.listen( cfg, server_address );
+
+  // The server accepts every connection, and closes it at once: from then on, its shard discards what arrives.
+  thread server_app( [&] {
+    for ( size_t accepted = 0; accepted < connections; ) {
+      bool idle = true;
+      for ( auto& listener : listeners ) {
+        if ( listener.try_accept() ) {
+          ++accepted;
+          idle = false;
+        }
+      }
+      if ( idle ) {
+        this_thread::sleep_for( chrono::milliseconds { 1 } );
+      }
+    }
+  } );
+
+  // (The shards take turns opening connections, so connection i belongs to shard i % shards.)
+  vector<ShardedTCPMinnowStack<LoopbackDevice>::Socket> sockets;
+  sockets.reserve( connections );
+  for ( size_t i = 0; i < connections; i++ ) {
+    sockets.push_back( client.connect( cfg, client_address, server_address ) );
+  }
+  server_app.join();
+
+  const string payload = random_payload( write_size, 1 );
+  atomic<uint64_t> bytes_written { 0 };
+  const SpeedTimer timer;
+  vector<thread> writers;
+  for ( size_t shard = 0; shard < shards; shard++ ) {
+    writers.emplace_back( [&, shard] {
+      vector<size_t> sent( connections );
+      for ( bool done = false; not done; ) {
+        done = true;
+        for ( size_t i = shard; i < connections; i += shards ) {
+          const size_t len = min( write_size, bytes_per_connection - sent[i] );
+          if ( len > 0 ) {
+            sent[i] += sockets[i].write( string_view { payload }.substr( 0, len ) );
+            done = false;
+          }
+        }
+      }
+      for ( size_t i = shard; i < connections; i += shards ) {
+        sockets[i].wait_until_closed();
+        bytes_written += sent[i];
+      }
+    } );
+  }
+  for ( auto& writer : writers ) {
+    writer.join();
+  }
+  const double seconds = timer.elapsed();
+
+  if ( bytes_written != connections * bytes_per_connection ) {
+    throw runtime_error( "sharded stacks did not run every connection to completion" );
+  }
+
+  SpeedResult result { .benchmark = benchmark,
+                       .parameters = { { "shards", shards }, { "connections", connections } },
+                       .seconds = seconds,
+                       .bytes = bytes_written };
+  result.extra["cores"] = static_cast<double>( thread::hardware_concurrency() );
+  result.extra["segments_steered"] = static_cast<double>( client.steered() + server.steered() );
+  result.report();
+}
+
+void program_body()
+{
+  many_connections( 10000 );
+
+  // Handshakes through the listener, without and during a SYN flood (which SYN cookies absorb)
+  handshakes( "stack_handshakes", 5000, TCPMinnowStack<LoopbackDevice>::DEFAULT_BACKLOG, 0 );
+  handshakes( "stack_handshakes_syn_flood", 5000, TCPMinnowStack<LoopbackDevice>::DEFAULT_BACKLOG, 20 );
+
+  // Bulk transfer over many connections at once, on 1, 2 and 4 shards (and with every segment handed over)
+  for ( const size_t shards : { 1, 2, 4 } ) {
+    sharded_throughput( "stack_sharded_throughput", shards, 16, 4 << 20, false );
+  }
+  sharded_throughput( "stack_sharded_crossed", 4, 16, 4 << 20, true );
+}
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,637 @@
+#include "memory_budget.hh"
+#include "tcp_fast_open.hh"
+#include "tcp_peer.hh"
+#include "tcp_speed_test.hh"
+
+#include <array>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+// Two TCPPeers wired back to back in memory: `client` sends `total_bytes` to `server`, then both close.
+// When the links are idle, simulated time advances 1 ms at a time so that lost segments get retransmitted.
+// The server is handed up to `gro_batch` segments at a time (see TCPPeer::receive_batch).
+void transfer( size_t window, size_t mss, double loss, size_t total_bytes, size_t gro_batch = 1 )
+{
+  TCPConfig client_cfg;
+  client_cfg.isn = Wrap32 { 1000 };
+  client_cfg.rt_timeout = 10;
+  client_cfg.send_capacity = window;
+  client_cfg.recv_capacity = window;
+  client_cfg.mss = mss;
+
+  TCPConfig server_cfg = client_cfg;
+  server_cfg.isn = Wrap32 { 2000 };
+
+  TCPPeer client { client_cfg };
+  TCPPeer server { server_cfg };
+  InMemoryLink client_to_server { loss, window + mss };
+  InMemoryLink server_to_client { loss, window * mss };
+
+  const string data = random_payload( window, mss );
+  uint64_t bytes_written = 0;
+  uint64_t bytes_read = 0;
+  uint64_t idle_ms = 0;
+
+  SpeedResult result {
+    .benchmark = "peer_transfer",
+    .parameters = { { "window", window }, { "mss", mss }, { "loss", loss }, { "gro_batch", gro_batch } } };
+
+  const SpeedTimer timer;
+  client.push( client_to_server.transmit() );
+  while ( client.active() or server.active() ) {
+    Writer& outbound = client.outbound_writer();
+    if ( bytes_written < total_bytes and outbound.available_capacity() > 0 ) {
+      const size_t len = min( { outbound.available_capacity(), data.size(), total_bytes - bytes_written } );
+      outbound.push( data.substr( 0, len ) );
+      bytes_written += len;
+      if ( bytes_written == total_bytes ) {
+        outbound.close();
+      }
+      client.push( client_to_server.transmit() );
+    }
+
+    if ( gro_batch > 1 ) {
+      client_to_server.deliver_batch( server, server_to_client, gro_batch );
+    } else {
+      client_to_server.deliver( server, server_to_client );
+    }
+    server_to_client.deliver( client, client_to_server );
+
+    Reader& inbound = server.inbound_reader();
+    if ( inbound.bytes_buffered() ) {
+      bytes_read += inbound.bytes_buffered();
+      inbound.pop( inbound.bytes_buffered() );
+      server.send_window_update( server_to_client.transmit() );
+    }
+    if ( inbound.is_finished() and not server.outbound_writer().is_closed() ) {
+      server.outbound_writer().close();
+      server.push( server_to_client.transmit() );
+    }
+
+    if ( client_to_server.empty() and server_to_client.empty() ) {
+      client.tick( 1, client_to_server.transmit() );
+      server.tick( 1, server_to_client.transmit() );
+      ++idle_ms;
+    }
+  }
+  result.seconds = timer.elapsed();
+
+  if ( bytes_read != total_bytes or not server.inbound_reader().is_finished() ) {
+    throw runtime_error( "TCPPeer pair did not deliver the whole stream" );
+  }
+
+  result.segments = client_to_server.segments_sent;
+  result.bytes = bytes_read;
+  result.acks = server_to_client.segments_sent;
+  result.extra["segments_dropped"] = static_cast<double>( client_to_server.segments_dropped );
+  result.extra["simulated_idle_ms"] = static_cast<double>( idle_ms );
+  result.extra["fast_path_hit_rate"] = static_cast<double>( client.fast_path_hits() + server.fast_path_hits() )
+                                       / static_cast<double>( client.segments_received() + server.segments_received() );
+  result.report();
+}
+
+// Two TCPPeers 5 ms apart: the client's application makes many small writes, either as an interactive pattern
+// (a three-write request every millisecond, for two seconds) or as bulk data (forty 100-byte writes every
+// millisecond, until 1 MiB). Measures how many segments the client sends per kilobyte, and how long (in
+// simulated time) the whole stream takes to arrive, with a given client configuration and random loss.
+void small_writes( const string& benchmark, TCPConfig client_cfg, bool cork, bool bulk, double loss = 0 )
+{
+  client_cfg.isn = Wrap32 { 1000 };
+  client_cfg.rt_timeout = 100;
+
+  TCPConfig server_cfg = client_cfg;
+  server_cfg.isn = Wrap32 { 2000 };
+
+  TCPPeer client { client_cfg };
+  TCPPeer server { server_cfg };
+  static constexpr uint64_t one_way_delay_ms = 5;
+  InMemoryLink client_to_server { loss, 1, one_way_delay_ms };
+  InMemoryLink server_to_client { loss, 2, one_way_delay_ms };
+
+  static constexpr uint64_t interactive_ms = 2000;
+  static constexpr size_t bulk_bytes = 1 << 20;
+  static constexpr size_t bulk_write = 100;
+  static constexpr size_t bulk_writes_per_ms = 40; // a little below what the window allows per round trip
+  const array<string, 3> request { "GET /item/00000 ", "HTTP/1.1 Host: x", "\r\n" };
+  const string chunk( bulk_write, 'x' );
+
+  uint64_t bytes_read = 0;
+  uint64_t now_ms = 0;
+  uint64_t completion_ms = 0;
+
+  SpeedResult result { .benchmark = benchmark,
+                       .parameters = { { "one_way_delay_ms", one_way_delay_ms }, { "loss", loss } } };
+
+  const SpeedTimer timer;
+  client.push( client_to_server.transmit() );
+  if ( cork ) {
+    client.set_cork( true );
+  }
+  while ( client.active() or server.active() ) {
+    Writer& outbound = client.outbound_writer();
+    if ( not bulk and not outbound.is_closed() ) {
+      for ( const auto& piece : request ) {
+        outbound.push( piece );
+        client.push( client_to_server.transmit() );
+      }
+      if ( cork ) {
+        client.set_cork( false );
+        client.push( client_to_server.transmit() );
+        client.set_cork( true );
+      }
+      if ( now_ms + 1 == interactive_ms ) {
+        outbound.close();
+        client.push( client_to_server.transmit() );
+      }
+    }
+    for ( size_t i = 0; bulk and i < bulk_writes_per_ms and not outbound.is_closed(); ++i ) {
+      const size_t len = min( { bulk_write, outbound.available_capacity(), bulk_bytes - outbound.bytes_pushed() } );
+      outbound.push( chunk.substr( 0, len ) );
+      if ( outbound.bytes_pushed() == bulk_bytes ) {
+        outbound.close();
+      }
+      client.push( client_to_server.transmit() );
+    }
+
+    client_to_server.deliver( server, server_to_client );
+    server_to_client.deliver( client, client_to_server );
+
+    Reader& inbound = server.inbound_reader();
+    if ( inbound.bytes_buffered() ) {
+      bytes_read += inbound.bytes_buffered();
+      inbound.pop( inbound.bytes_buffered() );
+      server.send_window_update( server_to_client.transmit() );
+    }
+    if ( inbound.is_finished() and not server.outbound_writer().is_closed() ) {
+      server.outbound_writer().close();
+      server.push( server_to_client.transmit() );
+      completion_ms = now_ms;
+    }
+
+    client.tick( 1, client_to_server.transmit() );
+    server.tick( 1, server_to_client.transmit() );
+    client_to_server.advance( 1 );
+    server_to_client.advance( 1 );
+    ++now_ms;
+  }
+  result.seconds = timer.elapsed();
+
+  if ( not server.inbound_reader().is_finished() ) {
+    throw runtime_error( "TCPPeer pair did not deliver the whole stream" );
+  }
+
+  result.segments = client_to_server.segments_sent;
+  result.bytes = bytes_read;
+  result.acks = server_to_client.segments_sent;
+  result.extra["packets_per_kb"] = static_cast<double>( result.segments ) * 1024 / static_cast<double>( bytes_read );
+  result.extra["completion_ms"] = static_cast<double>( completion_ms );
+  result.report();
+}
+
+// Two TCPPeers `one_way_delay_ms` apart: the client writes `total_bytes` as fast as the window allows, and the
+// server's application reads everything as soon as it arrives (or only `read_per_ms` bytes each millisecond).
+// Measures how many packets the receiving side sends per megabyte received (pure ACKs and window updates), how
+// long the stream takes to arrive, how far the buffers grew and how full the data segments were, with a given
+// configuration of both peers (ACK delay, buffer capacities and ceilings, SWS avoidance).
+void bulk_receive( const string& benchmark,
+                   TCPConfig client_cfg,
+                   uint64_t one_way_delay_ms,
+                   size_t total_bytes,
+                   uint64_t read_per_ms = UINT64_MAX )
+{
+  client_cfg.isn = Wrap32 { 1000 };
+  client_cfg.rt_timeout = 100;
+
+  TCPConfig server_cfg = client_cfg;
+  server_cfg.isn = Wrap32 { 2000 };
+
+  TCPPeer client { client_cfg };
+  TCPPeer server { server_cfg };
+  InMemoryLink client_to_server { 0, 1, one_way_delay_ms };
+  InMemoryLink server_to_client { 0, 2, one_way_delay_ms };
+
+  const string data = random_payload( client_cfg.send_capacity, 1 );
+
+  uint64_t bytes_read = 0;
+  uint64_t now_ms = 0;
+  uint64_t completion_ms = 0;
+  uint64_t peak_send_capacity = 0;
+  uint64_t peak_recv_capacity = 0;
+
+  SpeedResult result { .benchmark = benchmark,
+                       .parameters = { { "one_way_delay_ms", one_way_delay_ms },
+                                       { "ack_delay", client_cfg.ack_delay },
+                                       { "recv_capacity", client_cfg.recv_capacity },
+                                       { "recv_capacity_max", client_cfg.recv_capacity_max },
+                                       { "read_per_ms", static_cast<double>( read_per_ms ) } } };
+
+  const SpeedTimer timer;
+  client.push( client_to_server.transmit() );
+  while ( client.active() or server.active() ) {
+    Writer& outbound = client.outbound_writer();
+    if ( not outbound.is_closed() and outbound.available_capacity() > 0 ) {
+      outbound.push( data.substr( 0, min( outbound.available_capacity(), total_bytes - outbound.bytes_pushed() ) ) );
+      if ( outbound.bytes_pushed() == total_bytes ) {
+        outbound.close();
+      }
+      client.push( client_to_server.transmit() );
+    }
+
+    client_to_server.deliver( server, server_to_client );
+    server_to_client.deliver( client, client_to_server );
+
+    Reader& inbound = server.inbound_reader();
+    if ( inbound.bytes_buffered() ) {
+      const uint64_t len = min( inbound.bytes_buffered(), read_per_ms );
+      bytes_read += len;
+      inbound.pop( len );
+      server.send_window_update( server_to_client.transmit() );
+    }
+    if ( inbound.is_finished() and not server.outbound_writer().is_closed() ) {
+      server.outbound_writer().close();
+      server.push( server_to_client.transmit() );
+      completion_ms = now_ms;
+    }
+    peak_send_capacity = max( peak_send_capacity, outbound.capacity() );
+    peak_recv_capacity = max( peak_recv_capacity, inbound.capacity() );
+
+    client.tick( 1, client_to_server.transmit() );
+    server.tick( 1, server_to_client.transmit() );
+    client_to_server.advance( 1 );
+    server_to_client.advance( 1 );
+    ++now_ms;
+  }
+  result.seconds = timer.elapsed();
+
+  if ( bytes_read != total_bytes or not server.inbound_reader().is_finished() ) {
+    throw runtime_error( "TCPPeer pair did not deliver the whole stream" );
+  }
+
+  const double megabytes = static_cast<double>( bytes_read ) / ( 1 << 20 );
+  result.segments = client_to_server.segments_sent;
+  result.bytes = bytes_read;
+  result.acks = server_to_client.segments_sent;
+  result.extra["receiver_packets_per_mb"] = static_cast<double>( server_to_client.segments_sent ) / megabytes;
+  result.extra["packets_per_mb"]
+    = static_cast<double>( client_to_server.segments_sent + server_to_client.segments_sent ) / megabytes;
+  result.extra["completion_ms"] = static_cast<double>( completion_ms );
+  result.extra["peak_send_capacity"] = static_cast<double>( peak_send_capacity );
+  result.extra["peak_recv_capacity"] = static_cast<double>( peak_recv_capacity );
+  result.extra["average_segment_size"] = static_cast<double>( bytes_read ) / client_to_server.segments_sent;
+  result.report();
+}
+
+// A client fetches a 1 KB response from a server `one_way_delay_ms` away, `fetches` times over, each time on a new
+// connection: it writes a short request and closes its stream, and the server's application answers once the
+// request is complete. Measures how long each fetch takes, from the client's SYN to the end of the response.
+// With Fast Open, the first connection asks the server for a cookie, which the client keeps in its cache and
+// presents on the next ones, so that the request rides on the SYN.
+void fetch( const string& benchmark, bool fast_open, uint64_t one_way_delay_ms, size_t fetches )
+{
+  const Address client_address { "169.254.144.9", 9000 };
+  const Address server_address { "169.254.144.1", 9001 };
+  const FastOpenCookieGenerator cookies;
+  FastOpenCookieCache cache;
+
+  const string request = "GET /index.html HTTP/1.0\r\n\r\n";
+  const string response = random_payload( 1024, 1 );
+  uint64_t first_fetch_ms = 0;
+  uint64_t total_ms = 0;
+  uint64_t segments = 0;
+
+  const SpeedTimer timer;
+  for ( size_t i = 0; i < fetches; ++i ) {
+    TCPConfig client_cfg;
+    client_cfg.isn = Wrap32 { 1000 };
+    client_cfg.rt_timeout = 100;
+    TCPConfig server_cfg = client_cfg;
+    server_cfg.isn = Wrap32 { 2000 };
+
+    TCPPeer client { client_cfg };
+    TCPPeer server { server_cfg };
+    InMemoryLink client_to_server { 0, 1, one_way_delay_ms };
+    InMemoryLink server_to_client { 0, 2, one_way_delay_ms };
+    if ( fast_open ) {
+      client.set_fast_open( cache.get( server_address ).value_or( "" ) );
+      server.accept_fast_open( cookies.cookie( client_address ) );
+    }
+
+    client.outbound_writer().push( request );
+    client.outbound_writer().close();
+    client.push( client_to_server.transmit() );
+
+    uint64_t now_ms = 0;
+    uint64_t bytes_read = 0;
+    while ( not client.inbound_reader().is_finished() ) {
+      if ( not client.active() and not server.active() ) {
+        throw runtime_error( "TCPPeer pair did not complete the fetch" );
+      }
+      client_to_server.deliver( server, server_to_client );
+      server_to_client.deliver( client, client_to_server );
+
+      Reader& request_stream = server.inbound_reader();
+      request_stream.pop( request_stream.bytes_buffered() );
+      if ( request_stream.is_finished() and not server.outbound_writer().is_closed() ) {
+        server.outbound_writer().push( response );
+        server.outbound_writer().close();
+        server.push( server_to_client.transmit() );
+      }
+      Reader& response_stream = client.inbound_reader();
+      bytes_read += response_stream.bytes_buffered();
+      response_stream.pop( response_stream.bytes_buffered() );
+      if ( response_stream.is_finished() ) {
+        break;
+      }
+
+      client.tick( 1, client_to_server.transmit() );
+      server.tick( 1, server_to_client.transmit() );
+      client_to_server.advance( 1 );
+      server_to_client.advance( 1 );
+      ++now_ms;
+    }
+
+    if ( bytes_read != response.size() ) {
+      throw runtime_error( "TCPPeer pair did not deliver the whole response" );
+    }
+    if ( client.fast_open_cookie().has_value() ) {
+      cache.put( server_address, client.fast_open_cookie().value() );
+    }
+    ( i == 0 ? first_fetch_ms : total_ms ) += now_ms;
+    segments += client_to_server.segments_sent + server_to_client.segments_sent;
+  }
+
+  SpeedResult result { .benchmark = benchmark,
+                       .parameters = { { "one_way_delay_ms", one_way_delay_ms }, { "fetches", fetches } },
+                       .seconds = timer.elapsed(),
+                       .segments = segments,
+                       .bytes = fetches * response.size() };
+  result.extra["first_fetch_ms"] = static_cast<double>( first_fetch_ms );
+  result.extra["completion_ms"] = static_cast<double>( total_ms ) / static_cast<double>( fetches - 1 );
+  result.report();
+}
+
+// Bursty fan-in: `senders` clients each write `bytes_each` as fast as their windows allow to one server process
+// (`senders` server-side TCPPeers, 5 ms away), whose application reads only `read_per_ms` bytes each millisecond
+// in all, spread over the connections. Both sides share the process's MemoryBudget, with the given limits (0:
+// none). Measures the most memory the stream buffers held at once, and how long the transfers took.
+void fan_in( const string& benchmark,
+             size_t senders,
+             size_t bytes_each,
+             uint64_t read_per_ms,
+             uint64_t soft,
+             uint64_t hard )
+{
+  constexpr uint64_t one_way_delay_ms = 5;
+  TCPConfig cfg;
+  cfg.rt_timeout = 100;
+  const string data = random_payload( cfg.send_capacity, 1 );
+
+  MemoryBudget& budget = MemoryBudget::process();
+  budget.set_limits( soft, hard );
+  budget.reset_peak();
+  const uint64_t usage_before = budget.usage();
+
+  vector<TCPPeer> clients;
+  vector<TCPPeer> servers;
+  vector<InMemoryLink> to_server;
+  vector<InMemoryLink> to_client;
+  for ( size_t i = 0; i < senders; i++ ) {
+    clients.emplace_back( cfg );
+    servers.emplace_back( cfg );
+    to_server.emplace_back( 0, 2 * i, one_way_delay_ms );
+    to_client.emplace_back( 0, 2 * i + 1, one_way_delay_ms );
+  }
+
+  const SpeedTimer timer;
+  uint64_t bytes_read = 0;
+  uint64_t now_ms = 0;
+  size_t next_reader = 0;
+  while ( bytes_read < senders * bytes_each ) {
+    for ( size_t i = 0; i < senders; i++ ) {
+      Writer& outbound = clients[i].outbound_writer();
+      if ( outbound.bytes_pushed() < bytes_each and outbound.available_capacity() > 0 ) {
+        outbound.push( data.substr( 0, min( outbound.available_capacity(), bytes_each - outbound.bytes_pushed() ) ) );
+      }
+      clients[i].push( to_server[i].transmit() );
+      to_server[i].deliver( servers[i], to_client[i] );
+      to_client[i].deliver( clients[i], to_server[i] );
+    }
+
+    // The server's application reads round-robin, as much as it has time for.
+    uint64_t time_left = read_per_ms;
+    for ( size_t n = 0; n < senders and time_left > 0; n++, next_reader = ( next_reader + 1 ) % senders ) {
+      Reader& inbound = servers[next_reader].inbound_reader();
+      const uint64_t len = min( inbound.bytes_buffered(), time_left );
+      if ( len > 0 ) {
+        inbound.pop( len );
+        bytes_read += len;
+        time_left -= len;
+        servers[next_reader].send_window_update( to_client[next_reader].transmit() );
+      }
+    }
+
+    for ( size_t i = 0; i < senders; i++ ) {
+      clients[i].tick( 1, to_server[i].transmit() );
+      servers[i].tick( 1, to_client[i].transmit() );
+      to_server[i].advance( 1 );
+      to_client[i].advance( 1 );
+    }
+    if ( ++now_ms > 600000 ) {
+      throw runtime_error( "fan-in did not complete" );
+    }
+  }
+  const double seconds = timer.elapsed();
+  const uint64_t peak = budget.peak() - usage_before;
+  budget.set_limits( 0, 0 );
+
+  uint64_t segments = 0;
+  for ( const auto& link : to_server ) {
+    segments += link.segments_sent;
+  }
+  SpeedResult result { .benchmark = benchmark,
+                       .parameters = { { "senders", senders },
+                                       { "bytes_each", bytes_each },
+                                       { "read_per_ms", read_per_ms },
+                                       { "soft_limit", soft },
+                                       { "hard_limit", hard } },
+                       .seconds = seconds,
+                       .segments = segments,
+                       .bytes = bytes_read };
+  result.extra["peak_buffer_bytes"] = static_cast<double>( peak );
+  result.extra["completion_ms"] = static_cast<double>( now_ms );
+  result.report();
+}
+
+// `connections` pairs of TCPPeers each exchange a request and a response of `message_size` bytes, then go quiet
+// for longer than TCPConfig::BUFFER_RELEASE_TIMEOUT. Measures the memory each peer uses (TCPPeer::memory_usage())
+// once established, right after the exchange, and once idle: the stream buffers are allocated only while they
+// hold bytes, so an idle connection costs little more than the TCPPeer object itself.
+void idle_memory( size_t connections, size_t message_size )
+{
+  TCPConfig cfg;
+  cfg.rt_timeout = 100;
+  cfg.coalescing = TCPCoalescing::NoDelay; // (each message goes out whole at once)
+  const string message = random_payload( message_size, 1 );
+
+  vector<TCPPeer> clients;
+  vector<TCPPeer> servers;
+  clients.reserve( connections );
+  servers.reserve( connections );
+  InMemoryLink to_server { 0, 1 };
+  InMemoryLink to_client { 0, 2 };
+  const auto memory = [&] {
+    uint64_t total = 0;
+    for ( size_t i = 0; i < connections; i++ ) {
+      total += clients[i].memory_usage() + servers[i].memory_usage();
+    }
+    return static_cast<double>( total ) / static_cast<double>( 2 * connections );
+  };
+
+  const SpeedTimer timer;
+  for ( size_t i = 0; i < connections; i++ ) {
+    TCPPeer& client = clients.emplace_back( cfg );
+    TCPPeer& server = servers.emplace_back( cfg );
+    client.push( to_server.transmit() );
+    to_server.deliver( server, to_client );
+    to_client.deliver( client, to_server );
+    to_server.deliver( server, to_client );
+  }
+  const double established = memory();
+
+  uint64_t bytes_read = 0;
+  string buffer;
+  for ( size_t i = 0; i < connections; i++ ) {
+    clients[i].outbound_writer().push( message );
+    clients[i].push( to_server.transmit() );
+    to_server.deliver( servers[i], to_client );
+    read( servers[i].inbound_reader(), message_size, buffer );
+    servers[i].outbound_writer().push( buffer );
+    servers[i].push( to_client.transmit() );
+    to_client.deliver( clients[i], to_server );
+    read( clients[i].inbound_reader(), message_size, buffer );
+    bytes_read += buffer.size();
+    to_server.deliver( servers[i], to_client );
+  }
+  const double after_exchange = memory();
+
+  // (The clients' delayed ACKs of the responses go out on their first tick.)
+  for ( size_t i = 0; i < connections; i++ ) {
+    clients[i].tick( TCPConfig::BUFFER_RELEASE_TIMEOUT, to_server.transmit() );
+    to_server.deliver( servers[i], to_client );
+    servers[i].tick( TCPConfig::BUFFER_RELEASE_TIMEOUT, to_client.transmit() );
+  }
+  const double idle = memory();
+  const double seconds = timer.elapsed();
+
+  if ( bytes_read != connections * message_size ) {
+    throw runtime_error( "TCPPeer pairs did not exchange their messages" );
+  }
+
+  SpeedResult result { .benchmark = "idle_memory",
+                       .parameters = { { "connections", connections }, { "message_size", message_size } },
+                       .seconds = seconds,
+                       .bytes = bytes_read };
+  result.extra["sizeof_peer"] = static_cast<double>( sizeof( TCPPeer ) );
+  result.extra["established_bytes_per_peer"] = established;
+  result.extra["after_exchange_bytes_per_peer"] = after_exchange;
+  result.extra["idle_bytes_per_peer"] = idle;
+  result.report();
+}
+
+void program_body()
+{
+  for ( const size_t window : { 4000, 16000, 64000 } ) {
+    for ( const size_t mss : { 536, 1000, 1460 } ) {
+      transfer( window, mss, 0, 1 << 25 );
+    }
+  }
+
+  for ( const double loss : { 0.001, 0.01, 0.05 } ) {
+    transfer( 64000, 1000, loss, 1 << 22 );
+  }
+
+  // Receive-side coalescing of bursts of up to 16 segments
+  for ( const size_t mss : { 536, 1000, 1460 } ) {
+    transfer( 64000, mss, 0, 1 << 25, 16 );
+  }
+
+  const auto with = []( TCPCoalescing coalescing, bool repacketize ) {
+    TCPConfig cfg;
+    cfg.coalescing = coalescing;
+    cfg.repacketize = repacketize;
+    return cfg;
+  };
+
+  for ( const bool bulk : { false, true } ) {
+    const string pattern = bulk ? "bulk_" : "interactive_";
+    small_writes( "coalescing_" + pattern + "nodelay", with( TCPCoalescing::NoDelay, true ), false, bulk );
+    small_writes( "coalescing_" + pattern + "nagle", with( TCPCoalescing::Nagle, true ), false, bulk );
+    small_writes( "coalescing_" + pattern + "autocork", with( TCPCoalescing::Autocork, true ), false, bulk );
+    small_writes( "coalescing_" + pattern + "cork", with( TCPCoalescing::NoDelay, true ), true, bulk );
+  }
+
+  // Recovering a lossy stream of small unmerged segments, retransmitting just the oldest vs. repacketizing
+  for ( const bool repacketize : { false, true } ) {
+    small_writes( string( "recovery_interactive_" ) + ( repacketize ? "repacketize" : "oldest_only" ),
+                  with( TCPCoalescing::NoDelay, repacketize ),
+                  false,
+                  false,
+                  0.05 );
+  }
+
+  // ACKing every segment vs. delayed ACK
+  TCPConfig ack_every_segment;
+  ack_every_segment.ack_delay = 0;
+  bulk_receive( "ack_every_segment", ack_every_segment, 5, 1 << 24 );
+  bulk_receive( "ack_delayed", TCPConfig {}, 5, 1 << 24 );
+
+  // A long path with small fixed buffers vs. the same buffers autotuned up to the largest window TCP can offer
+  for ( const bool autotune : { false, true } ) {
+    TCPConfig cfg;
+    cfg.recv_capacity = 8000;
+    cfg.send_capacity = 8000;
+    if ( autotune ) {
+      cfg.recv_capacity_max = UINT16_MAX;
+      cfg.send_capacity_max = TCPConfig::SEND_BUFFER_FACTOR * UINT16_MAX;
+    }
+    bulk_receive( autotune ? "buffers_autotuned" : "buffers_fixed", cfg, 50, 1 << 22 );
+  }
+
+  // An application that reads slowly, with and without silly window syndrome avoidance
+  for ( const bool sws_avoidance : { false, true } ) {
+    TCPConfig cfg;
+    cfg.sws_avoidance = sws_avoidance;
+    bulk_receive( sws_avoidance ? "slow_reader_sws_avoidance" : "slow_reader_no_sws_avoidance", cfg, 5, 1 << 18, 10 );
+  }
+
+  // Short fetches on new connections, with and without TCP Fast Open
+  fetch( "fetch_1k", false, 5, 100 );
+  fetch( "fetch_1k_fast_open", true, 5, 100 );
+
+  // What an established connection costs in memory: busy, and after going idle
+  idle_memory( 10000, 4096 );
+
+  // Many senders bursting into one slowly-reading process, with no memory budget and with one (like tcp_mem)
+  fan_in( "fan_in_unlimited", 200, 1 << 17, 1 << 15, 0, 0 );
+  fan_in( "fan_in_budget", 200, 1 << 17, 1 << 15, 2 << 20, 4 << 20 );
+}
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
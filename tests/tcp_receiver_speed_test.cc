@@ -0,0 +1,99 @@
+#include "tcp_receiver.hh"
+#include "tcp_speed_test.hh"
+
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+namespace {
+constexpr size_t TOTAL_BYTES = 1 << 25;
+
+// Receive a stream one window at a time in `mss`-sized segments, replying with send() after each one.
+// With `loss` > 0, that fraction of each window's segments arrives late (after the rest of the window).
+void receive_and_send( uint16_t window, size_t mss, double loss )
+{
+  const Wrap32 isn { 1234 };
+  TCPReceiver receiver { Reassembler { ByteStream { window } } };
+  const string data = random_payload( window, window + mss );
+
+  default_random_engine rd { mss };
+  bernoulli_distribution late { loss };
+  vector<TCPSenderMessage> held_back;
+  uint64_t index = 0;
+  uint64_t acks_sent = 0;
+  uint64_t ackno_sum = 0; // consumed so that send() can't be optimized away
+
+  receiver.receive( { .seqno = isn, .SYN = true } );
+
+  SpeedResult result { .benchmark = "receiver_receive_send",
+                       .parameters = { { "window", window }, { "mss", mss }, { "loss", loss } } };
+
+  const SpeedTimer timer;
+  while ( index < TOTAL_BYTES ) {
+    for ( size_t offset = 0; offset < data.size(); offset += mss ) {
+      TCPSenderMessage msg { .seqno = Wrap32::wrap( index + offset + 1, isn ),
+                             .payload = data.substr( offset, mss ) };
+      if ( late( rd ) ) {
+        held_back.push_back( move( msg ) );
+        continue;
+      }
+      receiver.receive( move( msg ) );
+      ackno_sum += receiver.send().ackno.value_or( isn ).unwrap( isn, index );
+      ++acks_sent;
+      ++result.segments;
+    }
+    for ( auto& msg : held_back ) {
+      receiver.receive( move( msg ) );
+      ackno_sum += receiver.send().ackno.value_or( isn ).unwrap( isn, index );
+      ++acks_sent;
+      ++result.segments;
+    }
+    held_back.clear();
+
+    index += data.size();
+    if ( receiver.reader().bytes_buffered() != data.size() ) {
+      throw runtime_error( "TCPReceiver did not reassemble a full window" );
+    }
+    receiver.reader().pop( data.size() );
+  }
+  result.seconds = timer.elapsed();
+  result.bytes = index;
+  result.extra["acks_sent"] = static_cast<double>( acks_sent );
+
+  if ( ackno_sum == 0 ) {
+    throw runtime_error( "TCPReceiver never acknowledged anything" );
+  }
+
+  result.report();
+}
+
+void program_body()
+{
+  for ( const uint16_t window : { 4000, 16000, 64000 } ) {
+    for ( const size_t mss : { 536, 1000, 1460 } ) {
+      receive_and_send( window, mss, 0 );
+    }
+  }
+
+  for ( const double loss : { 0.01, 0.1 } ) {
+    receive_and_send( 64000, 1000, loss );
+  }
+}
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
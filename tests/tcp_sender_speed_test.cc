@@ -0,0 +1,212 @@
+#include "tcp_over_ip.hh"
+#include "tcp_sender.hh"
+#include "tcp_speed_test.hh"
+
+#include <array>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+namespace {
+constexpr size_t TOTAL_BYTES = 1 << 25;
+
+// Fill the window with push(), then acknowledge each segment individually with receive()
+void push_and_ack( uint16_t window, size_t mss )
+{
+  const TCPConfig cfg;
+  TCPSender sender { ByteStream { cfg.send_capacity }, cfg.isn, cfg.rt_timeout, mss };
+  const string data = random_payload( cfg.send_capacity, window + mss );
+
+  array<TCPSenderMessage, 16> outbox {};
+  vector<uint64_t> segment_ends; // absolute seqno just past each segment sent this round
+  uint64_t next_seqno = 0;
+  uint64_t bytes_sent = 0;
+  double push_seconds = 0;
+
+  SpeedResult result { .benchmark = "sender_push_receive",
+                       .parameters = { { "window", window }, { "mss", mss } } };
+
+  // handshake
+  sender.push( outbox );
+  next_seqno = 1;
+  sender.receive( { .ackno = cfg.isn + 1, .window_size = window } );
+
+  const SpeedTimer total;
+  while ( bytes_sent < TOTAL_BYTES ) {
+    if ( sender.writer().available_capacity() > data.size() / 2 ) {
+      sender.writer().push( data.substr( 0, sender.writer().available_capacity() ) );
+    }
+
+    const SpeedTimer push_timer;
+    segment_ends.clear();
+    size_t count {};
+    do {
+      count = sender.push( outbox );
+      for ( const auto& msg : span { outbox }.first( count ) ) {
+        next_seqno += msg.sequence_length();
+        bytes_sent += msg.payload.size();
+        segment_ends.push_back( next_seqno );
+      }
+    } while ( count == outbox.size() );
+    push_seconds += push_timer.elapsed();
+
+    if ( segment_ends.empty() ) {
+      throw runtime_error( "TCPSender did not fill an open window" );
+    }
+    result.segments += segment_ends.size();
+
+    const SpeedTimer ack_timer;
+    for ( const auto end : segment_ends ) {
+      sender.receive( { .ackno = Wrap32::wrap( end, cfg.isn ), .window_size = window } );
+    }
+    result.ack_seconds += ack_timer.elapsed();
+    result.acks += segment_ends.size();
+  }
+  result.seconds = total.elapsed();
+  result.bytes = bytes_sent;
+  result.extra["push_ns_per_segment"] = push_seconds * 1e9 / static_cast<double>( result.segments );
+
+  if ( sender.sequence_numbers_in_flight() != 0 ) {
+    throw runtime_error( "TCPSender still has sequence numbers in flight after every segment was acknowledged" );
+  }
+
+  result.report();
+}
+
+// Push through TCPSender and then the adapter's segmentation stage, which serializes the headers (with both
+// checksums) of every wire datagram; the datagrams themselves go nowhere. With segmentation offload, the
+// sender builds and tracks one super-segment per window instead of one segment per MSS.
+void push_and_segment( size_t offload_size )
+{
+  const TCPConfig cfg;
+  constexpr uint16_t window = 64000;
+  TCPSender sender { ByteStream { cfg.send_capacity }, cfg.isn, cfg.rt_timeout, cfg.mss };
+  sender.set_offload_size( offload_size );
+  TCPOverIPv4Adapter adapter;
+  adapter.config_mut().mss = cfg.mss;
+  const string data = random_payload( cfg.send_capacity, offload_size );
+
+  array<TCPSenderMessage, 16> outbox {};
+  const TCPReceiverMessage receiver_message { .ackno = Wrap32 { 0 }, .window_size = 1 };
+  string headers;
+  uint64_t next_seqno = 0;
+  uint64_t datagrams = 0;
+  uint64_t bytes_sent = 0;
+  uint64_t acks = 0;
+
+  sender.push( outbox );
+  next_seqno = 1;
+  sender.receive( { .ackno = cfg.isn + 1, .window_size = window } );
+
+  const SpeedTimer timer;
+  while ( bytes_sent < TOTAL_BYTES ) {
+    if ( sender.writer().available_capacity() > data.size() / 2 ) {
+      sender.writer().push( data.substr( 0, sender.writer().available_capacity() ) );
+    }
+
+    size_t count {};
+    do {
+      count = sender.push( outbox );
+      for ( const auto& msg : span { outbox }.first( count ) ) {
+        next_seqno += msg.sequence_length();
+        bytes_sent += msg.payload.size();
+        adapter.segment_tcp_in_ip( { .sender = Ref<TCPSenderMessage>::borrow( msg ),
+                                     .receiver = Ref<TCPReceiverMessage>::borrow( receiver_message ) },
+                                   headers,
+                                   [&]( string_view /*headers*/, string_view /*payload*/ ) { ++datagrams; } );
+      }
+    } while ( count == outbox.size() );
+
+    sender.receive( { .ackno = Wrap32::wrap( next_seqno, cfg.isn ), .window_size = window } );
+    ++acks;
+  }
+
+  SpeedResult result { .benchmark = "sender_segmentation_offload",
+                       .parameters = { { "offload_size", offload_size }, { "mss", cfg.mss } },
+                       .seconds = timer.elapsed(),
+                       .segments = datagrams,
+                       .bytes = bytes_sent,
+                       .acks = acks };
+  result.report();
+}
+
+// With a full window outstanding, measure tick(), including expiry and retransmission every `rto` ms
+void tick( uint16_t window, uint64_t rto )
+{
+  TCPConfig cfg;
+  cfg.rt_timeout = rto;
+  TCPSender sender { ByteStream { cfg.send_capacity }, cfg.isn, cfg.rt_timeout };
+  const string data = random_payload( cfg.mss, rto );
+
+  uint64_t retransmissions = 0;
+  uint64_t retransmitted_bytes = 0;
+  const auto count_retransmission = [&]( const TCPSenderMessage& msg ) {
+    ++retransmissions;
+    retransmitted_bytes += msg.payload.size();
+  };
+  const auto ignore = []( const TCPSenderMessage& /*unused*/ ) {};
+
+  sender.push( ignore );
+  sender.receive( { .ackno = cfg.isn + 1, .window_size = window } );
+  while ( sender.writer().bytes_pushed() < window ) {
+    sender.writer().push( data );
+  }
+  sender.push( ignore );
+
+  constexpr uint64_t ticks = 1 << 24;
+  uint64_t acked = 1;
+  const SpeedTimer timer;
+  for ( uint64_t i = 0; i < ticks; ++i ) {
+    const uint64_t before = retransmissions;
+    sender.tick( 1, count_retransmission );
+    if ( retransmissions != before ) {
+      // The retransmitted segment gets through: its ACK restarts the timer and opens room for one more.
+      acked += cfg.mss;
+      sender.receive( { .ackno = Wrap32::wrap( acked, cfg.isn ), .window_size = window } );
+      sender.writer().push( data );
+      sender.push( ignore );
+    }
+  }
+
+  SpeedResult result { .benchmark = "sender_tick",
+                       .parameters = { { "window", window }, { "rto", rto } },
+                       .seconds = timer.elapsed(),
+                       .segments = retransmissions,
+                       .bytes = retransmitted_bytes };
+  result.extra["ns_per_tick"] = result.seconds * 1e9 / ticks;
+  result.report();
+}
+
+void program_body()
+{
+  for ( const uint16_t window : { 4000, 16000, 64000 } ) {
+    for ( const size_t mss : { 536, 1000, 1460 } ) {
+      push_and_ack( window, mss );
+    }
+  }
+
+  for ( const size_t offload_size : { 0, 16000, 64000 } ) {
+    push_and_segment( offload_size );
+  }
+
+  tick( 16000, 1000 );
+  tick( 16000, 10 );
+}
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
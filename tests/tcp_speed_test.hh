@@ -0,0 +1,172 @@
+#pragma once
+
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One measurement from a protocol-engine speed test.
+//
+// Each result is printed to stdout as a single JSON object on its own line (so runs can be collected and
+// compared by a script), and as a human-readable summary on the terminal, like the other speed tests.
+struct SpeedResult
+{
+  std::string benchmark;                    // which engine and operation was measured
+  std::map<std::string, double> parameters; // e.g. window, mss, loss
+  double seconds {};                        // wall-clock duration of the timed section
+  uint64_t segments {};                     // segments processed (sent or received)
+  uint64_t bytes {};                        // payload bytes delivered
+  uint64_t acks {};                         // acknowledgments processed by a TCPSender
+  double ack_seconds {};                    // time spent processing those ACKs (if zero, the whole run)
+  std::map<std::string, double> extra {};   // additional benchmark-specific counters
+
+  double segments_per_second() const { return static_cast<double>( segments ) / seconds; }
+  double bytes_per_second() const { return static_cast<double>( bytes ) / seconds; }
+  double ns_per_ack() const
+  {
+    return acks ? ( ack_seconds > 0 ? ack_seconds : seconds ) * 1e9 / static_cast<double>( acks ) : 0;
+  }
+
+  std::string json() const
+  {
+    std::ostringstream out;
+    out << std::setprecision( 6 ) << R"({"benchmark":")" << benchmark << '"';
+    for ( const auto& [name, value] : parameters ) {
+      out << ",\"" << name << "\":" << value;
+    }
+    out << ",\"seconds\":" << seconds << ",\"segments\":" << segments << ",\"bytes\":" << bytes
+        << ",\"acks\":" << acks << ",\"segments_per_second\":" << segments_per_second()
+        << ",\"bytes_per_second\":" << bytes_per_second() << ",\"ns_per_ack\":" << ns_per_ack();
+    for ( const auto& [name, value] : extra ) {
+      out << ",\"" << name << "\":" << value;
+    }
+    out << "}";
+    return out.str();
+  }
+
+  void report() const
+  {
+    std::cout << json() << "\n";
+
+    std::fstream debug_output;
+    debug_output.open( "/dev/tty" );
+    debug_output << "        " << std::left << std::setw( 24 ) << benchmark << std::right;
+    for ( const auto& [name, value] : parameters ) {
+      debug_output << " " << name << "=" << value;
+    }
+    debug_output << std::fixed << std::setprecision( 2 ) << ": " << segments_per_second() / 1e6 << " Mseg/s, "
+                 << 8 * bytes_per_second() / 1e9 << " Gbit/s";
+    if ( acks ) {
+      debug_output << ", " << ns_per_ack() << " ns/ACK";
+    }
+    debug_output << "\n";
+  }
+};
+
+// Time a section of code
+class SpeedTimer
+{
+  std::chrono::steady_clock::time_point start_ { std::chrono::steady_clock::now() };
+
+public:
+  double elapsed() const
+  {
+    return std::chrono::duration<double>( std::chrono::steady_clock::now() - start_ ).count();
+  }
+};
+
+// Generate a string of random bytes
+inline std::string random_payload( size_t len, size_t seed )
+{
+  std::default_random_engine rd { seed };
+  std::uniform_int_distribution<char> ud;
+  std::string ret( len, 0 );
+  for ( auto& ch : ret ) {
+    ch = ud( rd );
+  }
+  return ret;
+}
+
+// Make an owned copy of a (possibly borrowed) TCPMessage
+inline TCPMessage clone( const TCPMessage& msg )
+{
+  return { .sender = msg.sender, .receiver = msg.receiver };
+}
+
+// One direction of an in-memory link between two TCPPeers, with optional random loss and a fixed delay
+// (in simulated milliseconds, advanced by the caller).
+class InMemoryLink
+{
+  std::deque<std::pair<uint64_t, TCPMessage>> queue_ {}; // (delivery time, message)
+  std::default_random_engine rand_;
+  std::bernoulli_distribution drop_;
+  uint64_t delay_ms_;
+  uint64_t now_ms_ {};
+  std::vector<TCPMessage> batch_ {};
+
+public:
+  uint64_t segments_sent {};
+  uint64_t segments_dropped {};
+
+  // The seed makes the loss pattern (and so the measurement) repeatable from run to run
+  InMemoryLink( double loss_rate, size_t seed, uint64_t delay_ms = 0 )
+    : rand_( seed ), drop_( loss_rate ), delay_ms_( delay_ms )
+  {}
+
+  // A TCPTransmitFunction that queues messages for delivery
+  auto transmit()
+  {
+    return [this]( std::span<const TCPMessage> batch ) {
+      for ( const auto& msg : batch ) {
+        ++segments_sent;
+        if ( drop_( rand_ ) ) {
+          ++segments_dropped;
+          continue;
+        }
+        queue_.emplace_back( now_ms_ + delay_ms_, clone( msg ) );
+      }
+    };
+  }
+
+  bool empty() const { return queue_.empty(); }
+
+  void advance( uint64_t ms ) { now_ms_ += ms; }
+
+  // Deliver everything that has arrived by now to `peer`, which replies over `reverse`
+  void deliver( TCPPeer& peer, InMemoryLink& reverse )
+  {
+    auto reply = reverse.transmit();
+    while ( not queue_.empty() and queue_.front().first <= now_ms_ ) {
+      TCPMessage msg = std::move( queue_.front().second );
+      queue_.pop_front();
+      peer.receive( std::move( msg ), reply );
+    }
+  }
+
+  // Like deliver(), but hand `peer` up to `max_batch` messages at a time, as an event loop draining a burst would
+  void deliver_batch( TCPPeer& peer, InMemoryLink& reverse, size_t max_batch )
+  {
+    auto reply = reverse.transmit();
+    while ( not queue_.empty() and queue_.front().first <= now_ms_ ) {
+      batch_.clear();
+      while ( batch_.size() < max_batch and not queue_.empty() and queue_.front().first <= now_ms_ ) {
+        batch_.push_back( std::move( queue_.front().second ) );
+        queue_.pop_front();
+      }
+      peer.receive_batch( batch_, reply );
+    }
+  }
+};
@@ -0,0 +1,138 @@
+#include "tcp_peer.hh"
+#include "tcp_speed_test.hh"
+#include "timer_wheel.hh"
+
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+// `connections` established TCPPeers, of which the first `busy` have a byte in flight that is never acknowledged
+// (so their retransmission timers keep running) and the rest are idle, through `simulated_ms` of simulated time
+// in steps of `tick_ms`. Either every peer is ticked at every step (as TCPMinnowSocket's loop ticks its one
+// peer), or a TimerWheel holds each peer's next timer and only the peers with a timer due are ticked (as
+// TCPMinnowStack does). Measures the cost of keeping time, and how many peers that touches.
+//
+// Every peer that has gone idle also has a timer once, BUFFER_RELEASE_TIMEOUT after its handshake, to free its
+// drained buffers (see TCPPeer::release_idle_buffers()); after that an idle peer has no timer at all. Since all
+// the peers here open at once, those timers all come due in one step, so the first BUFFER_RELEASE_TIMEOUT is
+// run before the clock starts and counted apart, and the rest measures the steady state.
+void timers( const string& benchmark, size_t connections, size_t busy, bool wheel )
+{
+  constexpr uint64_t simulated_ms = 2000;
+  constexpr uint64_t tick_ms = 10;
+
+  TCPConfig cfg;
+  cfg.rt_timeout = 200;
+  cfg.send_capacity = 1024;
+  cfg.recv_capacity = 1024;
+
+  // Open each connection against a passive peer that is thrown away afterwards.
+  vector<TCPPeer> peers;
+  peers.reserve( connections );
+  InMemoryLink to_server { 0, 1 };
+  InMemoryLink to_client { 0, 2 };
+  for ( size_t i = 0; i < connections; i++ ) {
+    TCPPeer& client = peers.emplace_back( cfg );
+    TCPPeer server { cfg };
+    client.push( to_server.transmit() );
+    to_server.deliver( server, to_client );
+    to_client.deliver( client, to_server );
+    to_server.deliver( server, to_client );
+    if ( not client.has_ackno() or not server.has_ackno() ) {
+      throw runtime_error( "TCPPeer pair did not establish the connection" );
+    }
+  }
+
+  uint64_t retransmissions = 0;
+  const auto lost = [&]( span<const TCPMessage> batch ) { retransmissions += batch.size(); };
+  for ( size_t i = 0; i < busy; i++ ) {
+    peers[i].outbound_writer().push( "x" );
+    peers[i].push( []( span<const TCPMessage> ) {} );
+  }
+
+  uint64_t peers_ticked = 0;
+  uint64_t settle_peers_ticked = 0;
+  constexpr uint64_t settle_ms = TCPConfig::BUFFER_RELEASE_TIMEOUT + tick_ms;
+  vector<uint64_t> last_tick( connections );
+  TimerWheel<size_t> timer_wheel { 0 };
+  const auto schedule = [&]( size_t i ) {
+    if ( const auto delay = peers[i].ms_until_next_timer() ) {
+      timer_wheel.schedule( last_tick[i] + delay.value(), i );
+    }
+  };
+  if ( wheel ) {
+    for ( size_t i = 0; i < connections; i++ ) {
+      schedule( i );
+    }
+  }
+
+  const auto step = [&]( uint64_t now ) {
+    if ( wheel ) {
+      timer_wheel.advance( now, [&]( uint64_t, size_t i ) {
+        peers[i].tick( now - last_tick[i], lost );
+        last_tick[i] = now;
+        ++peers_ticked;
+        schedule( i );
+      } );
+    } else {
+      for ( auto& peer : peers ) {
+        peer.tick( tick_ms, lost );
+      }
+      peers_ticked += peers.size();
+    }
+  };
+
+  uint64_t now = tick_ms;
+  for ( ; now < settle_ms; now += tick_ms ) {
+    step( now );
+  }
+  settle_peers_ticked = std::exchange( peers_ticked, 0 );
+
+  const SpeedTimer timer;
+  for ( ; now <= simulated_ms; now += tick_ms ) {
+    step( now );
+  }
+  const double seconds = timer.elapsed();
+
+  if ( retransmissions < busy ) {
+    throw runtime_error( "the busy connections did not retransmit" );
+  }
+
+  const double steps = static_cast<double>( ( simulated_ms - settle_ms ) / tick_ms + 1 );
+  SpeedResult result { .benchmark = benchmark,
+                       .parameters = { { "connections", connections }, { "busy", busy } },
+                       .seconds = seconds,
+                       .segments = retransmissions };
+  result.extra["us_per_tick_interval"] = seconds * 1e6 / steps;
+  result.extra["peers_ticked_per_interval"] = static_cast<double>( peers_ticked ) / steps;
+  result.extra["settle_peers_ticked"] = static_cast<double>( settle_peers_ticked );
+  result.report();
+}
+
+void program_body()
+{
+  // 100k connections, 1% of them waiting to retransmit: ticking all of them vs. only those with a timer due
+  timers( "timers_tick_all", 100000, 1000, false );
+  timers( "timers_wheel", 100000, 1000, true );
+}
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,252 @@
+#include "random.hh"
+#include "timer_wheel.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+using Wheel = TimerWheel<size_t>;
+constexpr uint64_t SLOTS = Wheel::SLOTS;
+constexpr uint64_t TOP_SPAN = uint64_t { 1 } << ( Wheel::SLOT_BITS * Wheel::LEVELS ); // SLOTS^LEVELS
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "timer_wheel: " + what );
+  }
+}
+
+// A wheel with timers at given times, which records when (by the wheel's clock) each one fires
+class Recorder
+{
+  Wheel wheel_;
+  vector<uint64_t> due_ {};      // by timer
+  vector<uint64_t> fired_at_ {}; // by timer (0: not yet)
+  vector<size_t> order_ {};      // timers, as they fired
+
+public:
+  explicit Recorder( uint64_t start ) : wheel_( start ) {}
+
+  Wheel& wheel() { return wheel_; }
+
+  size_t schedule( uint64_t when )
+  {
+    due_.push_back( when );
+    fired_at_.push_back( 0 );
+    wheel_.schedule( when, due_.size() - 1 );
+    return due_.size() - 1;
+  }
+
+  void advance( uint64_t now )
+  {
+    wheel_.advance( now, [&]( uint64_t when, size_t timer ) {
+      expect( when == due_.at( timer ), "timer " + to_string( timer ) + " fired with the wrong time" );
+      expect( fired_at_.at( timer ) == 0, "timer " + to_string( timer ) + " fired twice" );
+      fired_at_.at( timer ) = wheel_.now();
+      order_.push_back( timer );
+    } );
+    expect( wheel_.now() == now, "clock should be at " + to_string( now ) );
+  }
+
+  bool fired( size_t timer ) const { return fired_at_.at( timer ) != 0; }
+
+  //! Every timer due by now has fired exactly on time (or, if scheduled for a time already past, at `past_at`),
+  //! no other timer has fired, and they fired in order of their times
+  void check( uint64_t scheduled_at = 0 ) const
+  {
+    const uint64_t now = wheel_.now();
+    size_t pending = 0;
+    for ( size_t timer = 0; timer < due_.size(); timer++ ) {
+      const string name = "timer " + to_string( timer ) + " due at " + to_string( due_[timer] );
+      if ( due_[timer] > now ) {
+        expect( not fired( timer ), name + " fired early, at " + to_string( fired_at_[timer] ) );
+        ++pending;
+      } else if ( due_[timer] > scheduled_at ) {
+        expect( fired_at_[timer] == due_[timer],
+                name + " fired at " + ( fired( timer ) ? to_string( fired_at_[timer] ) : "never" ) );
+      } else {
+        expect( fired_at_[timer] == scheduled_at, name + " (already past) should fire at once" );
+      }
+    }
+    expect( wheel_.size() == pending, "size() should count the pending timers" );
+    for ( size_t i = 1; i < order_.size(); i++ ) {
+      expect( due_[order_[i - 1]] <= due_[order_[i]], "timers fired out of order" );
+    }
+  }
+};
+} // namespace
+
+int main()
+{
+  try {
+    {
+      // Timers in the first level fire at their instant, one step at a time or in one go
+      const uint64_t start = 1000;
+      Recorder r { start };
+      for ( const uint64_t delay : { 1, 2, 5, 5, 63, 64 } ) {
+        r.schedule( start + delay );
+      }
+      r.advance( start );
+      r.check();
+      for ( uint64_t now = start + 1; now <= start + 10; now++ ) {
+        r.advance( now );
+        r.check();
+      }
+      r.advance( start + 100 );
+      r.check();
+      expect( r.wheel().size() == 0, "every timer should have fired" );
+    }
+
+    {
+      // Timers on every level, and on the boundaries between them, cascade down and fire exactly on time
+      // (from an unaligned start, so that the slots of every level come round part-way through their span)
+      const uint64_t start = 3 * TOP_SPAN + 5 * SLOTS * SLOTS * SLOTS + 17 * SLOTS * SLOTS + 33 * SLOTS + 9;
+      Recorder r { start };
+      for ( uint64_t span = 1; span < TOP_SPAN; span *= SLOTS ) {
+        // (on the top level, only its first few slots, to keep the test short)
+        for ( const uint64_t delay : { span - 1, span, span + 1, 2 * span, 2 * span + 1, SLOTS * span - 1 } ) {
+          if ( delay > 0 and delay <= 3 * TOP_SPAN / SLOTS ) {
+            r.schedule( start + delay );
+          }
+        }
+        // and at the boundaries of the slots (counted from zero, not from the start)
+        const uint64_t boundary = ( start / span + 1 ) * span;
+        r.schedule( boundary );
+        r.schedule( boundary - 1 );
+        r.schedule( boundary + 1 );
+      }
+      for ( uint64_t now = start; now < start + 5 * SLOTS; now++ ) {
+        r.advance( now );
+        r.check();
+      }
+      r.advance( start + 3 * TOP_SPAN / SLOTS );
+      r.check();
+      expect( r.wheel().size() == 0, "every timer should have fired" );
+    }
+
+    {
+      // Timers beyond the top level are parked until its next turn, and then placed again: from part-way through
+      // a turn, they fire on time once it comes round
+      const uint64_t start = 2 * TOP_SPAN + 60 * SLOTS * SLOTS * SLOTS + 7;
+      const uint64_t cycle = 3 * TOP_SPAN; // where the top level next comes round
+      Recorder r { start };
+      for ( const uint64_t when : { cycle - 1, cycle, cycle + 1, cycle + SLOTS * SLOTS * SLOTS + 5 } ) {
+        r.schedule( when );
+      }
+      r.advance( cycle - 1 );
+      r.check();
+      r.advance( cycle + 1 );
+      r.check();
+      r.advance( cycle + 2 * SLOTS * SLOTS * SLOTS );
+      r.check();
+      expect( r.wheel().size() == 0, "every far timer should have fired" );
+    }
+
+    {
+      // Timers at and past SLOTS^LEVELS ahead (from just before a turn of the top level, so that they are two
+      // turns ahead) fire on time
+      const uint64_t cycle = 3 * TOP_SPAN;
+      const uint64_t start = cycle - 3;
+      Recorder r { start };
+      for ( const uint64_t when : { cycle - 1,
+                                    cycle,
+                                    start + TOP_SPAN - 1,
+                                    start + TOP_SPAN,
+                                    start + TOP_SPAN + 1,
+                                    cycle + TOP_SPAN,
+                                    cycle + TOP_SPAN + 1 } ) {
+        r.schedule( when );
+      }
+      r.advance( cycle );
+      r.check();
+      r.advance( start + TOP_SPAN );
+      r.check();
+      r.advance( cycle + TOP_SPAN + 1 );
+      r.check();
+      expect( r.wheel().size() == 0, "every far timer should have fired" );
+    }
+
+    {
+      // A timer for a time that has already come fires at the next advance(), even without the clock moving,
+      // and so does one scheduled for the past by an expiring timer
+      const uint64_t start = 5000;
+      Recorder r { start };
+      const size_t past = r.schedule( start - 10 );
+      const size_t now = r.schedule( start );
+      const size_t soon = r.schedule( start + 1 );
+      expect( r.wheel().size() == 3, "size() should count timers already due" );
+      r.advance( start );
+      expect( r.fired( past ) and r.fired( now ) and not r.fired( soon ), "due timers should fire at once" );
+      r.check( start );
+
+      Wheel wheel { start };
+      vector<uint64_t> fired;
+      wheel.schedule( start + 2, 1 );
+      const auto expire = [&]( uint64_t when, size_t item ) {
+        fired.push_back( when );
+        if ( item == 1 ) {
+          wheel.schedule( start, 2 ); // (already past)
+          wheel.schedule( start + 3, 3 );
+        }
+      };
+      wheel.advance( start + 2, expire );
+      expect( fired == vector<uint64_t> { start + 2 }, "only the first timer should fire by start + 2" );
+      expect( wheel.size() == 2, "both timers scheduled while expiring should be waiting" );
+      wheel.advance( start + 2, expire );
+      expect( fired == vector<uint64_t> { start + 2, start }, "a past timer should fire at the next advance()" );
+      wheel.advance( start + 3, expire );
+      expect( fired == vector<uint64_t> { start + 2, start, start + 3 }, "and the later one on time" );
+      expect( wheel.size() == 0, "every timer should have fired" );
+    }
+
+    {
+      // An empty wheel jumps straight to the new time, and timers scheduled afterwards count from there
+      Recorder r { 0 };
+      r.advance( 7 * TOP_SPAN + 3 );
+      const uint64_t start = r.wheel().now();
+      r.schedule( start + 1 );
+      r.schedule( start + SLOTS * SLOTS + 1 );
+      r.schedule( start + SLOTS * SLOTS * SLOTS + 1 );
+      r.advance( start + 2 * SLOTS * SLOTS * SLOTS );
+      r.check();
+    }
+
+    {
+      // Many timers at random times (on every level below the top), advanced by random amounts
+      auto rd = get_random_engine();
+      const uint64_t start = uniform_int_distribution<uint64_t> { 0, uint64_t { 1 } << 40 }( rd );
+      Recorder r { start };
+      uniform_int_distribution<uint64_t> level { 1, Wheel::LEVELS - 1 };
+      const auto delay = [&] {
+        return uniform_int_distribution<uint64_t> { 0, uint64_t { 1 } << ( Wheel::SLOT_BITS * level( rd ) ) }( rd );
+      };
+      for ( size_t i = 0; i < 2000; i++ ) {
+        r.schedule( start + 1 + delay() );
+      }
+      uint64_t now = start;
+      while ( r.wheel().size() > 0 ) {
+        now += delay();
+        r.advance( now );
+        r.check();
+        if ( r.wheel().size() > 0 and now < start + 4 * TOP_SPAN / SLOTS ) {
+          r.schedule( now + 1 + delay() );
+        }
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "eventfd.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+/*
+ * A stream of bytes from one thread (the writer) to another (the reader), through a fixed-size ring in memory
+ * that they share without a lock.
+ *
+ * Each side owns one position (the writer the tail, the reader the head) and only reads the other's, so a push
+ * or a pop is a copy and a couple of atomic operations. A side that finds nothing to do sleeps on its EventFD,
+ * and the other side notifies it only when it changes that: a push that finds the ring empty (the reader has
+ * caught up) notifies the reader, and a pop that finds it full notifies the writer. While both sides keep up,
+ * the stream costs no system calls at all.
+ *
+ * A reader that polls the ring instead of sleeping (see TCPMinnowSocket::set_busy_poll()) says so, and then
+ * pushes do not notify it at all.
+ *
+ * Either side may close the stream: the reader sees the end once it has read what was pushed before, and the
+ * writer can push no more.
+ */
+class ByteRing
+{
+public:
+  //! A ring of at least `capacity` bytes, whose sides wake each other with `reader_wakeup` and `writer_wakeup`
+  ByteRing( uint64_t capacity, EventFD& reader_wakeup, EventFD& writer_wakeup )
+    : capacity_( std::bit_ceil( capacity ) )
+    , buffer_( std::make_unique<char[]>( capacity_ ) ) // NOLINT(*-avoid-c-arrays)
+    , reader_wakeup_( &reader_wakeup )
+    , writer_wakeup_( &writer_wakeup )
+  {}
+
+  uint64_t capacity() const { return capacity_; }
+
+  //! \name Writer
+  //!@{
+
+  //! Push as much of `data` as there is room for, and wake the reader if it had read everything
+  //! \returns the number of bytes pushed (0 once the stream is closed)
+  uint64_t push( std::string_view data )
+  {
+    const uint64_t tail = tail_.load( std::memory_order_relaxed );
+    const uint64_t len = std::min<uint64_t>( data.size(), available_capacity() );
+    if ( len == 0 or is_closed() ) {
+      return 0;
+    }
+
+    const uint64_t offset = tail & ( capacity_ - 1 );
+    const uint64_t first = std::min( len, capacity_ - offset );
+    std::copy_n( data.data(), first, buffer_.get() + offset );
+    std::copy_n( data.data() + first, len - first, buffer_.get() );
+
+    // (sequentially consistent, like the pop's, so that either the reader sees the new tail before it sleeps
+    // or this sees that the reader had caught up with the old one)
+    tail_.store( tail + len );
+    if ( not reader_polling_.load() and head_.load() >= tail ) {
+      reader_wakeup_->notify();
+    }
+    return len;
+  }
+
+  //! Room for more bytes
+  uint64_t available_capacity() const { return capacity_ - ( tail_.load( std::memory_order_relaxed ) - head_.load() ); }
+
+  //!@}
+
+  //! \name Reader
+  //!@{
+
+  //! The next bytes (as many as are contiguous in the ring)
+  std::string_view peek() const
+  {
+    const uint64_t head = head_.load( std::memory_order_relaxed );
+    const uint64_t offset = head & ( capacity_ - 1 );
+    return { buffer_.get() + offset, std::min( tail_.load() - head, capacity_ - offset ) };
+  }
+
+  //! Remove `len` bytes, and wake the writer if the ring was full
+  void pop( uint64_t len )
+  {
+    const uint64_t head = head_.load( std::memory_order_relaxed );
+    head_.store( head + len );
+    if ( tail_.load() - head >= capacity_ ) {
+      writer_wakeup_->notify();
+    }
+  }
+
+  uint64_t bytes_buffered() const { return tail_.load() - head_.load( std::memory_order_relaxed ); }
+
+  //! While the reader polls bytes_buffered() (rather than sleeping on its EventFD), pushes need not wake it.
+  //! (A reader that stops polling must check bytes_buffered() once more before it sleeps.)
+  void set_reader_polling( bool polling )
+  {
+    if ( reader_polling_.load( std::memory_order_relaxed ) != polling ) {
+      reader_polling_.store( polling );
+    }
+  }
+
+  //! Has the stream been closed, and everything pushed before read?
+  bool is_finished() const { return is_closed() and bytes_buffered() == 0; }
+
+  //!@}
+
+  //! Close the stream (from either side), and wake both sides
+  void close()
+  {
+    closed_.store( true );
+    reader_wakeup_->notify();
+    writer_wakeup_->notify();
+  }
+
+  bool is_closed() const { return closed_.load(); }
+
+  ByteRing( const ByteRing& other ) = delete;
+  ByteRing( ByteRing&& other ) = delete;
+  ByteRing& operator=( const ByteRing& other ) = delete;
+  ByteRing& operator=( ByteRing&& other ) = delete;
+  ~ByteRing() = default;
+
+private:
+  uint64_t capacity_; //!< (a power of two, so that a position's offset in the ring is a mask)
+  std::unique_ptr<char[]> buffer_; // NOLINT(*-avoid-c-arrays)
+
+  // The positions in the stream (they only increase) of the next byte to read and to write, on separate cache
+  // lines so that the two threads do not contend for one
+  alignas( 64 ) std::atomic<uint64_t> head_ {};
+  std::atomic_bool reader_polling_ {}; //!< (set by the reader, so on its cache line)
+  alignas( 64 ) std::atomic<uint64_t> tail_ {};
+  alignas( 64 ) std::atomic_bool closed_ {};
+
+  EventFD* reader_wakeup_;
+  EventFD* writer_wakeup_;
+};
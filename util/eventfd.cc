@@ -0,0 +1,36 @@
+#include "eventfd.hh"
+#include "exception.hh"
+
+#include <cerrno>
+#include <cstdint>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+EventFD::EventFD() : FileDescriptor( CheckSystemCall( "eventfd", eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) ) {}
+
+void EventFD::notify()
+{
+  const uint64_t one = 1;
+  // (not counted with register_write(): any thread may notify, and the count is not atomic; an EventFD is only
+  // ever polled for reading, so nothing looks at it)
+  CheckFDSystemCall( "write", ::write( fd_num(), &one, sizeof( one ) ) );
+}
+
+void EventFD::clear()
+{
+  uint64_t count = 0;
+  CheckFDSystemCall( "read", ::read( fd_num(), &count, sizeof( count ) ) );
+  register_read(); // (an EventLoop rule that clears the EventFD has serviced it; only the waiter clears)
+}
+
+void EventFD::wait()
+{
+  pollfd notified { .fd = fd_num(), .events = POLLIN, .revents = 0 };
+  while ( ::poll( &notified, 1, -1 ) < 0 ) {
+    if ( errno != EINTR ) {
+      throw unix_error { "poll" };
+    }
+  }
+  clear();
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "file_descriptor.hh"
+
+//! A FileDescriptor to a Linux [eventfd](\ref man2::eventfd): a counter that one thread notifies, and another
+//! waits on (or polls, as an EventLoop rule with Direction::In) until it has been notified
+class EventFD : public FileDescriptor
+{
+public:
+  //! Create a (non-blocking) eventfd that has not been notified
+  EventFD();
+
+  //! Wake up the waiter (notifications that are not yet cleared add up to one wakeup); from any thread
+  void notify();
+
+  //! Forget the notifications so far (only from the waiter's thread, like wait())
+  void clear();
+
+  //! Block until notified, and clear the notifications
+  void wait();
+};
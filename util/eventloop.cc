@@ -4,6 +4,7 @@
 #include <cstring>
 #include <iostream>
 #include <sys/socket.h>
+#include <utility>
 
 using namespace std;
 
@@ -113,8 +114,17 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
   }
 
   // now the file-descriptor-related rules. poll any "interested" file descriptors
-  vector<pollfd> pollfds {};
-  pollfds.reserve( _fd_rules.size() );
+  // (The storage of the pollfds is reused from one call to the next, but taken out of the EventLoop while this
+  // call uses it: a call from inside a rule's callback, such as an inline TCPMinnowSocket's wait_until_closed()
+  // driving the owner's loop, then fills a vector of its own instead of the revents this call is walking.)
+  struct ReusedPollfds
+  {
+    std::vector<pollfd>& home;
+    std::vector<pollfd> pollfds { std::exchange( home, {} ) };
+    ~ReusedPollfds() { home = std::move( pollfds ); }
+  } reused { _pollfds };
+  auto& pollfds = reused.pollfds;
+  pollfds.clear();
   bool something_to_poll = false;
 
   // set up the pollfd for each rule
@@ -4,6 +4,7 @@
 #include <list>
 #include <memory>
 #include <poll.h>
+#include <vector>
 
 #include "file_descriptor.hh"
 
@@ -54,6 +55,7 @@ private:
   std::vector<RuleCategory> _rule_categories {};
   std::list<std::shared_ptr<FDRule>> _fd_rules {};
   std::list<std::shared_ptr<BasicRule>> _non_fd_rules {};
+  std::vector<pollfd> _pollfds {}; //!< (storage reused from one wait_next_event to the next, when not nested)
 
 public:
   EventLoop() { _rule_categories.reserve( 64 ); }
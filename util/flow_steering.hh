@@ -0,0 +1,99 @@
+#pragma once
+
+#include "eventfd.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_segment.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/*
+ * Assigns each connection to one of N shards by the hash of its four-tuple (like a NIC's receive-side scaling),
+ * and carries segments to the shard that owns their connection.
+ *
+ * Every shard reads datagrams from a device of its own (such as one queue of a multi-queue TUN device), and the
+ * device does not know about the shards: a segment may arrive on any of them. The shard that reads it hands it,
+ * already parsed, to its owner's inbox, and the owner's event loop takes the whole inbox at once. An inbox is
+ * notified only when it goes from empty to non-empty, so a burst of segments for another shard costs it one
+ * wakeup.
+ */
+class FlowSteering
+{
+public:
+  explicit FlowSteering( size_t shards )
+  {
+    inboxes_.reserve( shards );
+    for ( size_t i = 0; i < shards; i++ ) {
+      inboxes_.push_back( std::make_unique<Inbox>() );
+    }
+  }
+
+  size_t shards() const { return inboxes_.size(); }
+
+  //! The shard that owns the connection `tuple`. It is the same seen from either end (like RSS with a symmetric
+  //! key), so that two sharded stacks linked queue to queue agree on it, and the segments of each connection
+  //! travel between the same pair of shards in both directions.
+  size_t shard_of( const TCPFourTuple& tuple ) const
+  {
+    const TCPFourTuple reverse { .local_ip = tuple.remote_ip,
+                                 .remote_ip = tuple.local_ip,
+                                 .local_port = tuple.remote_port,
+                                 .remote_port = tuple.local_port };
+    return std::min( tuple.hash(), reverse.hash() ) % inboxes_.size();
+  }
+
+  //! Hand a segment to the inbox of `shard` (from any thread)
+  void steer( size_t shard, const TCPFourTuple& tuple, TCPMessage&& msg )
+  {
+    Inbox& inbox = *inboxes_.at( shard );
+    bool was_empty = false;
+    {
+      const std::scoped_lock lock { inbox.mutex };
+      was_empty = inbox.tuples.empty();
+      inbox.tuples.push_back( tuple );
+      inbox.batch.push_back( std::move( msg ) );
+    }
+    if ( was_empty ) {
+      inbox.ready.notify();
+    }
+    steered_.fetch_add( 1, std::memory_order_relaxed );
+  }
+
+  //! Readable (as an EventLoop rule with Direction::In) while the inbox of `shard` may hold segments
+  EventFD& inbox_ready( size_t shard ) { return inboxes_.at( shard )->ready; }
+
+  //! Move everything in the inbox of `shard` to the end of `tuples` and `batch`
+  void take( size_t shard, std::vector<TCPFourTuple>& tuples, std::vector<TCPMessage>& batch )
+  {
+    Inbox& inbox = *inboxes_.at( shard );
+    inbox.ready.clear();
+    const std::scoped_lock lock { inbox.mutex };
+    tuples.insert( tuples.end(), inbox.tuples.begin(), inbox.tuples.end() );
+    std::move( inbox.batch.begin(), inbox.batch.end(), std::back_inserter( batch ) );
+    inbox.tuples.clear();
+    inbox.batch.clear();
+  }
+
+  //! How many segments have arrived at a shard other than their owner, and been handed over
+  uint64_t steered() const { return steered_.load( std::memory_order_relaxed ); }
+
+private:
+  // (each on its own cache lines, so that shards handing segments to different inboxes do not contend)
+  struct alignas( 64 ) Inbox
+  {
+    std::mutex mutex {};
+    std::vector<TCPFourTuple> tuples {};
+    std::vector<TCPMessage> batch {};
+    EventFD ready {};
+  };
+
+  std::vector<std::unique_ptr<Inbox>> inboxes_ {};
+  std::atomic<uint64_t> steered_ {};
+};
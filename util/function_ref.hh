@@ -0,0 +1,36 @@
+#pragma once
+
+#include <concepts>
+#include <functional>
+#include <memory>
+#include <type_traits>
+
+/*
+ * A FunctionRef<R( Args... )> is a non-owning reference to a callable object.
+ *
+ * Unlike std::function, it never allocates or copies the callable: it stores only a pointer to it and a
+ * pointer to a trampoline that invokes it. The referenced callable must outlive the FunctionRef, so it is
+ * meant to be used as a function parameter (e.g. a `transmit` callback), not stored.
+ */
+template<typename Signature>
+class FunctionRef;
+
+template<typename R, typename... Args>
+class FunctionRef<R( Args... )>
+{
+  void* obj_;
+  R ( *callback_ )( void*, Args... );
+
+public:
+  template<typename F>
+    requires( not std::same_as<std::remove_cvref_t<F>, FunctionRef> and std::is_invocable_r_v<R, F&, Args...> )
+  FunctionRef( F&& f ) noexcept // NOLINT(*-explicit-*, *-missing-std-forward)
+    : obj_( const_cast<void*>( static_cast<const void*>( std::addressof( f ) ) ) ) // NOLINT(*-const-cast)
+    , callback_( []( void* obj, Args... args ) -> R {
+      return std::invoke( *static_cast<std::add_pointer_t<std::remove_reference_t<F>>>( obj ),
+                          std::forward<Args>( args )... );
+    } )
+  {}
+
+  R operator()( Args... args ) const { return callback_( obj_, std::forward<Args>( args )... ); }
+};
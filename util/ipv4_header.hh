@@ -13,6 +13,13 @@ struct IPv4Header
   static constexpr uint8_t DEFAULT_TTL = 128; // A reasonable default TTL value
   static constexpr uint8_t PROTO_TCP = 6;     // Protocol number for TCP
 
+  // The ECN field: the two low-order bits of the type of service (RFC 3168)
+  static constexpr uint8_t ECN_MASK = 0b11;
+  static constexpr uint8_t ECN_NOT_ECT = 0b00; // not ECN-capable
+  static constexpr uint8_t ECN_ECT1 = 0b01;    // ECN-capable transport
+  static constexpr uint8_t ECN_ECT0 = 0b10;    // ECN-capable transport (the codepoint TCP uses)
+  static constexpr uint8_t ECN_CE = 0b11;      // Congestion Experienced
+
   static constexpr uint64_t serialized_length() { return LENGTH; }
 
   /*
@@ -36,7 +43,7 @@ struct IPv4Header
   // IPv4 Header fields
   uint8_t ver = 4;           // IP version
   uint8_t hlen = LENGTH / 4; // header length (multiples of 32 bits)
-  uint8_t tos = 0;           // type of service
+  uint8_t tos = 0;           // type of service (DSCP and ECN)
   uint16_t len = 0;          // total length of packet
   uint16_t id = 0;           // identification number
   bool df = true;            // don't fragment flag
@@ -57,6 +64,10 @@ struct IPv4Header
   // Set checksum to correct value
   void compute_checksum();
 
+  // The ECN field
+  uint8_t ecn() const { return tos & ECN_MASK; }
+  void set_ecn( uint8_t codepoint ) { tos = ( tos & ~ECN_MASK ) | ( codepoint & ECN_MASK ); }
+
   // Return a string containing a header in human-readable format
   std::string to_string() const;
 
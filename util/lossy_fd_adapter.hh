@@ -7,6 +7,7 @@
 
 #include <optional>
 #include <random>
+#include <span>
 #include <utility>
 
 //! An adapter class that adds random dropping behavior to an FD adapter
@@ -59,6 +60,15 @@ public:
     return _adapter.write( seg );
   }
 
+  //! \brief Write a batch to the underlying AdapterT instance, potentially dropping each datagram
+  //! \param[in] batch is the packets to either write or drop
+  void write( std::span<const TCPMessage> batch )
+  {
+    for ( const auto& seg : batch ) {
+      write( seg );
+    }
+  }
+
   //! \name
   //! Passthrough functions to the underlying AdapterT instance
 
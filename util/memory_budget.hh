@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+/*
+ * A budget for the memory of all the stream buffers in the process (like Linux's tcp_mem).
+ *
+ * Every ByteStream and Reassembler charges the memory it allocates to MemoryBudget::process(). Past the soft limit
+ * the budget is under pressure, and no connection's buffers grow any more: a TCPReceiver moves its window's
+ * right edge no further than the memory its stream already holds (but never moves it back), and the
+ * application can write no more into a TCPSender's stream than fits in the memory that stream already holds.
+ * Past the hard limit, each stream is held to MIN_BUFFER bytes, gives back the memory it does not need right
+ * away, and Reassemblers drop the out-of-order data they store (like Linux's tcp_prune_ofo_queue).
+ * Every stream may still use MIN_BUFFER, so that each connection can make progress.
+ *
+ * Without limits (the default), the budget only counts.
+ */
+class MemoryBudget
+{
+public:
+  enum class Pressure : uint8_t
+  {
+    None,
+    Soft,
+    Hard
+  };
+
+  //! Under pressure, every stream may still buffer this much (like SOCK_MIN_RCVBUF and SOCK_MIN_SNDBUF)
+  static constexpr uint64_t MIN_BUFFER = 4096;
+
+  //! The budget shared by every stream in the process
+  static MemoryBudget& process()
+  {
+    static MemoryBudget budget;
+    return budget;
+  }
+
+  //! Set the limits, in bytes (0: no limit)
+  void set_limits( uint64_t soft, uint64_t hard )
+  {
+    soft_.store( soft == 0 ? UINT64_MAX : soft, std::memory_order_relaxed );
+    hard_.store( hard == 0 ? UINT64_MAX : hard, std::memory_order_relaxed );
+  }
+
+  //! Memory charged now, in bytes
+  uint64_t usage() const { return usage_.load( std::memory_order_relaxed ); }
+
+  //! Most memory charged at once (since the last reset_peak())
+  uint64_t peak() const { return peak_.load( std::memory_order_relaxed ); }
+  void reset_peak() { peak_.store( usage(), std::memory_order_relaxed ); }
+
+  Pressure pressure() const
+  {
+    const uint64_t usage = this->usage();
+    if ( usage >= hard_.load( std::memory_order_relaxed ) ) {
+      return Pressure::Hard;
+    }
+    return usage >= soft_.load( std::memory_order_relaxed ) ? Pressure::Soft : Pressure::None;
+  }
+
+  void charge( uint64_t bytes )
+  {
+    const uint64_t usage = usage_.fetch_add( bytes, std::memory_order_relaxed ) + bytes;
+    uint64_t peak = peak_.load( std::memory_order_relaxed );
+    while ( usage > peak and not peak_.compare_exchange_weak( peak, usage, std::memory_order_relaxed ) ) {}
+  }
+
+  void uncharge( uint64_t bytes ) { usage_.fetch_sub( bytes, std::memory_order_relaxed ); }
+
+private:
+  std::atomic<uint64_t> usage_ {};
+  std::atomic<uint64_t> peak_ {};
+  std::atomic<uint64_t> soft_ { UINT64_MAX };
+  std::atomic<uint64_t> hard_ { UINT64_MAX };
+};
+
+//! The memory that one buffer has charged to the process's MemoryBudget: kept equal to the buffer's allocation
+//! with set(), and returned when the buffer goes away. (A copy of a buffer charges the same amount again.)
+class MemoryCharge
+{
+  uint64_t bytes_ {};
+
+public:
+  MemoryCharge() = default;
+  ~MemoryCharge() { set( 0 ); }
+
+  MemoryCharge( const MemoryCharge& other ) { set( other.bytes_ ); }
+  MemoryCharge( MemoryCharge&& other ) noexcept : bytes_( std::exchange( other.bytes_, 0 ) ) {}
+  MemoryCharge& operator=( const MemoryCharge& other )
+  {
+    set( other.bytes_ );
+    return *this;
+  }
+  MemoryCharge& operator=( MemoryCharge&& other ) noexcept
+  {
+    if ( this != &other ) {
+      set( 0 );
+      bytes_ = std::exchange( other.bytes_, 0 );
+    }
+    return *this;
+  }
+
+  uint64_t bytes() const { return bytes_; }
+
+  void set( uint64_t bytes )
+  {
+    if ( bytes > bytes_ ) {
+      MemoryBudget::process().charge( bytes - bytes_ );
+    } else if ( bytes < bytes_ ) {
+      MemoryBudget::process().uncharge( bytes_ - bytes );
+    }
+    bytes_ = bytes;
+  }
+};
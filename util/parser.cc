@@ -167,3 +167,11 @@ vector<Ref<string>> Serializer::finish()
   flush();
   return move( output_ );
 }
+
+string Serializer::finish_contiguous()
+{
+  if ( not output_.empty() ) {
+    throw runtime_error( "Serializer::finish_contiguous() called after buffer()" );
+  }
+  return move( buffer_ );
+}
@@ -100,6 +100,11 @@ class Serializer
   void flush();
 
 public:
+  Serializer() = default;
+
+  // Construct a Serializer whose integers are written into `storage`, reusing its allocation
+  explicit Serializer( std::string&& storage ) : buffer_( std::move( storage ) ) { buffer_.clear(); }
+
   template<std::unsigned_integral T>
   void integer( const T val )
   {
@@ -115,4 +120,7 @@ public:
   void buffer( Ref<std::string> buf );
   void buffer( const std::vector<Ref<std::string>>& bufs );
   std::vector<Ref<std::string>> finish();
+
+  // Return the integers serialized so far as one contiguous string (no buffers may have been added)
+  std::string finish_contiguous();
 };
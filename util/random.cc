@@ -13,3 +13,10 @@ default_random_engine get_random_engine()
   seed_seq seed( seed_data.begin(), seed_data.end() );
   return default_random_engine( seed );
 }
+
+array<uint64_t, 2> random_key()
+{
+  auto rand = get_random_engine();
+  uniform_int_distribution<uint64_t> dist;
+  return { dist( rand ), dist( rand ) };
+}
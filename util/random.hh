@@ -1,5 +1,18 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <random>
 
 std::default_random_engine get_random_engine();
+
+//! A random 128-bit secret key (for keyed hashes such as SYN cookies and Fast Open cookies)
+std::array<uint64_t, 2> random_key();
+
+//! SplitMix64's finalizer: a cheap, well-mixed 64-bit permutation
+inline uint64_t mix64( uint64_t x )
+{
+  x = ( x ^ ( x >> 30U ) ) * 0xbf58476d1ce4e5b9ULL;
+  x = ( x ^ ( x >> 27U ) ) * 0x94d049bb133111ebULL;
+  return x ^ ( x >> 31U );
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "exception.hh"
+#include "flow_steering.hh"
+#include "tcp_minnow_stack.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <sched.h>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+//! A TCP stack spread across cores: one TCPMinnowStack (a shard) per device, each with its own thread, event
+//! loop, connections and timers
+template<IPv4DatagramDevice DeviceT>
+class ShardedTCPMinnowStack
+{
+public:
+  using Stack = TCPMinnowStack<DeviceT>;
+  using Socket = typename Stack::Socket;
+  using Listener = typename Stack::Listener;
+
+  //! Construct one shard per device (such as one per queue of a multi-queue TUN device), and start their
+  //! threads. With `pin`, each shard's thread runs on a core of its own (as far as there are cores to go round).
+  explicit ShardedTCPMinnowStack( std::vector<DeviceT>&& devices, bool pin = true )
+    : steering_( std::make_shared<FlowSteering>( devices.size() ) )
+  {
+    if ( devices.empty() ) {
+      throw std::invalid_argument( "ShardedTCPMinnowStack: no devices" );
+    }
+    const std::vector<unsigned> cpus = pin ? allowed_cpus() : std::vector<unsigned> {};
+    shards_.reserve( devices.size() );
+    for ( size_t i = 0; i < devices.size(); i++ ) {
+      std::optional<unsigned> cpu;
+      if ( not cpus.empty() ) {
+        cpu = cpus[i % cpus.size()];
+      }
+      shards_.push_back( std::make_unique<Stack>( std::move( devices[i] ), steering_, i, cpu ) );
+    }
+  }
+
+  size_t shards() const { return shards_.size(); }
+  Stack& shard( size_t index ) { return *shards_.at( index ); }
+
+  //! Open a connection (see TCPMinnowStack::connect()). With port 0, the shards take turns, each choosing an
+  //! ephemeral port that makes the connection its own; otherwise, the shard that owns the four-tuple opens it.
+  Socket connect( const TCPConfig& cfg, const Address& source, const Address& destination )
+  {
+    size_t shard = next_shard_.fetch_add( 1, std::memory_order_relaxed ) % shards_.size();
+    if ( source.port() != 0 ) {
+      shard = steering_->shard_of( TCPFourTuple { .local_ip = source.ipv4_numeric(),
+                                                  .remote_ip = destination.ipv4_numeric(),
+                                                  .local_port = source.port(),
+                                                  .remote_port = destination.port() } );
+    }
+    return shards_[shard]->connect( cfg, source, destination );
+  }
+
+  //! Listen on every shard (see TCPMinnowStack::listen()), like sockets with SO_REUSEPORT: each shard accepts
+  //! the connections that it owns into a Listener of its own, so that each can be served on the shard's core.
+  //! \returns the shards' Listeners, in order
+  std::vector<Listener> listen( const TCPConfig& cfg,
+                                const Address& address,
+                                size_t backlog = Stack::DEFAULT_BACKLOG,
+                                bool syn_cookies = true )
+  {
+    std::vector<Listener> listeners;
+    listeners.reserve( shards_.size() );
+    for ( auto& shard : shards_ ) {
+      listeners.push_back( shard->listen( cfg, address, backlog, syn_cookies ) );
+    }
+    return listeners;
+  }
+
+  //! How many connections the shards are running, in all
+  size_t connection_count() const
+  {
+    size_t count = 0;
+    for ( const auto& shard : shards_ ) {
+      count += shard->connection_count();
+    }
+    return count;
+  }
+
+  //! How many segments arrived on a shard other than the one that owns their connection
+  uint64_t steered() const { return steering_->steered(); }
+
+private:
+  std::shared_ptr<FlowSteering> steering_;
+  std::vector<std::unique_ptr<Stack>> shards_ {};
+  std::atomic<size_t> next_shard_ {};
+
+  //! The cores that this process may run on
+  static std::vector<unsigned> allowed_cpus()
+  {
+    cpu_set_t set;
+    CPU_ZERO( &set );
+    CheckSystemCall( "sched_getaffinity", sched_getaffinity( 0, sizeof( set ), &set ) );
+    std::vector<unsigned> cpus;
+    for ( unsigned cpu = 0; cpu < CPU_SETSIZE; cpu++ ) {
+      if ( CPU_ISSET( cpu, &set ) ) {
+        cpus.push_back( cpu );
+      }
+    }
+    return cpus;
+  }
+};
+
+using ShardedTCPOverIPv4MinnowStack = ShardedTCPMinnowStack<IPv4OverTunFdDevice>;
+
+//! \class ShardedTCPMinnowStack
+//! A TCPMinnowStack runs all its connections on one thread, so it uses one core however many connections it
+//! has. A ShardedTCPMinnowStack divides the connections among N shards by the hash of their four-tuples (see
+//! FlowSteering), so that the shards share nothing on the fast path: each drives only its own TCPPeers, under
+//! its own lock, on its own core.
+//!
+//! Each shard reads and writes its own device. A segment may arrive on any shard's device (a multi-queue TUN
+//! device picks the queue by a hash of its own); the shard that reads it hands it to the shard that owns it.
+//! Connections that this end opens avoid that: each shard picks ephemeral ports that hash to itself.
+//!
+//! The Sockets and Listeners are those of the shards, so their methods may be called from any thread.
@@ -6,6 +6,14 @@
 #include <cstddef>
 #include <cstdint>
 
+//! How a TCPSender coalesces small writes before sending them
+enum class TCPCoalescing : uint8_t
+{
+  NoDelay,  //!< Send every write as soon as the window allows
+  Nagle,    //!< RFC 896: hold a sub-MSS segment while any data is unacknowledged
+  Autocork, //!< Minshall's variant: hold a sub-MSS segment only while an earlier sub-MSS segment is unacknowledged
+};
+
 //! Config for TCP sender and receiver
 class TCPConfig
 {
@@ -14,10 +22,28 @@ public:
   static constexpr size_t MAX_PAYLOAD_SIZE = 1000;  //!< Conservative max payload size for real Internet
   static constexpr uint16_t TIMEOUT_DFLT = 1000;    //!< Default re-transmit timeout is 1 second
   static constexpr unsigned MAX_RETX_ATTEMPTS = 8;  //!< Maximum re-transmit attempts before giving up
+  static constexpr uint64_t MAX_PERSIST_TIMEOUT = 60000; //!< Upper bound on the zero-window probe interval, in ms
+  static constexpr uint64_t CORK_TIMEOUT = 200;          //!< Longest a corked partial segment is held, in ms
+  static constexpr uint64_t DELAYED_ACK_TIMEOUT = 40;    //!< Default longest an ACK is delayed, in ms
+  static constexpr uint64_t SWS_OVERRIDE_TIMEOUT = 200;  //!< Longest a sender waits for a usable window, in ms
+  static constexpr uint64_t LOWAT_MAX_DELAY = 20;        //!< Default longest wait for a socket low-watermark, in ms
+  static constexpr uint64_t BUFFER_IDLE_TIMEOUT = 5000;  //!< Autotuned buffers shrink back after this long idle, in ms
+  static constexpr uint64_t BUFFER_RELEASE_TIMEOUT = 200; //!< Drained buffers are freed after this long idle, in ms
+  static constexpr uint64_t SEND_BUFFER_FACTOR = 2;      //!< Autotuned send capacity, in peer windows
 
   uint16_t rt_timeout = TIMEOUT_DFLT;      //!< Initial value of the retransmission timeout, in milliseconds
-  size_t recv_capacity = DEFAULT_CAPACITY; //!< Receive capacity, in bytes
-  size_t send_capacity = DEFAULT_CAPACITY; //!< Sender capacity, in bytes
+  size_t recv_capacity = DEFAULT_CAPACITY; //!< Receive capacity, in bytes (initial and idle one, if autotuned)
+  size_t send_capacity = DEFAULT_CAPACITY; //!< Sender capacity, in bytes (initial and idle one, if autotuned)
+  size_t recv_capacity_max = 0; //!< If above recv_capacity, ceiling up to which the receive capacity is autotuned
+  size_t send_capacity_max = 0; //!< If above send_capacity, ceiling up to which the send capacity is autotuned
+  size_t mss = MAX_PAYLOAD_SIZE;           //!< Maximum payload size of each outgoing segment, in bytes
+  TCPCoalescing coalescing = TCPCoalescing::Nagle; //!< How small writes are coalesced into segments
+  size_t offload_size = 0; //!< If above mss, payload limit of the "super-segments" that the adapter cuts to mss
+  bool repacketize = true; //!< On timeout, merge small outstanding segments into one of up to mss bytes
+  uint64_t ack_delay = DELAYED_ACK_TIMEOUT; //!< Longest an ACK for in-order data is held, in ms (0: ACK at once)
+  bool sws_avoidance = true; //!< Avoid the silly window syndrome (RFC 1122): neither offer nor fill small windows
+  bool ecn = false; //!< Explicit Congestion Notification (RFC 3168): send ECN-capable data, echo and heed CE marks
+  bool fast_open = false; //!< TCP Fast Open (RFC 7413) on TCPMinnowSocket: send data with the SYN, and accept it
   Wrap32 isn { 137 };                      //!< Default initial sequence number
 };
 
@@ -28,6 +54,8 @@ public:
   Address source { "0", 0 };      //!< Source address and port
   Address destination { "0", 0 }; //!< Destination address and port
 
+  size_t mss = TCPConfig::MAX_PAYLOAD_SIZE; //!< Payload size of each wire segment; longer segments are cut to fit
+
   uint16_t loss_rate_dn = 0; //!< Downlink loss rate (for LossyFdAdapter)
   uint16_t loss_rate_up = 0; //!< Uplink loss rate (for LossyFdAdapter)
 };
@@ -0,0 +1,42 @@
+#include "tcp_fast_open.hh"
+#include "random.hh"
+
+using namespace std;
+
+FastOpenCookieGenerator::FastOpenCookieGenerator() : key_( random_key() ) {}
+
+//! \details A keyed hash of the address, which an attacker who does not know the key cannot predict (RFC 7413
+//! suggests a block cipher such as AES; this is meant for experiments, not for the open Internet).
+string FastOpenCookieGenerator::cookie( const Address& client ) const
+{
+  uint64_t hash = mix64( key_[0] ^ client.ipv4_numeric() );
+  hash = mix64( hash ^ key_[1] );
+
+  string ret( COOKIE_LENGTH, 0 );
+  for ( auto& ch : ret ) {
+    ch = static_cast<char>( hash & 0xffU );
+    hash >>= 8U;
+  }
+  return ret;
+}
+
+const FastOpenCookieGenerator& FastOpenCookieGenerator::global()
+{
+  static const FastOpenCookieGenerator generator;
+  return generator;
+}
+
+optional<string> FastOpenCookieCache::get( const Address& server ) const
+{
+  const auto it = cookies_.find( server.ip() );
+  if ( it == cookies_.end() ) {
+    return {};
+  }
+  return it->second;
+}
+
+FastOpenCookieCache& FastOpenCookieCache::global()
+{
+  static FastOpenCookieCache cache;
+  return cache;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "address.hh"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+/*
+ * TCP Fast Open (RFC 7413) cookies.
+ *
+ * A server hands each client a cookie derived from the client's IP address under a secret key, and later
+ * accepts data on a SYN from that address only if the SYN presents the same cookie. A client keeps the cookies
+ * it has been given, by server address, to present on its next connection to the same server.
+ */
+
+//! Server side: computes the cookie for a client address
+class FastOpenCookieGenerator
+{
+  std::array<uint64_t, 2> key_;
+
+public:
+  static constexpr size_t COOKIE_LENGTH = 8; //!< RFC 7413 allows 4 to 16 bytes
+
+  //! Use a random secret key
+  FastOpenCookieGenerator();
+
+  //! Use the given secret key (two servers with the same key accept each other's cookies)
+  explicit FastOpenCookieGenerator( const std::array<uint64_t, 2>& key ) : key_( key ) {}
+
+  //! The cookie for a client (only its IP address counts, not its port)
+  std::string cookie( const Address& client ) const;
+
+  //! The generator that this process's TCPMinnowSockets use
+  static const FastOpenCookieGenerator& global();
+};
+
+//! Client side: the cookies received from servers
+class FastOpenCookieCache
+{
+  std::unordered_map<std::string, std::string> cookies_ {}; // server IP address -> cookie
+
+public:
+  //! The cookie to present to a server, if one was received before
+  std::optional<std::string> get( const Address& server ) const;
+
+  //! Remember a cookie received from a server
+  void put( const Address& server, std::string cookie )
+  {
+    cookies_.insert_or_assign( server.ip(), std::move( cookie ) );
+  }
+
+  //! Forget a server's cookie (e.g. when it no longer grants one)
+  void erase( const Address& server ) { cookies_.erase( server.ip() ); }
+
+  //! The cache that this process's TCPMinnowSockets use (it is not thread-safe: connect from one thread only)
+  static FastOpenCookieCache& global();
+};
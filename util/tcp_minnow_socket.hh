@@ -1,5 +1,7 @@
 #pragma once
 
+#include "byte_ring.hh"
+#include "eventfd.hh"
 #include "eventloop.hh"
 #include "file_descriptor.hh"
 #include "socket.hh"
@@ -8,25 +10,46 @@
 #include "tuntap_adapter.hh"
 
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <optional>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <type_traits>
+#include <vector>
+
+//! How often the TCPPeer thread ticks its connections, in milliseconds
+static constexpr size_t TCP_TICK_MS = 10;
+
+inline uint64_t timestamp_ms()
+{
+  static_assert( std::is_same_v<std::chrono::steady_clock::duration, std::chrono::nanoseconds> );
+
+  return std::chrono::steady_clock::now().time_since_epoch().count() / 1000000;
+}
 
 //! Multithreaded wrapper around TCPPeer that approximates the Unix sockets API
 template<TCPDatagramAdapter AdaptT>
-class TCPMinnowSocket : public LocalStreamSocket
+class TCPMinnowSocket
 {
 public:
   //! Construct from the interface that the TCPPeer thread will use to read and write datagrams
   explicit TCPMinnowSocket( AdaptT&& datagram_interface );
 
+  //! Construct in inline mode: the owner's `eventloop` (which must outlive the socket) drives the TCPPeer, on the
+  //! owner's thread, and there is no TCPPeer thread
+  TCPMinnowSocket( AdaptT&& datagram_interface, EventLoop& eventloop );
+
   //! Close socket, and wait for TCPPeer to finish
   //! \note Calling this function is only advisable if the socket has reached EOF,
   //! or else may wait foreever for remote peer to close the TCP connection.
   void wait_until_closed();
 
   //! Connect using the specified configurations; blocks until connect succeeds or fails
-  void connect( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad );
+  //! \note `initial_data` (up to the send capacity) is written before the SYN is sent: with TCPConfig::fast_open
+  //! and a cookie from an earlier connection to the same server, it goes out with the SYN.
+  void connect( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad, std::string_view initial_data = {} );
 
   //! Listen and accept using the specified configurations; blocks until accept succeeds or fails
   void listen_and_accept( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad );
@@ -44,25 +67,91 @@ public:
   TCPMinnowSocket& operator=( TCPMinnowSocket&& ) = delete;
   //!@}
 
-  //! \name
-  //! Some methods of the parent Socket wouldn't work as expected on the TCP socket, so delete them
+  //! Read up to `buffer.size()` bytes (16 KiB, if it is empty) into `buffer` (resized to fit them); blocks until
+  //! there are some, or the inbound stream has ended (then `buffer` is left empty)
+  void read( std::string& buffer );
 
-  //!@{
-  void bind( const Address& address ) = delete;
-  Address local_address() const = delete;
-  void set_reuseaddr() = delete;
-  //!@}
+  //! Write `data` to the outbound stream; blocks until all of it is written
+  //! \returns the number of bytes written (fewer than `data.size()` only once the outbound stream is closed)
+  size_t write( std::string_view data );
+
+  //! Has the inbound stream ended (and been read to the end)?
+  bool eof() const;
+
+  //! Shut down the outbound stream (SHUT_WR), the inbound stream (SHUT_RD: anything still arriving is
+  //! discarded), or both (SHUT_RDWR)
+  void shutdown( int how );
+
+  //! Shut down both streams (the connection finishes in the background, or in wait_until_closed())
+  void close() { shutdown( SHUT_RDWR ); }
+
+  //! Disable small-write coalescing (like TCP_NODELAY), sending each write as soon as the window allows
+  void set_nodelay( bool nodelay );
+
+  //! Hold partial segments until uncorked (like TCP_CORK), or for at most TCPConfig::CORK_TIMEOUT
+  void set_cork( bool cork );
+
+  //! Hand inbound bytes to the owner only once at least `bytes` are ready (like SO_RCVLOWAT), or the stream has
+  //! ended, or half the receive buffer is used, or the oldest of them has waited `max_delay_ms`
+  void set_receive_lowat( uint64_t bytes, uint64_t max_delay_ms = TCPConfig::LOWAT_MAX_DELAY )
+  {
+    _receive_lowat.store( bytes );
+    _receive_lowat_delay.store( max_delay_ms );
+  }
+
+  //! Take outbound bytes from the owner only once at least `bytes` of the send buffer are free (like SO_SNDLOWAT),
+  //! or once some space has been free for `max_delay_ms`
+  void set_send_lowat( uint64_t bytes, uint64_t max_delay_ms = TCPConfig::LOWAT_MAX_DELAY )
+  {
+    _send_lowat.store( bytes );
+    _send_lowat_delay.store( max_delay_ms );
+  }
+
+  //! Busy-poll (like SO_BUSY_POLL): the TCPPeer thread spins on the network and the outbound ring instead of
+  //! sleeping in poll(), and a read() that finds nothing spins before it sleeps, until nothing has happened for
+  //! `idle_us` microseconds (0, the default: never spin). Trades a core for the wakeup latency.
+  void set_busy_poll( uint64_t idle_us ) { _busy_poll_us.store( idle_us ); }
 
   // Return peer address from underlying datagram adapter
   const Address& peer_address() const { return _datagram_adapter.config().destination; }
 
+  //! \name
+  //! In inline mode, the owner reads and writes the TCPPeer's streams directly (instead of calling read() and
+  //! write()), once connect() or listen_and_accept() has returned. The low-watermarks do not apply.
+
+  //!@{
+  Reader& inbound_reader();
+  Writer& outbound_writer();
+
+  //! Send what the owner's writes to outbound_writer() (and reads from inbound_reader()) allow
+  void push();
+
+  //! Keep the TCPPeer's time: call after each `wait_next_event` of the owner's EventLoop, which should wait for
+  //! at most TCP_TICK_MS
+  void tick();
+  //!@}
+
 protected:
   //! Adapter to underlying datagram socket (e.g., UDP or IP)
   AdaptT _datagram_adapter;
 
 private:
-  //! Stream socket for reads and writes between owner and TCP thread
-  LocalStreamSocket _thread_data;
+  //! Capacity of each ring between the owner and the TCPPeer thread
+  static constexpr uint64_t RING_CAPACITY = 1 << 18;
+
+  //! How much read() reads into an empty buffer
+  static constexpr size_t DEFAULT_READ_SIZE = 16384;
+
+  //! Notified when the TCPPeer thread has something to do for the owner (bytes to take, or room to give bytes)
+  EventFD _tcp_wakeup {};
+
+  //! Notified when the owner's read() or write() can go on
+  EventFD _readable {};
+  EventFD _writable {};
+
+  //! Bytes from the owner to the TCPPeer thread, and from the TCPPeer thread to the owner
+  ByteRing _outbound { RING_CAPACITY, _tcp_wakeup, _writable };
+  ByteRing _inbound { RING_CAPACITY, _readable, _tcp_wakeup };
 
   //! Set up the TCPPeer and the event loop
   void _initialize_TCP( const TCPConfig& config );
@@ -73,6 +162,35 @@ private:
   //! eventloop that handles all the events (new inbound datagram, new outbound bytes, new inbound bytes)
   EventLoop _eventloop {};
 
+  //! The eventloop that drives the TCPPeer: `_eventloop` on the TCPPeer thread, or the owner's in inline mode
+  EventLoop* _loop { &_eventloop };
+  bool _inline { false };
+
+  //! The rules this socket added to `_loop` (in inline mode, cancelled when the socket is destructed)
+  std::vector<EventLoop::RuleHandle> _rules {};
+
+  //! When the TCPPeer was last ticked (timestamp_ms())
+  uint64_t _last_tick {};
+
+  //! Datagrams read in one event-loop iteration, handed to TCPPeer::receive_batch (storage is reused)
+  static constexpr size_t MAX_RECEIVE_BATCH = 16;
+  std::vector<TCPMessage> _inbound_batch {};
+
+  //! Is another datagram ready to be read right away?
+  bool _datagram_waiting();
+
+  //! Have enough inbound bytes (or old enough ones) accumulated to hand them to the owner?
+  bool _inbound_ready();
+
+  //! Is enough of the send buffer free (or has it been free long enough) to take bytes from the owner?
+  bool _outbound_ready();
+
+  //! Tick the TCPPeer (and the adapter) for the time since the last tick
+  void _tick();
+
+  //! Have the TCPPeer apply changed coalescing options now (and send what they release)
+  void _apply_options();
+
   //! Process events while specified condition is true
   void _tcp_loop( const std::function<bool()>& condition );
 
@@ -82,16 +200,28 @@ private:
   //! Handle to the TCPPeer thread; owner thread calls join() in the destructor
   std::thread _tcp_thread {};
 
-  //! Construct LocalStreamSocket fds from socket pair, initialize eventloop
-  TCPMinnowSocket( std::pair<FileDescriptor, FileDescriptor> data_socket_pair, AdaptT&& datagram_interface );
-
   std::atomic_bool _abort { false }; //!< Flag used by the owner to force the TCPPeer thread to shut down
 
+  std::atomic_bool _nodelay { false }; //!< Coalescing overrides set by the owner, applied by the TCPPeer thread
+  std::atomic_bool _cork { false };
+
+  std::atomic<uint64_t> _busy_poll_us { 0 }; //!< How long to spin after the last event (0: never)
+
+  std::atomic<uint64_t> _receive_lowat { 1 }; //!< Low-watermarks set by the owner, applied by the TCPPeer thread
+  std::atomic<uint64_t> _receive_lowat_delay { 0 };
+  std::atomic<uint64_t> _send_lowat { 1 };
+  std::atomic<uint64_t> _send_lowat_delay { 0 };
+
+  std::optional<uint64_t> _inbound_waiting_since {};  //!< When inbound bytes started waiting for the low-watermark
+  std::optional<uint64_t> _outbound_waiting_since {}; //!< When send-buffer space started waiting for it
+
   bool _inbound_shutdown { false }; //!< Has TCPMinnowSocket shut down the incoming data to the owner?
 
   bool _outbound_shutdown { false }; //!< Has the owner shut down the outbound data to the TCP connection?
 
   bool _fully_acked { false }; //!< Has the outbound data been fully acknowledged by the peer?
+
+  bool _accept_fast_open { false }; //!< Is this a listening socket that accepts data on a Fast Open SYN?
 };
 
 using TCPOverIPv4MinnowSocket = TCPMinnowSocket<TCPOverIPv4OverTunFdAdapter>;
@@ -103,7 +233,7 @@ using LossyTCPOverIPv4MinnowSocket = TCPMinnowSocket<LossyFdAdapter<TCPOverIPv4O
 //! One, the "owner" or foreground thread, interacts with this class in much the
 //! same way as one would interact with a TCPSocket: it connects or listens, writes to
 //! and reads from a reliable data stream, etc. Only the owner thread calls public
-//! methods of this class.
+//! methods of this class (except that read() and write() may each be called from a thread of its own).
 //!
 //! The other, the "TCPPeer" thread, takes care of the back-end tasks that the kernel would
 //! perform for a TCPSocket: reading and parsing datagrams from the wire, filtering out
@@ -111,11 +241,18 @@ using LossyTCPOverIPv4MinnowSocket = TCPMinnowSocket<LossyFdAdapter<TCPOverIPv4O
 //!
 //! There are a few notable differences between the TCPMinnowSocket and TCPSocket interfaces:
 //!
-//! - a TCPMinnowSocket can only accept a single connection
+//! - a TCPMinnowSocket can only accept a single connection (TCPMinnowStack::listen() returns a Listener that
+//!   accepts any number, with bounded SYN and accept queues)
 //! - listen_and_accept() is a blocking function call that acts as both [listen(2)](\ref man2::listen)
 //!   and [accept(2)](\ref man2::accept)
 //! - if TCPMinnowSocket is destructed while a TCP connection is open, the connection is
 //!   immediately terminated with a RST (call `wait_until_closed` to avoid this)
+//! - a TCPMinnowSocket is not a file descriptor: the bytes move between the two threads through a ByteRing each
+//!   way, without system calls, and a blocked read() or write() sleeps on an EventFD of its own
+//!
+//! An event-driven owner can do without the second thread: constructed with the owner's EventLoop, a
+//! TCPMinnowSocket adds its rules to that loop, and the owner reads and writes the TCPPeer's streams directly
+//! (inbound_reader() and outbound_writer(), then push()), with no handoff between threads or copy in between.
 
 //! Helper class that makes a TCPOverIPv4MinnowSocket behave more like a (kernel) TCPSocket
 class CS144TCPSocket : public TCPOverIPv4MinnowSocket
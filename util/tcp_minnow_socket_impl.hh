@@ -1,64 +1,128 @@
 #include "tcp_minnow_socket.hh"
 
 #include "exception.hh"
+#include "tcp_fast_open.hh"
 
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
 #include <exception>
 #include <iostream>
+#include <poll.h>
 #include <stdexcept>
 #include <string>
 #include <sys/socket.h>
+#include <thread>
 #include <utility>
 
-static constexpr size_t TCP_TICK_MS = 10;
-
-inline uint64_t timestamp_ms()
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::_tick()
 {
-  static_assert( std::is_same_v<std::chrono::steady_clock::duration, std::chrono::nanoseconds> );
+  if ( not _tcp.has_value() ) {
+    throw std::runtime_error( "_tick called before TCPPeer initialized" );
+  }
 
-  return std::chrono::steady_clock::now().time_since_epoch().count() / 1000000;
+  if ( _tcp.value().active() ) {
+    const auto next_time = timestamp_ms();
+    // (the tick pushes, so anything released by a change of options is sent right away)
+    _tcp.value().set_nodelay( _nodelay );
+    _tcp.value().set_cork( _cork );
+    _tcp.value().tick( next_time - _last_tick, [&]( const auto& x ) { _datagram_adapter.write( x ); } );
+    _datagram_adapter.tick( next_time - _last_tick );
+    _last_tick = next_time;
+  }
 }
 
 //! \param[in] condition is a function returning true if loop should continue
+//! \details With busy polling, each turn of the loop polls without waiting (and the owner's writes do not wake
+//! it) until nothing has happened for the idle period; then it goes back to waiting in poll() for up to
+//! TCP_TICK_MS, until the next event. While spinning, the TCPPeer is ticked only as the clock moves on, and the
+//! thread yields the core after a turn that found nothing (to any other thread waiting for it).
 template<TCPDatagramAdapter AdaptT>
 void TCPMinnowSocket<AdaptT>::_tcp_loop( const std::function<bool()>& condition )
 {
-  auto base_time = timestamp_ms();
+  auto last_event = std::chrono::steady_clock::now();
   while ( condition() ) {
-    auto ret = _eventloop.wait_next_event( TCP_TICK_MS );
+    const auto idle = std::chrono::steady_clock::now() - last_event;
+    const bool spinning = idle < std::chrono::microseconds( _busy_poll_us.load() );
+    _outbound.set_reader_polling( spinning );
+    auto ret = _loop->wait_next_event( spinning ? 0 : TCP_TICK_MS );
     if ( ret == EventLoop::Result::Exit or _abort ) {
       break;
     }
-
-    if ( not _tcp.has_value() ) {
-      throw std::runtime_error( "_tcp_loop entered before TCPPeer initialized" );
+    if ( ret == EventLoop::Result::Success ) {
+      last_event = std::chrono::steady_clock::now();
+    } else if ( spinning ) {
+      std::this_thread::yield();
+      if ( timestamp_ms() == _last_tick ) {
+        continue;
+      }
     }
+    _tick();
+  }
+  _outbound.set_reader_polling( false );
+}
 
-    if ( _tcp.value().active() ) {
-      const auto next_time = timestamp_ms();
-      _tcp.value().tick( next_time - base_time, [&]( const auto& x ) { _datagram_adapter.write( x ); } );
-      _datagram_adapter.tick( next_time - base_time );
-      base_time = next_time;
-    }
+//! \returns true if another datagram can be read right away (checked without blocking)
+template<TCPDatagramAdapter AdaptT>
+bool TCPMinnowSocket<AdaptT>::_datagram_waiting()
+{
+  pollfd waiting { .fd = _datagram_adapter.fd().fd_num(), .events = POLLIN, .revents = 0 };
+  return CheckSystemCall( "poll", ::poll( &waiting, 1, 0 ) ) > 0 and ( waiting.revents & POLLIN ); // NOLINT(*-bitwise)
+}
+
+//! \returns true once the inbound bytes reach the receive low-watermark (capped at half the receive buffer, so
+//! that the window stays open), the stream has ended, or the oldest byte has waited out the maximum delay
+template<TCPDatagramAdapter AdaptT>
+bool TCPMinnowSocket<AdaptT>::_inbound_ready()
+{
+  const Reader& inbound = _tcp->inbound_reader();
+  const uint64_t buffered = inbound.bytes_buffered();
+  if ( buffered == 0 ) {
+    _inbound_waiting_since.reset();
+    return false;
   }
+
+  const uint64_t threshold = std::min<uint64_t>( _receive_lowat, std::max<uint64_t>( inbound.capacity() / 2, 1 ) );
+  if ( buffered >= threshold or inbound.writer().is_closed() or inbound.has_error() ) {
+    return true;
+  }
+
+  const uint64_t now = timestamp_ms();
+  if ( not _inbound_waiting_since.has_value() ) {
+    _inbound_waiting_since = now;
+  }
+  return now - _inbound_waiting_since.value() >= _receive_lowat_delay;
 }
 
-//! \param[in] data_socket_pair is a pair of connected AF_UNIX SOCK_STREAM sockets
-//! \param[in] datagram_interface is the interface for reading and writing datagrams
+//! \returns true once the free space in the send buffer reaches the send low-watermark (capped at the whole
+//! buffer), or some space has been free for the maximum delay
 template<TCPDatagramAdapter AdaptT>
-TCPMinnowSocket<AdaptT>::TCPMinnowSocket( std::pair<FileDescriptor, FileDescriptor> data_socket_pair,
-                                          AdaptT&& datagram_interface )
-  : LocalStreamSocket( std::move( data_socket_pair.first ) )
-  , _datagram_adapter( std::move( datagram_interface ) )
-  , _thread_data( std::move( data_socket_pair.second ) )
+bool TCPMinnowSocket<AdaptT>::_outbound_ready()
 {
-  _thread_data.set_blocking( false );
+  const Writer& outbound = _tcp->outbound_writer();
+  const uint64_t available = outbound.available_capacity();
+  if ( available == 0 ) {
+    _outbound_waiting_since.reset();
+    return false;
+  }
+
+  if ( available >= std::min<uint64_t>( _send_lowat, outbound.capacity() ) ) {
+    return true;
+  }
+
+  const uint64_t now = timestamp_ms();
+  if ( not _outbound_waiting_since.has_value() ) {
+    _outbound_waiting_since = now;
+  }
+  return now - _outbound_waiting_since.value() >= _send_lowat_delay;
 }
 
 template<TCPDatagramAdapter AdaptT>
 void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
 {
   _tcp.emplace( config );
+  _last_tick = timestamp_ms();
 
   // Set up the event loop
 
@@ -66,46 +130,66 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
   //
   // 1) Incoming datagram received (needs to be given to TCPPeer::receive method)
   //
-  // 2) Outbound bytes received from local application via a write()
-  //    call (needs to be read from the local stream socket and
+  // 2) Outbound bytes written by the local application via a write()
+  //    call (need to be taken from the outbound ring and
   //    given to TCPPeer)
   //
   // 3) Incoming bytes reassembled by the Reassembler
-  //    (needs to be read from the inbound_stream and written
-  //    to the local stream socket back to the application)
+  //    (need to be read from the inbound_stream and pushed
+  //    to the inbound ring, back to the application)
+  //
+  // Rules 2 and 3 do not wait on a file descriptor: they are checked on every turn of the loop, which the
+  // owner wakes up (rule 4) when it gives the rings something new.
 
   // rule 1: read from filtered packet stream and dump into TCPConnection
-  _eventloop.add_rule(
+  _rules.push_back( _loop->add_rule(
     "receive TCP segment from the network",
     _datagram_adapter.fd(),
     Direction::In,
     [&] {
-      if ( auto seg = _datagram_adapter.read() ) {
-        _tcp->receive( std::move( seg.value() ), [&]( const auto& x ) { _datagram_adapter.write( x ); } );
+      // Drain the burst of datagrams already waiting, so that TCPPeer can coalesce consecutive segments.
+      _inbound_batch.clear();
+      do {
+        if ( auto seg = _datagram_adapter.read() ) {
+          _inbound_batch.push_back( std::move( seg.value() ) );
+        }
+      } while ( _inbound_batch.size() < MAX_RECEIVE_BATCH and _datagram_waiting() );
+
+      // A listening socket expects the Fast Open cookie of the client, whose address the adapter learns from its SYN
+      if ( _accept_fast_open and not _tcp->has_ackno() ) {
+        _tcp->accept_fast_open( FastOpenCookieGenerator::global().cookie( _datagram_adapter.config().destination ) );
       }
+      _tcp->receive_batch( _inbound_batch, [&]( const auto& x ) { _datagram_adapter.write( x ); } );
 
       // debugging output:
-      if ( _thread_data.eof() and _tcp.value().sender().sequence_numbers_in_flight() == 0 and not _fully_acked ) {
+      if ( _tcp->outbound_writer().is_closed() and _tcp.value().sender().sequence_numbers_in_flight() == 0
+           and not _fully_acked ) {
         std::cerr << "DEBUG: minnow outbound stream to " << _datagram_adapter.config().destination.to_string()
                   << " has been fully acknowledged.\n";
         _fully_acked = true;
       }
     },
-    [&] { return _tcp->active(); } );
+    [&] { return _tcp->active(); } ) );
+
+  // In inline mode, that is all: the owner reads and writes the TCPPeer's streams itself.
+  if ( _inline ) {
+    return;
+  }
 
-  // rule 2: read from pipe into outbound buffer
+  // rule 2: read from outbound ring into outbound buffer
   _eventloop.add_rule(
     "push bytes to TCPPeer",
-    _thread_data,
-    Direction::In,
     [&] {
-      std::string data;
-      data.resize( _tcp->outbound_writer().available_capacity() );
-      _thread_data.read( data );
-      _tcp->outbound_writer().push( move( data ) );
+      Writer& outbound = _tcp->outbound_writer();
+      while ( _outbound.bytes_buffered() and outbound.available_capacity() ) {
+        const std::string_view data = _outbound.peek().substr( 0, outbound.available_capacity() );
+        outbound.push( data ); // (straight from the ring into the stream, with no copy in between)
+        _outbound.pop( data.size() );
+      }
+      _outbound_waiting_since.reset();
 
-      if ( _thread_data.eof() ) {
-        _tcp->outbound_writer().close();
+      if ( _outbound.is_finished() ) {
+        outbound.close();
         _outbound_shutdown = true;
 
         // debugging output:
@@ -118,36 +202,27 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
       _tcp->push( [&]( const auto& x ) { _datagram_adapter.write( x ); } );
     },
     [&] {
-      return ( _tcp->active() ) and ( not _outbound_shutdown )
-             and ( _tcp->outbound_writer().available_capacity() > 0 );
-    },
-    [&] {
-      _tcp->outbound_writer().close();
-      _outbound_shutdown = true;
-    },
-    [&] {
-      std::cerr << "DEBUG: minnow outbound stream had error.\n";
-      _tcp->outbound_writer().set_error();
+      return _tcp->active() and not _outbound_shutdown
+             and ( _outbound.is_finished() or ( _outbound.bytes_buffered() and _outbound_ready() ) );
     } );
 
-  // rule 3: read from inbound buffer into pipe
+  // rule 3: read from inbound buffer into inbound ring
   _eventloop.add_rule(
     "read bytes from inbound stream",
-    _thread_data,
-    Direction::Out,
     [&] {
       Reader& inbound = _tcp->inbound_reader();
-      // Write from the inbound_stream into
-      // the pipe, handling the possibility of a partial
-      // write (i.e., only pop what was actually written).
+      // Push as much of the inbound_stream into the ring as fits,
+      // popping only what was actually pushed (or everything, once
+      // the owner has shut down reading: nobody will read it).
       if ( inbound.bytes_buffered() ) {
-        const std::string_view buffer = inbound.peek();
-        const auto bytes_written = _thread_data.write( buffer );
-        inbound.pop( bytes_written );
+        while ( inbound.bytes_buffered() and ( _inbound.available_capacity() or _inbound.is_closed() ) ) {
+          inbound.pop( _inbound.is_closed() ? inbound.bytes_buffered() : _inbound.push( inbound.peek() ) );
+        }
+        _tcp->send_window_update( [&]( const auto& x ) { _datagram_adapter.write( x ); } );
       }
 
       if ( inbound.is_finished() or inbound.has_error() ) {
-        _thread_data.shutdown( SHUT_WR );
+        _inbound.close();
         _inbound_shutdown = true;
 
         // debugging output:
@@ -156,35 +231,189 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
       }
     },
     [&] {
-      return _tcp->inbound_reader().bytes_buffered()
-             or ( ( _tcp->inbound_reader().is_finished() or _tcp->inbound_reader().has_error() )
-                  and not _inbound_shutdown );
-    },
-    [&] {},
-    [&] {
-      std::cerr << "DEBUG: minnow inbound stream had error.\n";
-      _tcp->inbound_reader().set_error();
+      const Reader& inbound = _tcp->inbound_reader();
+      if ( _inbound_shutdown ) {
+        return false;
+      }
+      return ( _inbound_ready() and ( _inbound.available_capacity() or _inbound.is_closed() ) )
+             or inbound.is_finished() or inbound.has_error();
     } );
-}
 
-//! \brief Call [socketpair](\ref man2::socketpair) and return connected Unix-domain sockets of specified type
-//! \param[in] type is the type of AF_UNIX sockets to create (e.g., SOCK_SEQPACKET)
-//! \returns a std::pair of connected sockets
-template<std::derived_from<Socket> SocketType>
-inline std::pair<SocketType, SocketType> socket_pair_helper( int domain, int type, int protocol = 0 )
-{
-  std::array<int, 2> fds {};
-  CheckSystemCall( "socketpair", ::socketpair( domain, type, protocol, fds.data() ) );
-  return { SocketType { FileDescriptor { fds[0] } }, SocketType { FileDescriptor { fds[1] } } };
+  // rule 4: wake up when the owner has given either ring something new
+  // (after the connection, too, while inbound bytes are left to hand over)
+  _eventloop.add_rule(
+    "wake up for the owner",
+    _tcp_wakeup,
+    Direction::In,
+    [&] { _tcp_wakeup.clear(); },
+    [&] { return _tcp->active() or not _inbound_shutdown; } );
 }
 
 //! \param[in] datagram_interface is the underlying interface (e.g. to UDP, IP, or Ethernet)
 template<TCPDatagramAdapter AdaptT>
 TCPMinnowSocket<AdaptT>::TCPMinnowSocket( AdaptT&& datagram_interface )
-  : TCPMinnowSocket( socket_pair_helper<LocalStreamSocket>( AF_UNIX, SOCK_STREAM ),
-                     std::move( datagram_interface ) )
+  : _datagram_adapter( std::move( datagram_interface ) )
+{}
+
+//! \param[in] datagram_interface is the underlying interface (e.g. to UDP, IP, or Ethernet)
+//! \param[in] eventloop is the owner's EventLoop, in which the socket's rules are added
+template<TCPDatagramAdapter AdaptT>
+TCPMinnowSocket<AdaptT>::TCPMinnowSocket( AdaptT&& datagram_interface, EventLoop& eventloop )
+  : _datagram_adapter( std::move( datagram_interface ) ), _loop( &eventloop ), _inline( true )
 {}
 
+//! \param[out] buffer is resized to the bytes read (or left empty at the end of the stream)
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::read( std::string& buffer )
+{
+  if ( _inline ) {
+    throw std::runtime_error( "TCPMinnowSocket::read() in inline mode (use inbound_reader())" );
+  }
+
+  if ( buffer.empty() ) {
+    buffer.resize( DEFAULT_READ_SIZE );
+  }
+
+  if ( _inbound.bytes_buffered() == 0 and _busy_poll_us > 0 ) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds( _busy_poll_us.load() );
+    _inbound.set_reader_polling( true );
+    while ( _inbound.bytes_buffered() == 0 and not _inbound.is_closed()
+            and std::chrono::steady_clock::now() < deadline ) {
+      std::this_thread::yield();
+    }
+    _inbound.set_reader_polling( false );
+  }
+  while ( _inbound.bytes_buffered() == 0 and not _inbound.is_closed() ) {
+    _readable.wait();
+  }
+
+  size_t bytes_read = 0;
+  while ( bytes_read < buffer.size() and _inbound.bytes_buffered() ) {
+    const std::string_view data = _inbound.peek().substr( 0, buffer.size() - bytes_read );
+    std::copy( data.begin(), data.end(), buffer.begin() + static_cast<ptrdiff_t>( bytes_read ) );
+    _inbound.pop( data.size() );
+    bytes_read += data.size();
+  }
+  buffer.resize( bytes_read );
+}
+
+//! \param[in] data is the bytes to write
+template<TCPDatagramAdapter AdaptT>
+size_t TCPMinnowSocket<AdaptT>::write( std::string_view data )
+{
+  if ( _inline ) {
+    throw std::runtime_error( "TCPMinnowSocket::write() in inline mode (use outbound_writer())" );
+  }
+
+  size_t bytes_written = 0;
+  while ( bytes_written < data.size() and not _outbound.is_closed() ) {
+    if ( _outbound.available_capacity() == 0 ) {
+      _writable.wait();
+      continue;
+    }
+    bytes_written += _outbound.push( data.substr( bytes_written ) );
+  }
+  return bytes_written;
+}
+
+template<TCPDatagramAdapter AdaptT>
+bool TCPMinnowSocket<AdaptT>::eof() const
+{
+  if ( _inline ) {
+    return _tcp.has_value()
+           and ( _tcp->receiver().reader().is_finished() or _tcp->receiver().reader().has_error() );
+  }
+  return _inbound.is_finished();
+}
+
+//! \param[in] how is SHUT_RD, SHUT_WR or SHUT_RDWR (in inline mode, SHUT_RD does nothing: the owner just stops
+//! reading inbound_reader())
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::shutdown( int how )
+{
+  if ( _inline ) {
+    if ( _tcp.has_value() and ( how == SHUT_WR or how == SHUT_RDWR ) ) {
+      _tcp->outbound_writer().close();
+      push();
+    }
+    return;
+  }
+
+  if ( how == SHUT_WR or how == SHUT_RDWR ) {
+    _outbound.close();
+  }
+  if ( how == SHUT_RD or how == SHUT_RDWR ) {
+    _inbound.close();
+  }
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::set_nodelay( bool nodelay )
+{
+  _nodelay.store( nodelay );
+  _apply_options();
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::set_cork( bool cork )
+{
+  _cork.store( cork );
+  _apply_options();
+}
+
+//! \details In inline mode the owner's thread drives the TCPPeer, so the options are applied and pushed here;
+//! otherwise the TCPPeer thread is woken, and its next _tick() applies them and pushes.
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::_apply_options()
+{
+  if ( not _inline ) {
+    _tcp_wakeup.notify();
+  } else if ( _tcp.has_value() ) {
+    _tcp->set_nodelay( _nodelay );
+    _tcp->set_cork( _cork );
+    push();
+  }
+}
+
+template<TCPDatagramAdapter AdaptT>
+Reader& TCPMinnowSocket<AdaptT>::inbound_reader()
+{
+  if ( not _inline or not _tcp.has_value() ) {
+    throw std::runtime_error( "TCPMinnowSocket::inbound_reader() without an inline connection" );
+  }
+  return _tcp->inbound_reader();
+}
+
+template<TCPDatagramAdapter AdaptT>
+Writer& TCPMinnowSocket<AdaptT>::outbound_writer()
+{
+  if ( not _inline or not _tcp.has_value() ) {
+    throw std::runtime_error( "TCPMinnowSocket::outbound_writer() without an inline connection" );
+  }
+  return _tcp->outbound_writer();
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::push()
+{
+  if ( not _inline or not _tcp.has_value() ) {
+    throw std::runtime_error( "TCPMinnowSocket::push() without an inline connection" );
+  }
+  _tcp->push( [&]( const auto& x ) { _datagram_adapter.write( x ); } );
+  _tcp->send_window_update( [&]( const auto& x ) { _datagram_adapter.write( x ); } );
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::tick()
+{
+  if ( not _inline ) {
+    throw std::runtime_error( "TCPMinnowSocket::tick() outside inline mode" );
+  }
+  if ( _tcp.has_value() ) {
+    _tick();
+  }
+}
+
 template<TCPDatagramAdapter AdaptT>
 TCPMinnowSocket<AdaptT>::~TCPMinnowSocket()
 {
@@ -195,6 +424,10 @@ TCPMinnowSocket<AdaptT>::~TCPMinnowSocket()
       _abort.store( true );
       _tcp_thread.join();
     }
+    // (the owner's eventloop must not call back into this socket)
+    for ( auto& rule : _rules ) {
+      rule.cancel();
+    }
   } catch ( const std::exception& e ) {
     std::cerr << "Exception destructing TCPMinnowSocket: " << e.what() << "\n";
   }
@@ -204,6 +437,16 @@ template<TCPDatagramAdapter AdaptT>
 void TCPMinnowSocket<AdaptT>::wait_until_closed()
 {
   shutdown( SHUT_RDWR );
+  if ( _inline and _tcp.has_value() ) {
+    // Drive the owner's eventloop until the connection finishes, discarding what arrives (as after SHUT_RD)
+    std::cerr << "DEBUG: minnow waiting for clean shutdown... ";
+    _tcp_loop( [&] {
+      _tcp->inbound_reader().pop( _tcp->inbound_reader().bytes_buffered() );
+      push();
+      return _tcp->active();
+    } );
+    std::cerr << "done.\n";
+  }
   if ( _tcp_thread.joinable() ) {
     std::cerr << "DEBUG: minnow waiting for clean shutdown... ";
     _tcp_thread.join();
@@ -214,7 +457,9 @@ void TCPMinnowSocket<AdaptT>::wait_until_closed()
 //! \param[in] c_tcp is the TCPConfig for the TCPConnection
 //! \param[in] c_ad is the FdAdapterConfig for the FdAdapter
 template<TCPDatagramAdapter AdaptT>
-void TCPMinnowSocket<AdaptT>::connect( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad )
+void TCPMinnowSocket<AdaptT>::connect( const TCPConfig& c_tcp,
+                                       const FdAdapterConfig& c_ad,
+                                       std::string_view initial_data )
 {
   if ( _tcp ) {
     throw std::runtime_error( "connect() with TCPConnection already initialized" );
@@ -223,6 +468,7 @@ void TCPMinnowSocket<AdaptT>::connect( const TCPConfig& c_tcp, const FdAdapterCo
   _initialize_TCP( c_tcp );
 
   _datagram_adapter.config_mut() = c_ad;
+  _datagram_adapter.config_mut().mss = c_tcp.mss; // the adapter cuts offloaded super-segments to this size
 
   std::cerr << "DEBUG: minnow connecting to " << c_ad.destination.to_string() << "...\n";
 
@@ -230,13 +476,30 @@ void TCPMinnowSocket<AdaptT>::connect( const TCPConfig& c_tcp, const FdAdapterCo
     throw std::runtime_error( "TCPPeer not successfully initialized" );
   }
 
+  // With TCP Fast Open, present the cookie this server gave us before (or ask for one)
+  FastOpenCookieCache& cookies = FastOpenCookieCache::global();
+  if ( c_tcp.fast_open ) {
+    _tcp->set_fast_open( cookies.get( c_ad.destination ).value_or( "" ) );
+  }
+  if ( not initial_data.empty() ) {
+    _tcp->outbound_writer().push( initial_data );
+  }
+
   _tcp->push( [&]( const auto& x ) { _datagram_adapter.write( x ); } );
 
-  if ( _tcp->sender().sequence_numbers_in_flight() != 1 ) {
-    throw std::runtime_error( "After TCPConnection::connect(), expected sequence_numbers_in_flight() == 1" );
+  if ( _tcp->sender().sequence_numbers_in_flight() == 0 ) {
+    throw std::runtime_error( "After TCPConnection::connect(), expected a SYN in flight" );
   }
 
-  _tcp_loop( [&] { return _tcp->sender().sequence_numbers_in_flight() == 1; } );
+  _tcp_loop( [&] { return not _tcp->has_ackno(); } );
+
+  if ( c_tcp.fast_open and _tcp->has_ackno() ) {
+    if ( _tcp->fast_open_cookie().has_value() ) {
+      cookies.put( c_ad.destination, _tcp->fast_open_cookie().value() );
+    } else {
+      cookies.erase( c_ad.destination ); // the server no longer does Fast Open
+    }
+  }
 
   if ( not _tcp.has_value() ) {
     throw std::runtime_error( "TCPPeer destroyed unexpectedly" );
@@ -247,7 +510,9 @@ void TCPMinnowSocket<AdaptT>::connect( const TCPConfig& c_tcp, const FdAdapterCo
     std::cerr << "DEBUG: minnow successfully connected to " << c_ad.destination.to_string() << ".\n";
   }
 
-  _tcp_thread = std::thread( &TCPMinnowSocket::_tcp_main, this );
+  if ( not _inline ) {
+    _tcp_thread = std::thread( &TCPMinnowSocket::_tcp_main, this );
+  }
 }
 
 //! \param[in] c_tcp is the TCPConfig for the TCPConnection
@@ -262,13 +527,21 @@ void TCPMinnowSocket<AdaptT>::listen_and_accept( const TCPConfig& c_tcp, const F
   _initialize_TCP( c_tcp );
 
   _datagram_adapter.config_mut() = c_ad;
+  _datagram_adapter.config_mut().mss = c_tcp.mss; // the adapter cuts offloaded super-segments to this size
   _datagram_adapter.set_listening( true );
+  _accept_fast_open = c_tcp.fast_open;
 
+  // (data accepted on a Fast Open SYN is handed to the owner without waiting for the end of the handshake)
   std::cerr << "DEBUG: minnow listening for incoming connection...\n";
-  _tcp_loop( [&] { return ( not _tcp->has_ackno() ) or ( _tcp->sender().sequence_numbers_in_flight() ); } );
+  _tcp_loop( [&] {
+    return ( not _tcp->has_ackno() )
+           or ( _tcp->sender().sequence_numbers_in_flight() and _tcp->inbound_reader().bytes_buffered() == 0 );
+  } );
   std::cerr << "DEBUG: minnow new connection from " << _datagram_adapter.config().destination.to_string() << ".\n";
 
-  _tcp_thread = std::thread( &TCPMinnowSocket::_tcp_main, this );
+  if ( not _inline ) {
+    _tcp_thread = std::thread( &TCPMinnowSocket::_tcp_main, this );
+  }
 }
 
 template<TCPDatagramAdapter AdaptT>
@@ -279,7 +552,8 @@ void TCPMinnowSocket<AdaptT>::_tcp_main()
       throw std::runtime_error( "no TCP" );
     }
     _tcp_loop( [] { return true; } );
-    shutdown( SHUT_RDWR );
+    _outbound.close();
+    _inbound.close();
     if ( not _tcp.has_value() ) {
       throw std::runtime_error( "TCP implementation destroyed unexpectedly" );
     }
@@ -0,0 +1,288 @@
+#pragma once
+
+#include "address.hh"
+#include "eventloop.hh"
+#include "flow_steering.hh"
+#include "tcp_config.hh"
+#include "tcp_minnow_socket.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_peer.hh"
+#include "tcp_syn_cookie.hh"
+#include "timer_wheel.hh"
+#include "tuntap_adapter.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+//! A TCP stack that runs many TCPPeers over one datagram device, in one event loop
+template<IPv4DatagramDevice DeviceT>
+class TCPMinnowStack
+{
+  struct Connection;
+  struct ListenQueue;
+
+public:
+  //! The application's handle to one connection of the stack. Its methods may be called from any thread.
+  class Socket
+  {
+    TCPMinnowStack* stack_;
+    std::shared_ptr<Connection> connection_;
+
+    //! How much read() reads into an empty buffer
+    static constexpr size_t DEFAULT_READ_SIZE = 16384;
+
+    friend class TCPMinnowStack;
+    Socket( TCPMinnowStack& stack, std::shared_ptr<Connection> connection );
+
+  public:
+    //! Write some of `data` to the outbound stream; blocks until there is room for at least one byte
+    //! \returns the number of bytes written (0 once the connection can no longer send)
+    size_t write( std::string_view data );
+
+    //! Read up to `buffer.size()` bytes (16 KiB, if it is empty) into `buffer` (resized to fit them); blocks
+    //! until there are some, or the inbound stream has ended (then `buffer` is left empty)
+    void read( std::string& buffer );
+
+    //! Has the inbound stream ended (and been read to the end)?
+    bool eof() const;
+
+    //! Close the outbound stream (like `shutdown( SHUT_WR )`)
+    void shutdown_write();
+
+    //! Close the outbound stream, and wait for the connection to finish
+    void wait_until_closed();
+
+    //! Is the connection still active?
+    bool active() const;
+
+    //! The connection's addresses and ports
+    const TCPFourTuple& tuple() const;
+
+    //! Closing the handle closes the outbound stream, and discards anything that arrives afterwards
+    ~Socket();
+
+    Socket( Socket&& other ) noexcept = default;
+    Socket& operator=( Socket&& other ) noexcept = delete;
+    Socket( const Socket& other ) = delete;
+    Socket& operator=( const Socket& other ) = delete;
+  };
+
+  //! The application's handle to a listening port. Its methods may be called from any thread.
+  class Listener
+  {
+    TCPMinnowStack* stack_;
+    std::shared_ptr<ListenQueue> queue_;
+
+    friend class TCPMinnowStack;
+    Listener( TCPMinnowStack& stack, std::shared_ptr<ListenQueue> queue );
+
+  public:
+    //! What the listener has done with the SYNs it received
+    struct Stats
+    {
+      uint64_t syn_cookies_sent {};     //!< SYNs answered with a cookie, because the SYN queue was full
+      uint64_t syn_cookies_accepted {}; //!< Connections rebuilt from a cookie in the ACK that completed them
+      uint64_t syns_dropped {};         //!< SYNs ignored, because the accept queue (or SYN queue) was full
+      size_t half_open {};              //!< Connections in the SYN queue now
+      size_t queued {};                 //!< Established connections in the accept queue now
+    };
+
+    //! Wait for the next established connection, and take it from the accept queue
+    Socket accept();
+
+    //! Take the next established connection from the accept queue, if there is one (without waiting)
+    std::optional<Socket> try_accept();
+
+    Stats stats() const;
+
+    //! Stop listening (connections not yet accepted are closed)
+    ~Listener();
+
+    Listener( Listener&& other ) noexcept = default;
+    Listener& operator=( Listener&& other ) noexcept = delete;
+    Listener( const Listener& other ) = delete;
+    Listener& operator=( const Listener& other ) = delete;
+  };
+
+  //! Construct from the device that the stack's thread will read and write datagrams on, and start the thread
+  explicit TCPMinnowStack( DeviceT&& device );
+
+  //! Construct one shard of a ShardedTCPMinnowStack: it runs only the connections that `steering` assigns to
+  //! `shard`, and hands the segments it reads for other connections to their shards. Its thread is pinned to
+  //! `cpu`, if given.
+  TCPMinnowStack( DeviceT&& device,
+                  std::shared_ptr<FlowSteering> steering,
+                  size_t shard,
+                  std::optional<unsigned> cpu = {} );
+
+  //! Stop the stack's thread (connections still open are abandoned, so the Sockets must not outlive the stack)
+  ~TCPMinnowStack();
+
+  TCPMinnowStack( const TCPMinnowStack& other ) = delete;
+  TCPMinnowStack( TCPMinnowStack&& other ) = delete;
+  TCPMinnowStack& operator=( const TCPMinnowStack& other ) = delete;
+  TCPMinnowStack& operator=( TCPMinnowStack&& other ) = delete;
+
+  //! Open a connection from `source` (with port 0, an unused ephemeral port) to `destination`;
+  //! blocks until it is established, or throws if it fails
+  Socket connect( const TCPConfig& cfg, const Address& source, const Address& destination );
+
+  static constexpr size_t DEFAULT_BACKLOG = 128;
+
+  //! Accept connections to `address` (with IP address 0, to any of ours), each with `cfg`. At most `backlog`
+  //! connections may be half-open (the SYN queue), and at most `backlog` established ones may wait for accept()
+  //! (the accept queue). With `syn_cookies`, a SYN that finds the SYN queue full is answered with a SYN cookie.
+  Listener listen( const TCPConfig& cfg,
+                   const Address& address,
+                   size_t backlog = DEFAULT_BACKLOG,
+                   bool syn_cookies = true );
+
+  //! How many connections the stack is running (including ones that are not yet accepted, or lingering)
+  size_t connection_count() const;
+
+private:
+  //! A TCPPeer and its place in the stack
+  struct Connection
+  {
+    TCPFourTuple tuple;
+    size_t mss;
+    TCPPeer peer;
+    bool has_socket { true }; //!< Does the application still hold a Socket (or will it, once accepted)?
+    std::shared_ptr<ListenQueue> listener {}; //!< While in a listener's SYN queue: that listener
+    uint64_t last_tick {};                    //!< When the TCPPeer was last ticked (timestamp_ms())
+    std::optional<uint64_t> timer {};         //!< When its earliest timer in `timers_` is due
+    bool removed {};                          //!< Finished, and forgotten by the stack
+  };
+
+  //! A listening port, with its SYN queue (only counted: its connections are in `connections_`) and accept queue
+  struct ListenQueue
+  {
+    TCPConfig cfg;
+    uint32_t ip;
+    uint16_t port;
+    size_t backlog;
+    bool syn_cookies;
+    size_t half_open {};
+    std::deque<std::shared_ptr<Connection>> accepted {};
+    bool closed {};
+    typename Listener::Stats stats {};
+  };
+
+  DeviceT device_;
+
+  //! As a shard: the steering shared with the other shards, and this one's index
+  std::shared_ptr<FlowSteering> steering_;
+  size_t shard_;
+
+  //! Protects everything below (the stack's thread and the application's threads all drive the TCPPeers)
+  mutable std::mutex mutex_ {};
+
+  //! Notified whenever the connections may have changed, to wake up blocked Socket calls and accept()
+  std::condition_variable changed_ {};
+
+  std::unordered_map<TCPFourTuple, std::shared_ptr<Connection>, TCPFourTupleHash> connections_ {};
+  std::map<uint16_t, std::shared_ptr<ListenQueue>> listeners_ {}; //!< by port
+  SynCookieGenerator syn_cookies_ {};
+
+  static constexpr uint16_t EPHEMERAL_PORT_MIN = 49152;
+  uint16_t next_ephemeral_port_ { EPHEMERAL_PORT_MIN };
+
+  std::default_random_engine rand_; //!< initial sequence numbers
+
+  std::string headers_ {}; //!< Serialized headers of the datagram being written (storage is reused)
+
+  //! Datagrams read in one event-loop iteration, with their connections (storage is reused)
+  static constexpr size_t MAX_RECEIVE_BATCH = 64;
+  std::vector<TCPFourTuple> inbound_tuples_ {};
+  std::vector<TCPMessage> inbound_batch_ {};
+
+  //! The connections' next timers, by timestamp_ms(): only a connection with a timer due is ticked
+  TimerWheel<std::shared_ptr<Connection>> timers_ { timestamp_ms() };
+
+  EventLoop eventloop_ {};
+  std::atomic_bool abort_ { false };
+  std::thread thread_ {};
+
+  //! The `transmit` function of a connection: wrap its messages in IPv4 and write them to the device
+  auto transmit( const Connection& connection );
+
+  //! Add a connection with its own initial sequence number (random, unless given)
+  std::shared_ptr<Connection> add_connection( const TCPFourTuple& tuple,
+                                              TCPConfig cfg,
+                                              std::optional<Wrap32> isn = {} );
+
+  //! Is `tuple` one of this stack's connections (rather than another shard's)?
+  bool owns( const TCPFourTuple& tuple ) const { return not steering_ or steering_->shard_of( tuple ) == shard_; }
+
+  //! Read the datagrams that are waiting, and hand them to their connections (or their shards)
+  void receive_datagrams();
+
+  //! Take the segments that other shards have read for this one, and hand them to their connections
+  void receive_steered();
+
+  //! Hand the segments in `inbound_batch_` to their connections
+  void deliver_inbound();
+
+  //! Is another datagram ready to be read right away?
+  bool datagram_waiting();
+
+  //! Give a run of messages to the connection they belong to (opening it, if it is a SYN to a listener)
+  void deliver( const TCPFourTuple& tuple, std::span<TCPMessage> batch );
+
+  //! Open a passive connection for a segment with no connection, if a listener takes it
+  std::shared_ptr<Connection> open_passive( const TCPFourTuple& tuple, const TCPMessage& first );
+
+  //! Answer a SYN with a SYN-ACK whose sequence number is a cookie, without keeping any state
+  void send_syn_cookie( ListenQueue& queue, const TCPFourTuple& tuple, const TCPMessage& syn );
+
+  //! Rebuild the connection that an ACK completes, if it acknowledges a valid cookie
+  std::shared_ptr<Connection> open_from_cookie( ListenQueue& queue, const TCPFourTuple& tuple, const TCPMessage& ack );
+
+  //! Before any event: tick the connection for the time since it was last ticked
+  void catch_up( Connection& connection );
+
+  //! After any event: move an established connection to the accept queue, discard data nobody will read, and
+  //! schedule its next timer
+  void service( Connection& connection );
+
+  //! The application lets go of a connection: close its outbound stream, and discard what arrives from now on
+  void release( Connection& connection );
+
+  //! Tick the connections whose timers are due, and forget the ones that have finished
+  void expire_timers();
+
+  //! Main loop of the stack's thread
+  void loop();
+};
+
+using TCPOverIPv4MinnowStack = TCPMinnowStack<IPv4OverTunFdDevice>;
+
+//! \class TCPMinnowStack
+//! Where a TCPMinnowSocket is one connection with its own thread and datagram adapter, a TCPMinnowStack
+//! demultiplexes the datagrams of one device among any number of connections by their four-tuples, and runs
+//! all of them in one event loop on one thread.
+//!
+//! The application opens connections with connect(), or with listen() and the Listener's accept(), and uses the
+//! returned Sockets to read and write their streams. A Socket call works on its TCPPeer directly (under the
+//! stack's lock), so no thread or file descriptor is spent per connection. Nor is any time spent on an idle
+//! connection: the stack keeps each connection's next timer in a TimerWheel, and ticks only the connections
+//! whose timers are due.
+//!
+//! A listener bounds both its queues, like a kernel's: a SYN flood fills the SYN queue, after which SYNs are
+//! answered with SYN cookies and cost no memory until a handshake completes.
+//!
+//! A stack runs on one core; ShardedTCPMinnowStack spreads connections across several stacks (shards), one per
+//! core.
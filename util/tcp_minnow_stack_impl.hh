@@ -0,0 +1,590 @@
+#include "tcp_minnow_stack.hh"
+
+#include "exception.hh"
+#include "random.hh"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+template<IPv4DatagramDevice DeviceT>
+TCPMinnowStack<DeviceT>::TCPMinnowStack( DeviceT&& device ) : TCPMinnowStack( std::move( device ), nullptr, 0 )
+{}
+
+template<IPv4DatagramDevice DeviceT>
+TCPMinnowStack<DeviceT>::TCPMinnowStack( DeviceT&& device,
+                                         std::shared_ptr<FlowSteering> steering,
+                                         size_t shard,
+                                         std::optional<unsigned> cpu )
+  : device_( std::move( device ) ), steering_( std::move( steering ) ), shard_( shard ), rand_( get_random_engine() )
+{
+  eventloop_.add_rule( "receive datagrams", device_.fd(), Direction::In, [&] { receive_datagrams(); } );
+  if ( steering_ ) {
+    eventloop_.add_rule(
+      "receive steered segments", steering_->inbox_ready( shard_ ), Direction::In, [&] { receive_steered(); } );
+  }
+  thread_ = std::thread( &TCPMinnowStack::loop, this );
+
+  if ( cpu.has_value() ) {
+    cpu_set_t cpus;
+    CPU_ZERO( &cpus );
+    CPU_SET( cpu.value(), &cpus );
+    if ( const int err = pthread_setaffinity_np( thread_.native_handle(), sizeof( cpus ), &cpus ); err != 0 ) {
+      abort_.store( true );
+      thread_.join();
+      throw unix_error( "pthread_setaffinity_np", err );
+    }
+  }
+}
+
+template<IPv4DatagramDevice DeviceT>
+TCPMinnowStack<DeviceT>::~TCPMinnowStack()
+{
+  try {
+    abort_.store( true );
+    if ( thread_.joinable() ) {
+      thread_.join();
+    }
+  } catch ( const std::exception& e ) {
+    std::cerr << "Exception destructing TCPMinnowStack: " << e.what() << "\n";
+  }
+}
+
+template<IPv4DatagramDevice DeviceT>
+auto TCPMinnowStack<DeviceT>::transmit( const Connection& connection )
+{
+  return [this, &connection]( std::span<const TCPMessage> batch ) {
+    for ( const auto& msg : batch ) {
+      TCPOverIPv4Adapter::segment_tcp_in_ip(
+        connection.tuple, connection.mss, msg, headers_, [&]( std::string_view headers, std::string_view payload ) {
+          device_.write( headers, payload );
+        } );
+    }
+  };
+}
+
+//! \details Each connection starts from a random initial sequence number, so that segments of an earlier
+//! connection with the same four-tuple are unlikely to fall into its window.
+template<IPv4DatagramDevice DeviceT>
+std::shared_ptr<typename TCPMinnowStack<DeviceT>::Connection>
+TCPMinnowStack<DeviceT>::add_connection( const TCPFourTuple& tuple, TCPConfig cfg, std::optional<Wrap32> isn )
+{
+  cfg.isn = isn.value_or( Wrap32 { static_cast<uint32_t>( rand_() ) } );
+  auto connection = std::make_shared<Connection>( tuple, cfg.mss, TCPPeer { cfg } );
+  connection->last_tick = timestamp_ms();
+  connections_.emplace( tuple, connection );
+  return connection;
+}
+
+template<IPv4DatagramDevice DeviceT>
+typename TCPMinnowStack<DeviceT>::Socket
+TCPMinnowStack<DeviceT>::connect( const TCPConfig& cfg, const Address& source, const Address& destination )
+{
+  TCPFourTuple tuple { .local_ip = source.ipv4_numeric(),
+                       .remote_ip = destination.ipv4_numeric(),
+                       .local_port = source.port(),
+                       .remote_port = destination.port() };
+
+  std::unique_lock lock { mutex_ };
+  if ( tuple.local_port == 0 ) {
+    // Find an ephemeral port that no connection to this destination is using (and, as a shard, one that makes
+    // the connection this shard's, so that its segments need not be handed over).
+    for ( size_t tries = 0; tries <= UINT16_MAX - EPHEMERAL_PORT_MIN; tries++ ) {
+      tuple.local_port = next_ephemeral_port_;
+      next_ephemeral_port_ = next_ephemeral_port_ == UINT16_MAX ? EPHEMERAL_PORT_MIN : next_ephemeral_port_ + 1;
+      if ( owns( tuple ) and not connections_.contains( tuple ) ) {
+        break;
+      }
+    }
+  }
+  if ( not owns( tuple ) ) {
+    throw std::invalid_argument( "TCPMinnowStack::connect(): connection belongs to another shard" );
+  }
+  if ( connections_.contains( tuple ) ) {
+    throw std::runtime_error( "TCPMinnowStack::connect(): no free port to connect to " + destination.to_string() );
+  }
+
+  auto connection = add_connection( tuple, cfg );
+  connection->peer.push( transmit( *connection ) );
+  service( *connection );
+  changed_.wait( lock, [&] { return connection->peer.has_ackno() or not connection->peer.active(); } );
+  if ( not connection->peer.has_ackno() ) {
+    throw std::runtime_error( "TCPMinnowStack::connect(): connection to " + destination.to_string() + " failed" );
+  }
+  return Socket { *this, std::move( connection ) };
+}
+
+template<IPv4DatagramDevice DeviceT>
+typename TCPMinnowStack<DeviceT>::Listener
+TCPMinnowStack<DeviceT>::listen( const TCPConfig& cfg, const Address& address, size_t backlog, bool syn_cookies )
+{
+  if ( backlog == 0 ) {
+    throw std::invalid_argument( "TCPMinnowStack::listen(): backlog must be positive" );
+  }
+  auto queue = std::make_shared<ListenQueue>( cfg, address.ipv4_numeric(), address.port(), backlog, syn_cookies );
+  const std::scoped_lock lock { mutex_ };
+  if ( not listeners_.try_emplace( address.port(), queue ).second ) {
+    throw std::runtime_error( "TCPMinnowStack::listen(): already listening on port "
+                              + std::to_string( address.port() ) );
+  }
+  return Listener { *this, std::move( queue ) };
+}
+
+template<IPv4DatagramDevice DeviceT>
+size_t TCPMinnowStack<DeviceT>::connection_count() const
+{
+  const std::scoped_lock lock { mutex_ };
+  return connections_.size();
+}
+
+//! \returns true if another datagram can be read right away (checked without blocking)
+template<IPv4DatagramDevice DeviceT>
+bool TCPMinnowStack<DeviceT>::datagram_waiting()
+{
+  pollfd waiting { .fd = device_.fd().fd_num(), .events = POLLIN, .revents = 0 };
+  return CheckSystemCall( "poll", ::poll( &waiting, 1, 0 ) ) > 0 and ( waiting.revents & POLLIN ); // NOLINT(*-bitwise)
+}
+
+//! \details Drains the burst of datagrams already waiting (without holding the lock), then delivers them. As a
+//! shard, a segment for another shard's connection goes straight to that shard.
+template<IPv4DatagramDevice DeviceT>
+void TCPMinnowStack<DeviceT>::receive_datagrams()
+{
+  inbound_tuples_.clear();
+  inbound_batch_.clear();
+  size_t received = 0;
+  do {
+    if ( auto dgram = device_.read() ) {
+      TCPFourTuple tuple;
+      if ( auto msg = TCPOverIPv4Adapter::unwrap_tcp_in_ip( std::move( dgram.value() ), tuple ) ) {
+        if ( owns( tuple ) ) {
+          inbound_tuples_.push_back( tuple );
+          inbound_batch_.push_back( std::move( msg.value() ) );
+        } else {
+          steering_->steer( steering_->shard_of( tuple ), tuple, std::move( msg.value() ) );
+        }
+      }
+    }
+  } while ( ++received < MAX_RECEIVE_BATCH and datagram_waiting() );
+
+  deliver_inbound();
+}
+
+template<IPv4DatagramDevice DeviceT>
+void TCPMinnowStack<DeviceT>::receive_steered()
+{
+  inbound_tuples_.clear();
+  inbound_batch_.clear();
+  steering_->take( shard_, inbound_tuples_, inbound_batch_ );
+  deliver_inbound();
+}
+
+//! \details Delivers each run of consecutive messages for the same connection together, so that the TCPPeer
+//! can coalesce them.
+template<IPv4DatagramDevice DeviceT>
+void TCPMinnowStack<DeviceT>::deliver_inbound()
+{
+  if ( inbound_batch_.empty() ) {
+    return;
+  }
+  const std::scoped_lock lock { mutex_ };
+  for ( size_t i = 0; i < inbound_batch_.size(); ) {
+    size_t next = i + 1;
+    while ( next < inbound_batch_.size() and inbound_tuples_[next] == inbound_tuples_[i] ) {
+      ++next;
+    }
+    deliver( inbound_tuples_[i], std::span { inbound_batch_ }.subspan( i, next - i ) );
+    i = next;
+  }
+  changed_.notify_all();
+}
+
+template<IPv4DatagramDevice DeviceT>
+void TCPMinnowStack<DeviceT>::deliver( const TCPFourTuple& tuple, std::span<TCPMessage> batch )
+{
+  auto it = connections_.find( tuple );
+  if ( it == connections_.end() ) {
+    // (a segment that opens nothing is dropped on its own, not with the rest of its run)
+    while ( not batch.empty() and not open_passive( tuple, batch.front() ) ) {
+      batch = batch.subspan( 1 );
+    }
+    if ( batch.empty() ) {
+      return;
+    }
+    it = connections_.find( tuple );
+  }
+
+  Connection& connection = *it->second;
+  catch_up( connection );
+  connection.peer.receive_batch( batch, transmit( connection ) );
+  service( connection );
+}
+
+//! \details A segment for no known connection is dropped, unless it is for a listener's port and address:
+//!
+//! - A SYN opens a half-open connection in the SYN queue, which moves to the accept queue once it is
+//!   established. If the accept queue is full, the SYN is dropped (the client will retry it); if only the
+//!   SYN queue is, it is answered with a SYN cookie instead.
+//! - An ACK that acknowledges a SYN cookie opens the connection that the cookie stands for.
+template<IPv4DatagramDevice DeviceT>
+std::shared_ptr<typename TCPMinnowStack<DeviceT>::Connection>
+TCPMinnowStack<DeviceT>::open_passive( const TCPFourTuple& tuple, const TCPMessage& first )
+{
+  const auto listener = listeners_.find( tuple.local_port );
+  if ( listener == listeners_.end() or first.sender->RST or first.receiver->RST ) {
+    return {};
+  }
+  ListenQueue& queue = *listener->second;
+  if ( queue.ip != 0 and queue.ip != tuple.local_ip ) {
+    return {};
+  }
+
+  if ( first.sender->SYN and not first.receiver->ackno.has_value() ) {
+    if ( queue.accepted.size() >= queue.backlog or ( queue.half_open >= queue.backlog and not queue.syn_cookies ) ) {
+      ++queue.stats.syns_dropped;
+      return {};
+    }
+    if ( queue.half_open >= queue.backlog ) {
+      send_syn_cookie( queue, tuple, first );
+      return {};
+    }
+    auto connection = add_connection( tuple, queue.cfg );
+    connection->listener = listener->second;
+    ++queue.half_open;
+    return connection;
+  }
+
+  if ( queue.syn_cookies and not first.sender->SYN and first.receiver->ackno.has_value()
+       and queue.accepted.size() < queue.backlog ) {
+    return open_from_cookie( queue, tuple, first );
+  }
+  return {};
+}
+
+template<IPv4DatagramDevice DeviceT>
+void TCPMinnowStack<DeviceT>::send_syn_cookie( ListenQueue& queue, const TCPFourTuple& tuple, const TCPMessage& syn )
+{
+  ++queue.stats.syn_cookies_sent;
+  const bool ecn = queue.cfg.ecn and syn.sender->CWR and syn.receiver->ECE;
+  const Wrap32 isn = syn_cookies_.cookie( tuple, syn.sender->seqno, ecn, timestamp_ms() );
+  const auto window = static_cast<uint16_t>( std::min<size_t>( queue.cfg.recv_capacity, UINT16_MAX ) );
+  const TCPMessage syn_ack { TCPSenderMessage { .seqno = isn, .SYN = true },
+                             TCPReceiverMessage { .ackno = syn.sender->seqno + 1, .window_size = window, .ECE = ecn } };
+  TCPOverIPv4Adapter::segment_tcp_in_ip(
+    tuple, queue.cfg.mss, syn_ack, headers_, [&]( std::string_view headers, std::string_view payload ) {
+      device_.write( headers, payload );
+    } );
+}
+
+//! \details The cookie only vouches for the four-tuple, the client's initial sequence number and whether the
+//! client asked for ECN; anything else its SYN carried (such as a Fast Open cookie, or data) is lost. The
+//! connection starts from a replay of that SYN, which brings it to where it would be after sending the SYN-ACK.
+template<IPv4DatagramDevice DeviceT>
+std::shared_ptr<typename TCPMinnowStack<DeviceT>::Connection>
+TCPMinnowStack<DeviceT>::open_from_cookie( ListenQueue& queue, const TCPFourTuple& tuple, const TCPMessage& ack )
+{
+  const Wrap32 client_isn = ack.sender->seqno + UINT32_MAX;
+  const Wrap32 isn = ack.receiver->ackno.value() + UINT32_MAX;
+  const auto ecn = syn_cookies_.check( tuple, client_isn, isn, timestamp_ms() );
+  if ( not ecn.has_value() ) {
+    return {};
+  }
+  ++queue.stats.syn_cookies_accepted;
+
+  TCPConfig cfg = queue.cfg;
+  cfg.ecn = cfg.ecn and ecn.value();
+  auto connection = add_connection( tuple, cfg, isn );
+  connection->listener = listeners_.at( queue.port );
+  ++queue.half_open;
+
+  TCPMessage syn { TCPSenderMessage { .seqno = client_isn, .SYN = true, .CWR = ecn.value() },
+                   TCPReceiverMessage { .window_size = ack.receiver->window_size, .ECE = ecn.value() } };
+  connection->peer.receive( std::move( syn ), []( std::span<const TCPMessage> ) {} ); // its SYN-ACK was sent
+  return connection;
+}
+
+//! \details A connection leaves the SYN queue once it is established and has either acknowledged the SYN-ACK
+//! or sent data. If the accept queue is full, it stays in the SYN queue, and is tried again after TCP_TICK_MS.
+template<IPv4DatagramDevice DeviceT>
+void TCPMinnowStack<DeviceT>::service( Connection& connection )
+{
+  TCPPeer& peer = connection.peer;
+  bool awaiting_room = false;
+  if ( connection.listener and peer.has_ackno()
+       and ( peer.sender().sequence_numbers_in_flight() == 0 or peer.inbound_reader().bytes_buffered() > 0 ) ) {
+    ListenQueue& queue = *connection.listener;
+    awaiting_room = not queue.closed and queue.accepted.size() >= queue.backlog;
+    if ( not awaiting_room ) {
+      --queue.half_open;
+      connection.listener.reset();
+      if ( queue.closed ) {
+        release( connection );
+      } else {
+        queue.accepted.push_back( connections_.at( connection.tuple ) );
+      }
+    }
+  }
+
+  if ( not connection.has_socket and peer.inbound_reader().bytes_buffered() > 0 ) {
+    peer.inbound_reader().pop( peer.inbound_reader().bytes_buffered() );
+    peer.send_window_update( transmit( connection ) );
+  }
+
+  // A connection that has finished gets a timer at once, to be forgotten. Otherwise, an earlier timer than the
+  // one already scheduled replaces it (the later one will be skipped), and a later one waits: when the earlier
+  // one is due, the connection is ticked (with nothing to do yet) and schedules it then.
+  if ( connection.removed ) {
+    return;
+  }
+  std::optional<uint64_t> delay = peer.active() ? peer.ms_until_next_timer() : 0;
+  if ( awaiting_room ) {
+    delay = std::min( delay.value_or( TCP_TICK_MS ), TCP_TICK_MS );
+  }
+  if ( not delay.has_value() ) {
+    return;
+  }
+  const uint64_t when = connection.last_tick + delay.value();
+  if ( connection.timer.has_value() and connection.timer.value() <= when ) {
+    return;
+  }
+  connection.timer = when;
+  timers_.schedule( when, connections_.at( connection.tuple ) );
+}
+
+//! \details The stack's thread ticks a connection only when one of its timers is due, so its TCPPeer's clock
+//! lags behind; it is brought up to date before the connection handles anything else, so that the timers that
+//! start then count from the right time.
+template<IPv4DatagramDevice DeviceT>
+void TCPMinnowStack<DeviceT>::catch_up( Connection& connection )
+{
+  const uint64_t now = timestamp_ms();
+  if ( not connection.removed and now > connection.last_tick ) {
+    connection.peer.tick( now - connection.last_tick, transmit( connection ) );
+    connection.last_tick = now;
+  }
+}
+
+template<IPv4DatagramDevice DeviceT>
+void TCPMinnowStack<DeviceT>::release( Connection& connection )
+{
+  connection.has_socket = false;
+  TCPPeer& peer = connection.peer;
+  if ( peer.active() and not peer.outbound_writer().is_closed() ) {
+    catch_up( connection );
+    peer.outbound_writer().close();
+    peer.push( transmit( connection ) );
+  }
+}
+
+//! \details A timer may be due for a connection that has since scheduled an earlier one (see service()), or has
+//! finished; those are skipped. A connection that has finished is forgotten.
+template<IPv4DatagramDevice DeviceT>
+void TCPMinnowStack<DeviceT>::expire_timers()
+{
+  const std::scoped_lock lock { mutex_ };
+  timers_.advance( timestamp_ms(), [&]( uint64_t when, const std::shared_ptr<Connection>& connection ) {
+    if ( connection->removed or connection->timer != when ) {
+      return;
+    }
+    connection->timer.reset();
+    if ( connection->peer.active() ) {
+      catch_up( *connection );
+      service( *connection );
+    }
+    if ( not connection->peer.active() ) {
+      if ( connection->listener ) {
+        --connection->listener->half_open; // the handshake failed
+      }
+      connection->removed = true;
+      connections_.erase( connection->tuple );
+    }
+  } );
+  changed_.notify_all();
+}
+
+template<IPv4DatagramDevice DeviceT>
+void TCPMinnowStack<DeviceT>::loop()
+{
+  try {
+    while ( not abort_ ) {
+      if ( eventloop_.wait_next_event( TCP_TICK_MS ) == EventLoop::Result::Exit ) {
+        break;
+      }
+      expire_timers();
+    }
+  } catch ( const std::exception& e ) {
+    std::cerr << "Exception in TCPMinnowStack thread: " << e.what() << "\n";
+    throw;
+  }
+}
+
+template<IPv4DatagramDevice DeviceT>
+TCPMinnowStack<DeviceT>::Socket::Socket( TCPMinnowStack& stack, std::shared_ptr<Connection> connection )
+  : stack_( &stack ), connection_( std::move( connection ) )
+{}
+
+template<IPv4DatagramDevice DeviceT>
+size_t TCPMinnowStack<DeviceT>::Socket::write( std::string_view data )
+{
+  std::unique_lock lock { stack_->mutex_ };
+  TCPPeer& peer = connection_->peer;
+  Writer& outbound = peer.outbound_writer();
+  stack_->changed_.wait( lock, [&] {
+    return outbound.available_capacity() > 0 or outbound.is_closed() or outbound.has_error() or not peer.active();
+  } );
+  if ( outbound.is_closed() or outbound.has_error() or not peer.active() ) {
+    return 0;
+  }
+
+  const size_t len = std::min<size_t>( data.size(), outbound.available_capacity() );
+  stack_->catch_up( *connection_ );
+  outbound.push( data.substr( 0, len ) );
+  peer.push( stack_->transmit( *connection_ ) );
+  stack_->service( *connection_ );
+  return len;
+}
+
+template<IPv4DatagramDevice DeviceT>
+void TCPMinnowStack<DeviceT>::Socket::read( std::string& buffer )
+{
+  if ( buffer.empty() ) {
+    buffer.resize( DEFAULT_READ_SIZE );
+  }
+
+  std::unique_lock lock { stack_->mutex_ };
+  TCPPeer& peer = connection_->peer;
+  Reader& inbound = peer.inbound_reader();
+  stack_->changed_.wait( lock, [&] {
+    return inbound.bytes_buffered() > 0 or inbound.is_finished() or inbound.has_error() or not peer.active();
+  } );
+
+  const uint64_t max_len = buffer.size();
+  ::read( inbound, max_len, buffer );
+  if ( not buffer.empty() ) {
+    stack_->catch_up( *connection_ );
+    peer.send_window_update( stack_->transmit( *connection_ ) );
+    stack_->service( *connection_ );
+  }
+}
+
+template<IPv4DatagramDevice DeviceT>
+bool TCPMinnowStack<DeviceT>::Socket::eof() const
+{
+  const std::scoped_lock lock { stack_->mutex_ };
+  const TCPPeer& peer = connection_->peer;
+  const Reader& inbound = peer.receiver().reader();
+  return inbound.is_finished() or inbound.has_error() or ( not peer.active() and inbound.bytes_buffered() == 0 );
+}
+
+template<IPv4DatagramDevice DeviceT>
+void TCPMinnowStack<DeviceT>::Socket::shutdown_write()
+{
+  const std::scoped_lock lock { stack_->mutex_ };
+  TCPPeer& peer = connection_->peer;
+  if ( peer.active() and not peer.outbound_writer().is_closed() ) {
+    stack_->catch_up( *connection_ );
+    peer.outbound_writer().close();
+    peer.push( stack_->transmit( *connection_ ) );
+    stack_->service( *connection_ );
+  }
+}
+
+template<IPv4DatagramDevice DeviceT>
+void TCPMinnowStack<DeviceT>::Socket::wait_until_closed()
+{
+  shutdown_write();
+  std::unique_lock lock { stack_->mutex_ };
+  stack_->changed_.wait( lock, [&] { return not connection_->peer.active(); } );
+}
+
+template<IPv4DatagramDevice DeviceT>
+bool TCPMinnowStack<DeviceT>::Socket::active() const
+{
+  const std::scoped_lock lock { stack_->mutex_ };
+  return connection_->peer.active();
+}
+
+template<IPv4DatagramDevice DeviceT>
+const TCPFourTuple& TCPMinnowStack<DeviceT>::Socket::tuple() const
+{
+  return connection_->tuple;
+}
+
+template<IPv4DatagramDevice DeviceT>
+TCPMinnowStack<DeviceT>::Socket::~Socket()
+{
+  if ( not connection_ ) {
+    return;
+  }
+  try {
+    const std::scoped_lock lock { stack_->mutex_ };
+    stack_->release( *connection_ );
+    stack_->service( *connection_ );
+  } catch ( const std::exception& e ) {
+    std::cerr << "Exception destructing TCPMinnowStack::Socket: " << e.what() << "\n";
+  }
+}
+
+template<IPv4DatagramDevice DeviceT>
+TCPMinnowStack<DeviceT>::Listener::Listener( TCPMinnowStack& stack, std::shared_ptr<ListenQueue> queue )
+  : stack_( &stack ), queue_( std::move( queue ) )
+{}
+
+template<IPv4DatagramDevice DeviceT>
+typename TCPMinnowStack<DeviceT>::Socket TCPMinnowStack<DeviceT>::Listener::accept()
+{
+  std::unique_lock lock { stack_->mutex_ };
+  stack_->changed_.wait( lock, [&] { return not queue_->accepted.empty(); } );
+  auto connection = std::move( queue_->accepted.front() );
+  queue_->accepted.pop_front();
+  return Socket { *stack_, std::move( connection ) };
+}
+
+template<IPv4DatagramDevice DeviceT>
+std::optional<typename TCPMinnowStack<DeviceT>::Socket> TCPMinnowStack<DeviceT>::Listener::try_accept()
+{
+  const std::scoped_lock lock { stack_->mutex_ };
+  if ( queue_->accepted.empty() ) {
+    return {};
+  }
+  auto connection = std::move( queue_->accepted.front() );
+  queue_->accepted.pop_front();
+  return Socket { *stack_, std::move( connection ) };
+}
+
+template<IPv4DatagramDevice DeviceT>
+typename TCPMinnowStack<DeviceT>::Listener::Stats TCPMinnowStack<DeviceT>::Listener::stats() const
+{
+  const std::scoped_lock lock { stack_->mutex_ };
+  Stats stats = queue_->stats;
+  stats.half_open = queue_->half_open;
+  stats.queued = queue_->accepted.size();
+  return stats;
+}
+
+//! \details Half-open connections are left to finish their handshakes, and then closed.
+template<IPv4DatagramDevice DeviceT>
+TCPMinnowStack<DeviceT>::Listener::~Listener()
+{
+  if ( not queue_ ) {
+    return;
+  }
+  try {
+    const std::scoped_lock lock { stack_->mutex_ };
+    queue_->closed = true;
+    stack_->listeners_.erase( queue_->port );
+    for ( const auto& connection : queue_->accepted ) {
+      stack_->release( *connection );
+      stack_->service( *connection );
+    }
+    queue_->accepted.clear();
+  } catch ( const std::exception& e ) {
+    std::cerr << "Exception destructing TCPMinnowStack::Listener: " << e.what() << "\n";
+  }
+}
@@ -1,5 +1,6 @@
 #include "tcp_over_ip.hh"
 
+#include "checksum.hh"
 #include "helpers.hh"
 #include "ipv4_datagram.hh"
 #include "ipv4_header.hh"
@@ -35,28 +36,22 @@ optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( InternetDatagram ip_d
     return {};
   }
 
-  // does the IPv4 datagram claim that its payload is a TCP segment?
-  if ( ip_dgram.header.proto != IPv4Header::PROTO_TCP ) {
-    return {};
-  }
-
-  // is the payload a valid TCP segment?
-  TCPSegment tcp_seg;
-  if ( not parse( tcp_seg, move( ip_dgram.payload ), ip_dgram.header.pseudo_checksum() ) ) {
+  TCPFourTuple tuple;
+  auto msg = unwrap_tcp_in_ip( move( ip_dgram ), tuple );
+  if ( not msg.has_value() ) {
     return {};
   }
 
   // is the TCP segment for us?
-  if ( tcp_seg.udinfo.dst_port != config().source.port() ) {
+  if ( tuple.local_port != config().source.port() ) {
     return {};
   }
 
   // should we target this source addr/port (and use its destination addr as our source) in reply?
   if ( listening() ) {
-    if ( tcp_seg.message.sender->SYN and not tcp_seg.message.sender->RST ) {
-      config_mutable().source = Address { inet_ntoa( { htobe32( ip_dgram.header.dst ) } ), config().source.port() };
-      config_mutable().destination
-        = Address { inet_ntoa( { htobe32( ip_dgram.header.src ) } ), tcp_seg.udinfo.src_port };
+    if ( msg->sender->SYN and not msg->sender->RST ) {
+      config_mutable().source = Address { inet_ntoa( { htobe32( tuple.local_ip ) } ), config().source.port() };
+      config_mutable().destination = Address { inet_ntoa( { htobe32( tuple.remote_ip ) } ), tuple.remote_port };
       set_listening( false );
     } else {
       return {};
@@ -64,13 +59,47 @@ optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( InternetDatagram ip_d
   }
 
   // is the TCP segment from our peer?
-  if ( tcp_seg.udinfo.src_port != config().destination.port() ) {
+  if ( tuple.remote_port != config().destination.port() ) {
     return {};
   }
 
+  return msg;
+}
+
+//! \details Only checks that the datagram carries a valid TCP segment; which connection (if any) it belongs to
+//! is up to the caller, from `tuple`.
+optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( InternetDatagram ip_dgram, TCPFourTuple& tuple )
+{
+  // does the IPv4 datagram claim that its payload is a TCP segment?
+  if ( ip_dgram.header.proto != IPv4Header::PROTO_TCP ) {
+    return {};
+  }
+
+  // is the payload a valid TCP segment?
+  TCPSegment tcp_seg;
+  if ( not parse( tcp_seg, move( ip_dgram.payload ), ip_dgram.header.pseudo_checksum() ) ) {
+    return {};
+  }
+
+  tuple = { .local_ip = ip_dgram.header.dst,
+            .remote_ip = ip_dgram.header.src,
+            .local_port = tcp_seg.udinfo.dst_port,
+            .remote_port = tcp_seg.udinfo.src_port };
+
+  // the ECN field (e.g. a router's Congestion Experienced mark) is passed up with the message
+  tcp_seg.message.sender->ecn = ip_dgram.header.ecn();
+
   return move( tcp_seg.message );
 }
 
+TCPFourTuple TCPOverIPv4Adapter::config_tuple() const
+{
+  return { .local_ip = config().source.ipv4_numeric(),
+           .remote_ip = config().destination.ipv4_numeric(),
+           .local_port = config().source.port(),
+           .remote_port = config().destination.port() };
+}
+
 //! Takes a TCP segment, sets port numbers as necessary, and wraps it in an IPv4 datagram
 //! \param[in] seg is the TCP segment to convert
 InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( const TCPMessage& msg )
@@ -85,7 +114,9 @@ InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( const TCPMessage& msg )
   InternetDatagram ip_dgram;
   ip_dgram.header.src = config().source.ipv4_numeric();
   ip_dgram.header.dst = config().destination.ipv4_numeric();
-  ip_dgram.header.len = ip_dgram.header.hlen * 4 + 20 /* tcp header len */ + payload_size;
+  ip_dgram.header.len = ip_dgram.header.hlen * 4 + seg.header_length() + payload_size;
+
+  ip_dgram.header.set_ecn( msg.sender->ecn );
 
   // set payload, calculating TCP checksum using information from IP header
   seg.compute_checksum( ip_dgram.header.pseudo_checksum() );
@@ -94,3 +125,96 @@ InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( const TCPMessage& msg )
 
   return ip_dgram;
 }
+
+//! \details Unlike the version above, this serializes each header once, computes both checksums directly
+//! from the serialized bytes, and never copies the payload, so it does not allocate once `headers` has grown
+//! to its final size.
+//! \param[in] msg is the TCP message to convert
+//! \param[out] headers receives the IPv4 header followed by the TCP header
+void TCPOverIPv4Adapter::wrap_tcp_in_ip( const TCPMessage& msg, std::string& headers )
+{
+  wrap_headers( config_tuple(), msg.sender.get(), msg.receiver.get(), msg.sender->payload, headers );
+}
+
+//! \details The receiver half (ackno and window) is shared by every piece; the SYN stays on the first piece and
+//! the FIN moves to the last. The pieces' payloads are slices of the original, so nothing is copied.
+void TCPOverIPv4Adapter::segment_tcp_in_ip( const TCPMessage& msg,
+                                            std::string& headers,
+                                            const FunctionRef<void( std::string_view, std::string_view )>& emit )
+{
+  segment_tcp_in_ip( config_tuple(), config().mss, msg, headers, emit );
+}
+
+void TCPOverIPv4Adapter::segment_tcp_in_ip( const TCPFourTuple& tuple,
+                                            size_t mss,
+                                            const TCPMessage& msg,
+                                            std::string& headers,
+                                            const FunctionRef<void( std::string_view, std::string_view )>& emit )
+{
+  const string_view payload = msg.sender->payload;
+  if ( payload.size() <= mss or mss == 0 ) {
+    wrap_headers( tuple, msg.sender.get(), msg.receiver.get(), payload, headers );
+    emit( headers, payload );
+    return;
+  }
+
+  TCPSenderMessage piece {};
+  for ( size_t offset = 0; offset < payload.size(); offset += mss ) {
+    const string_view slice = payload.substr( offset, mss );
+    // the SYN (if any) occupies the first piece's seqno, and payload byte `offset` follows it
+    piece.SYN = msg.sender->SYN and offset == 0;
+    piece.seqno = msg.sender->seqno + static_cast<uint32_t>( offset == 0 ? 0 : msg.sender->SYN + offset );
+    piece.FIN = msg.sender->FIN and offset + slice.size() == payload.size();
+    piece.RST = msg.sender->RST;
+    piece.CWR = msg.sender->CWR and offset == 0;
+    piece.ecn = msg.sender->ecn;
+    if ( offset == 0 ) {
+      piece.fast_open = msg.sender->fast_open;
+    } else {
+      piece.fast_open.reset();
+    }
+    wrap_headers( tuple, piece, msg.receiver.get(), slice, headers );
+    emit( headers, slice );
+  }
+}
+
+//! Serialize the IPv4 and TCP headers of a datagram carrying `payload` (which replaces the sender message's own)
+void TCPOverIPv4Adapter::wrap_headers( const TCPFourTuple& tuple,
+                                       const TCPSenderMessage& sender,
+                                       const TCPReceiverMessage& receiver,
+                                       std::string_view payload,
+                                       std::string& headers )
+{
+  TCPSegment seg { .message = { .sender = Ref<TCPSenderMessage>::borrow( sender ),
+                                 .receiver = Ref<TCPReceiverMessage>::borrow( receiver ) } };
+  seg.udinfo.src_port = tuple.local_port;
+  seg.udinfo.dst_port = tuple.remote_port;
+  seg.udinfo.cksum = 0;
+
+  IPv4Header ip_header;
+  ip_header.src = tuple.local_ip;
+  ip_header.dst = tuple.remote_ip;
+  ip_header.len = ip_header.hlen * 4 + seg.header_length() + payload.size();
+  ip_header.set_ecn( sender.ecn );
+  ip_header.cksum = 0;
+
+  Serializer serializer { move( headers ) };
+  ip_header.serialize( serializer );
+  seg.serialize_header( serializer );
+  headers = serializer.finish_contiguous();
+
+  // fill in the checksums in place (IPv4: bytes 10-11 of the header, TCP: bytes 16-17 of its header)
+  const auto store = [&]( size_t offset, uint16_t value ) {
+    headers[offset] = static_cast<char>( value >> 8 );
+    headers[offset + 1] = static_cast<char>( value & 0xff );
+  };
+
+  InternetChecksum tcp_check { ip_header.pseudo_checksum() };
+  tcp_check.add( string_view { headers }.substr( IPv4Header::LENGTH ) );
+  tcp_check.add( payload );
+  store( IPv4Header::LENGTH + 16, tcp_check.value() );
+
+  InternetChecksum ip_check;
+  ip_check.add( string_view { headers }.substr( 0, IPv4Header::LENGTH ) );
+  store( 10, ip_check.value() );
+}
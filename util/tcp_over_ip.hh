@@ -1,10 +1,41 @@
 #pragma once
 
 #include "fd_adapter.hh"
+#include "function_ref.hh"
 #include "ipv4_datagram.hh"
 #include "tcp_segment.hh"
 
+#include <cstdint>
 #include <optional>
+#include <string>
+#include <string_view>
+
+//! \brief The addresses and ports that identify one TCP connection, seen from our end
+struct TCPFourTuple
+{
+  uint32_t local_ip {};
+  uint32_t remote_ip {};
+  uint16_t local_port {};
+  uint16_t remote_port {};
+
+  bool operator==( const TCPFourTuple& other ) const = default;
+
+  //! A well-mixed hash of all four fields (to look up connections, or to spread them across shards)
+  uint64_t hash() const
+  {
+    uint64_t x = ( static_cast<uint64_t>( local_ip ) << 32 | remote_ip )
+                 ^ ( static_cast<uint64_t>( local_port ) << 16 | remote_port ) * 0x9e3779b97f4a7c15;
+    x = ( x ^ ( x >> 30 ) ) * 0xbf58476d1ce4e5b9;
+    x = ( x ^ ( x >> 27 ) ) * 0x94d049bb133111eb;
+    return x ^ ( x >> 31 );
+  }
+};
+
+//! Hash function object for unordered containers keyed by TCPFourTuple
+struct TCPFourTupleHash
+{
+  size_t operator()( const TCPFourTuple& tuple ) const { return tuple.hash(); }
+};
 
 //! \brief A converter from TCP segments to serialized IPv4 datagrams
 class TCPOverIPv4Adapter : public FdAdapterBase
@@ -12,5 +43,37 @@ class TCPOverIPv4Adapter : public FdAdapterBase
 public:
   std::optional<TCPMessage> unwrap_tcp_in_ip( InternetDatagram ip_dgram );
 
+  //! Parse the TCP segment in any IPv4 datagram (not just one for the configured connection), and return it
+  //! with the four-tuple of the connection it belongs to, as seen from the receiving end
+  static std::optional<TCPMessage> unwrap_tcp_in_ip( InternetDatagram ip_dgram, TCPFourTuple& tuple );
+
   InternetDatagram wrap_tcp_in_ip( const TCPMessage& msg );
+
+  //! Serialize just the IPv4 and TCP headers (with both checksums) into `headers`, reusing its storage.
+  //! The datagram on the wire is `headers` followed by the message's payload.
+  void wrap_tcp_in_ip( const TCPMessage& msg, std::string& headers );
+
+  //! Segmentation offload: like the above, but a payload longer than config().mss is cut into mss-sized
+  //! wire segments, each with its own seqno, flags and checksums. `emit` is called with the headers and
+  //! the payload slice of each datagram, in order; the headers' storage is reused from one call to the next.
+  void segment_tcp_in_ip( const TCPMessage& msg,
+                          std::string& headers,
+                          const FunctionRef<void( std::string_view, std::string_view )>& emit );
+
+  //! Segmentation offload for the connection `tuple`, cutting payloads to `mss` (rather than the configured ones)
+  static void segment_tcp_in_ip( const TCPFourTuple& tuple,
+                                 size_t mss,
+                                 const TCPMessage& msg,
+                                 std::string& headers,
+                                 const FunctionRef<void( std::string_view, std::string_view )>& emit );
+
+private:
+  //! The configured connection's four-tuple
+  TCPFourTuple config_tuple() const;
+
+  static void wrap_headers( const TCPFourTuple& tuple,
+                            const TCPSenderMessage& sender,
+                            const TCPReceiverMessage& receiver,
+                            std::string_view payload,
+                            std::string& headers );
 };
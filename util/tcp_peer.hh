@@ -1,5 +1,7 @@
 #pragma once
 
+#include "ipv4_header.hh"
+#include "memory_budget.hh"
 #include "tcp_config.hh"
 #include "tcp_receiver.hh"
 #include "tcp_receiver_message.hh"
@@ -7,8 +9,18 @@
 #include "tcp_sender.hh"
 #include "tcp_sender_message.hh"
 
-#include <functional>
+#include <algorithm>
+#include <concepts>
 #include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* Type of the `transmit` function that TCPPeer uses to send messages: it is given a batch of messages
+ * (in order) that should be serialized and written out together */
+template<class T>
+concept TCPTransmitFunction = std::invocable<const T&, std::span<const TCPMessage>>;
 
 class TCPPeer
 {
@@ -18,27 +30,152 @@ class TCPPeer
   }
 
 public:
-  explicit TCPPeer( const TCPConfig& cfg ) : cfg_( cfg ) {}
+  explicit TCPPeer( const TCPConfig& cfg ) : cfg_( cfg )
+  {
+    sender_.set_coalescing( cfg_.coalescing );
+    sender_.set_offload_size( cfg_.offload_size );
+    sender_.set_repacketize( cfg_.repacketize );
+    sender_.set_sws_avoidance( cfg_.sws_avoidance );
+    sender_.set_ecn( cfg_.ecn );
+  }
 
   Writer& outbound_writer() { return sender_.writer(); }
   Reader& inbound_reader() { return receiver_.reader(); }
 
-  /* Type of the `transmit` function that the push and tick methods can use to send messages */
-  using TransmitFunction = std::function<void( TCPMessage )>;
-
   /* Passthrough methods */
-  void push( const TransmitFunction& transmit ) { sender_.push( make_send( transmit ) ); }
-  void tick( uint64_t t, const TransmitFunction& transmit )
+  void push( const TCPTransmitFunction auto& transmit )
+  {
+    // Let the sender build messages directly into the outbox, and hand them to `transmit` one batch at a time.
+    // The outbox starts with one slot, and doubles (up to MAX_BATCH) each time a batch fills it.
+    if ( outbox_.empty() ) {
+      outbox_.resize( 1 );
+    }
+    while ( true ) {
+      const size_t count = sender_.push( outbox_ );
+      send_batch( std::span { outbox_ }.first( count ), transmit );
+      if ( count < outbox_.size() or outbox_[count - 1].RST ) {
+        break;
+      }
+      outbox_.resize( std::min( 2 * outbox_.size(), MAX_BATCH ) );
+    }
+  }
+
+  void tick( uint64_t t, const TCPTransmitFunction auto& transmit )
   {
     cumulative_time_ += t;
     sender_.tick( t, make_send( transmit ) );
+    if ( has_ackno() ) {
+      push( transmit ); // a corked segment may have timed out (but a passive peer must not open the connection)
+    }
+
+    // A delayed ACK that nothing outgoing has carried yet is sent on its own once the timer runs out.
+    ack_delay_elapsed_ms_ += t;
+    if ( ack_pending_ and ack_delay_elapsed_ms_ >= cfg_.ack_delay ) {
+      send( sender_.make_empty_message(), transmit );
+    }
+    autotune_buffers( transmit );
+    send_window_update( transmit );
+    release_idle_buffers();
+  }
+
+  /*
+   * How long until tick() has something to do: the next of the sender's timers, the delayed ACK, the end of
+   * lingering, or shrinking autotuned buffers back after idling. Nothing if no timer is running, so that an idle
+   * connection need not be ticked at all until its next event. (tick() also samples the receive-side RTT for
+   * autotuning; an event loop that ticks a connection before each of its events keeps that sampling going.)
+   */
+  std::optional<uint64_t> ms_until_next_timer() const
+  {
+    std::optional<uint64_t> next = sender_.ms_until_next_timer();
+    const auto consider = [&]( uint64_t deadline ) {
+      if ( deadline > cumulative_time_ ) {
+        next = std::min( next.value_or( UINT64_MAX ), deadline - cumulative_time_ );
+      }
+    };
+    if ( ack_pending_ and ack_delay_elapsed_ms_ < cfg_.ack_delay ) {
+      consider( cumulative_time_ + cfg_.ack_delay - ack_delay_elapsed_ms_ );
+    }
+    const bool streams_finished = sender_.sequence_numbers_in_flight() == 0 and sender_.reader().is_finished()
+                                  and receiver_.writer().is_closed();
+    if ( linger_after_streams_finish_ and streams_finished and not has_error() ) {
+      consider( time_of_last_receipt_ + 10UL * cfg_.rt_timeout );
+    }
+    const bool tuned_up = ( cfg_.send_capacity_max > cfg_.send_capacity
+                            and sender_.writer().capacity() > cfg_.send_capacity )
+                          or ( cfg_.recv_capacity_max > cfg_.recv_capacity
+                               and receiver_.reader().capacity() > cfg_.recv_capacity );
+    if ( tuned_up ) {
+      consider( time_of_last_receipt_ + TCPConfig::BUFFER_IDLE_TIMEOUT );
+    }
+    if ( not buffers_released_ and streams_drained() and holds_buffers() ) {
+      consider( time_of_last_receipt_ + TCPConfig::BUFFER_RELEASE_TIMEOUT );
+    }
+    return next;
+  }
+
+  /* Small-write coalescing overrides (like TCP_NODELAY and TCP_CORK); call push() afterwards to flush */
+  void set_nodelay( bool nodelay ) { sender_.set_nodelay( nodelay ); }
+  void set_cork( bool cork ) { sender_.set_cork( cork ); }
+
+  /*
+   * TCP Fast Open (RFC 7413). A client calls set_fast_open() before its first push(): with a cookie from an
+   * earlier connection to the same server, the bytes already written go out with the SYN; with an empty one, the
+   * SYN asks for a cookie, which fast_open_cookie() returns once the server's SYN has arrived. A server calls
+   * accept_fast_open() before the client's SYN arrives, with the cookie it expects from that client: it grants
+   * the cookie to a client that asks for one, and accepts the data of a SYN that presents it.
+   */
+  void set_fast_open( std::string cookie ) { sender_.set_fast_open( std::move( cookie ) ); }
+  void accept_fast_open( const std::string& cookie )
+  {
+    receiver_.set_fast_open_cookie( cookie );
+    fast_open_grant_ = cookie;
+  }
+  const std::optional<std::string>& fast_open_cookie() const { return fast_open_cookie_; }
+
+  /*
+   * Memory used by the connection (in bytes): the TCPPeer itself, and everything it holds on the heap. The
+   * stream buffers are allocated only as bytes are buffered and freed once drained, so an idle connection
+   * costs little more than sizeof( TCPPeer ).
+   */
+  uint64_t memory_usage() const
+  {
+    uint64_t total = sizeof( *this ) + sender_.memory_usage() + receiver_.memory_usage();
+    total += outbox_.capacity() * sizeof( TCPSenderMessage ) + batch_.capacity() * sizeof( TCPMessage );
+    for ( const auto& msg : outbox_ ) {
+      total += string_memory_usage( msg.payload );
+    }
+    total += fast_open_cookie_ ? string_memory_usage( *fast_open_cookie_ ) : 0;
+    total += fast_open_grant_ ? string_memory_usage( *fast_open_grant_ ) : 0;
+    return total;
+  }
+
+  /* Advertise a reopened receive window if the application has drained enough of the inbound stream */
+  void send_window_update( const TCPTransmitFunction auto& transmit )
+  {
+    release_idle_buffers(); // (the application may have just read the end of the inbound stream)
+    if ( not receiver_.send().ackno.has_value() or receiver_.writer().is_closed() ) {
+      return;
+    }
+
+    // The peer's view of our window: what is left of the last advertisement.
+    const uint64_t bytes_pushed = receiver_.writer().bytes_pushed();
+    const uint64_t remaining = window_right_edge_ > bytes_pushed ? window_right_edge_ - bytes_pushed : 0;
+
+    // RFC 9293 3.8.6.2.2: only announce an increase of at least min(MSS, capacity / 2), and only once the peer
+    // is running out of window -- or, as Linux does, once the window would at least double, so that a burst the
+    // application drained at once does not hold the sender to the old window for another round trip.
+    const uint64_t threshold = std::min<uint64_t>( cfg_.mss, receiver_.reader().capacity() / 2 );
+    const uint64_t window = receiver_.send().window_size;
+    if ( ( remaining < threshold or window >= 2 * remaining ) and window >= remaining + threshold ) {
+      send( sender_.make_empty_message(), transmit );
+    }
   }
   bool has_ackno() const { return receiver_.send().ackno.has_value(); }
 
   /* Is the peer still active? */
   bool active() const
   {
-    const bool any_errors = receiver_.reader().has_error() or sender_.writer().has_error();
+    const bool any_errors = has_error();
     const bool sender_active = sender_.sequence_numbers_in_flight() or not sender_.reader().is_finished();
     const bool receiver_active = not receiver_.writer().is_closed();
     const bool lingering
@@ -47,59 +184,397 @@ public:
     return ( not any_errors ) and ( sender_active or receiver_active or lingering );
   }
 
-  void receive( TCPMessage msg, const TransmitFunction& transmit )
+  void receive( TCPMessage msg, const TCPTransmitFunction auto& transmit )
   {
+    ++segments_received_;
+    if ( receive_predicted( msg, transmit ) ) {
+      ++fast_path_hits_;
+      return;
+    }
+
     if ( not active() ) {
+      predict_ = false;
       return;
     }
 
     // Record time in case this peer has to linger after streams finish.
     time_of_last_receipt_ = cumulative_time_;
 
-    // If SenderMessage occupies a sequence number, make sure to reply.
-    need_send_ |= ( msg.sender->sequence_length() > 0 );
-
     // If SenderMessage is a "keep-alive" (with intentionally invalid seqno), make sure to reply.
     // (N.B. orthodox TCP rules require a reply on any unacceptable segment.)
-    const auto our_ackno = receiver_.send().ackno;
+    const auto our_ackno = receiver_.ackno();
     need_send_ |= ( our_ackno.has_value() and msg.sender->seqno + 1 == our_ackno.value() );
 
+    // If SenderMessage occupies a sequence number, make sure to reply. Only in-order data that leaves no hole
+    // behind may wait for a delayed ACK (RFC 9293 3.8.6.3); the handshake, the FIN, out-of-order data and data
+    // filling a hole are acknowledged at once (RFC 5681 4.2).
+    if ( msg.sender->sequence_length() > 0 ) {
+      const bool in_order = our_ackno.has_value() and msg.sender->seqno == our_ackno.value()
+                            and receiver_.reassembler().count_bytes_pending() == 0;
+      const bool congested = msg.sender->ecn == IPv4Header::ECN_CE; // echo a congestion mark without delay
+      schedule_ack( msg.sender->SYN or msg.sender->FIN or not in_order or congested, msg.sender->payload.size() );
+    }
+
+    // ECN negotiation (RFC 3168 6.1.1): an ECN-setup SYN carries ECE and CWR, and a SYN-ACK that agrees, only ECE.
+    if ( ecn_ and msg.sender->SYN and not has_ackno() ) {
+      const bool syn_ack = msg.receiver->ackno.has_value();
+      const bool agreed = msg.receiver->ECE and ( syn_ack ? not msg.sender->CWR : msg.sender->CWR );
+      if ( not agreed ) {
+        ecn_ = false;
+        sender_.set_ecn( false );
+      }
+    }
+
+    // TCP Fast Open: a server answers a SYN with the option by granting its cookie; a client keeps the one granted.
+    if ( msg.sender->SYN and msg.sender->fast_open.has_value() ) {
+      if ( fast_open_grant_.has_value() ) {
+        sender_.grant_fast_open( fast_open_grant_.value() );
+      } else if ( not msg.sender->fast_open->empty() ) {
+        fast_open_cookie_ = msg.sender->fast_open;
+      }
+    }
+
     // Give incoming TCPSenderMessage to receiver.
     receiver_.receive( std::move( msg.sender ) );
 
     // Give incoming TCPReceiverMessage to sender.
     sender_.receive( msg.receiver );
 
-    // Send reply if needed.
-    push( transmit );
-    if ( need_send_ ) {
-      send( sender_.make_empty_message(), transmit );
-    }
+    reply( transmit );
 
     // Did the inbound stream finish before the outbound stream? If so, no need to linger after streams finish.
     if ( receiver_.writer().is_closed() and not std::as_const( sender_ ).reader().is_finished() ) {
       linger_after_streams_finish_ = false;
     }
+
+    // Predict that the next segment continues an established connection in the same way.
+    predict_ = has_ackno() and not receiver_.writer().is_closed() and msg.receiver->ackno.has_value()
+               and not msg.receiver->RST and msg.receiver->window_size > 0 and not has_error();
+    last_ack_ = msg.receiver;
+    release_idle_buffers();
+  }
+
+  /*
+   * Receive-side coalescing (software GRO): receive a batch of messages that arrived together (e.g. in one
+   * event-loop iteration), first merging each run of consecutive in-order data segments that carry the same
+   * acknowledgment and window into one larger message. The receiver, the Reassembler and the ACK decision
+   * then run once per run instead of once per segment. The messages in `batch` are consumed.
+   */
+  void receive_batch( std::span<TCPMessage> batch, const TCPTransmitFunction auto& transmit )
+  {
+    for ( size_t i = 0; i < batch.size(); ) {
+      TCPMessage& merged = batch[i];
+      size_t next = i + 1;
+      for ( ; next < batch.size() and can_coalesce( merged, batch[next] ); ++next ) {
+        if ( merged.sender.is_borrowed() ) {
+          merged.sender = merged.sender.release(); // copy the first segment so that it can be extended
+        }
+        TCPSenderMessage& seg = merged.sender;
+        seg.payload.append( batch[next].sender->payload );
+        seg.FIN = batch[next].sender->FIN;
+      }
+      receive( std::move( merged ), transmit );
+      i = next;
+    }
   }
 
+  // Header prediction statistics: segments received, and how many of them took the fast path
+  uint64_t segments_received() const { return segments_received_; }
+  uint64_t fast_path_hits() const { return fast_path_hits_; }
+
   // Testing interface
   const TCPReceiver& receiver() const { return receiver_; }
   const TCPSender& sender() const { return sender_; }
 
 private:
   TCPConfig cfg_;
-  TCPSender sender_ { ByteStream { cfg_.send_capacity }, cfg_.isn, cfg_.rt_timeout };
+  TCPSender sender_ { ByteStream { cfg_.send_capacity }, cfg_.isn, cfg_.rt_timeout, cfg_.mss };
   TCPReceiver receiver_ { Reassembler { ByteStream { cfg_.recv_capacity } } };
 
   bool need_send_ {};
 
-  void send( const TCPSenderMessage& sender_message, const TransmitFunction& transmit )
+  bool ecn_ { cfg_.ecn }; // ECN requested, and not (yet) refused by the peer
+
+  std::optional<std::string> fast_open_grant_ {};  // (server) the cookie to grant and accept
+  std::optional<std::string> fast_open_cookie_ {}; // (client) the cookie granted by the server
+
+  // Header prediction: valid while the connection is established and error-free, with the last acknowledgment
+  // and window received from the peer (a segment repeating them does not concern the sender)
+  bool predict_ {};
+  TCPReceiverMessage last_ack_ {};
+  uint64_t segments_received_ {};
+  uint64_t fast_path_hits_ {};
+
+  bool has_error() const { return receiver_.reader().has_error() or sender_.writer().has_error(); }
+
+  /*
+   * Header prediction (after Van Jacobson): handle the two common segments of an established connection
+   * directly, and return true. One is the next in-order data, acknowledging nothing new: only the receiver
+   * is involved, and the payload goes straight to the inbound stream. The other is a pure ACK for new data:
+   * only the sender is involved. Anything else (flags, an ECN echo, data with a new acknowledgment or window, a
+   * gap, a zero window, ...) returns false and takes the general path.
+   */
+  bool receive_predicted( TCPMessage& msg, const TCPTransmitFunction auto& transmit )
+  {
+    const TCPSenderMessage& seg = msg.sender;
+    const TCPReceiverMessage& ack = msg.receiver;
+    if ( not predict_ or seg.SYN or seg.FIN or seg.RST or seg.CWR or seg.ecn == IPv4Header::ECN_CE or ack.RST
+         or ack.ECE or ack.window_size == 0 or not ack.ackno.has_value() or has_error() ) {
+      return false;
+    }
+
+    // (The sender processes the whole acknowledgment, so a pure ACK may also move the window.)
+    if ( seg.payload.empty() ) {
+      if ( ack.ackno == last_ack_.ackno or seg.seqno != receiver_.ackno() ) {
+        return false;
+      }
+      sender_.receive( ack );
+      last_ack_ = ack;
+      time_of_last_receipt_ = cumulative_time_;
+      push( transmit );
+      return true;
+    }
+
+    if ( ack.ackno != last_ack_.ackno or ack.window_size != last_ack_.window_size or msg.sender.is_borrowed() ) {
+      return false;
+    }
+    const size_t length = seg.payload.size();
+    if ( not receiver_.receive_in_order( msg.sender.get_mut() ) ) {
+      return false;
+    }
+    time_of_last_receipt_ = cumulative_time_;
+    schedule_ack( false, length );
+    reply( transmit );
+    return true;
+  }
+
+  // Note a received segment that occupies sequence space: acknowledge it at once, or (delayed ACK) soon
+  void schedule_ack( bool immediately, size_t payload_size )
+  {
+    if ( immediately or cfg_.ack_delay == 0 ) {
+      need_send_ = true;
+    } else if ( not ack_pending_ ) {
+      ack_pending_ = true;
+      ack_delay_elapsed_ms_ = 0;
+    }
+    bytes_since_ack_ += payload_size;
+  }
+
+  // Send reply if needed. Outgoing data carries the ACK; otherwise acknowledge at least every second
+  // full-sized segment's worth of data.
+  void reply( const TCPTransmitFunction auto& transmit )
+  {
+    push( transmit );
+    need_send_ |= ack_pending_ and bytes_since_ack_ >= 2 * cfg_.mss;
+    if ( need_send_ ) {
+      send( sender_.make_empty_message(), transmit );
+    }
+  }
+
+  // Delayed ACK: in-order data received since the last message we sent, and how long it has waited
+  bool ack_pending_ {};
+  uint64_t ack_delay_elapsed_ms_ {};
+  uint64_t bytes_since_ack_ {};
+
+  // Messages built by the sender and the batch handed to `transmit`; both are reused to avoid allocation, and
+  // both grow only as large as the batches actually sent (a single message needs no batch storage at all).
+  static constexpr size_t MAX_BATCH = 16;
+  std::vector<TCPSenderMessage> outbox_ {};
+  std::vector<TCPMessage> batch_ {};
+
+  void send( const TCPSenderMessage& sender_message, const TCPTransmitFunction auto& transmit )
+  {
+    send_batch( std::span { &sender_message, 1 }, transmit );
+  }
+
+  // Pair each sender message with a single (shared) receiver message, and transmit them together.
+  void send_batch( std::span<const TCPSenderMessage> sender_messages, const TCPTransmitFunction auto& transmit )
   {
-    transmit( { .sender = borrow( sender_message ), .receiver = receiver_.send() } );
+    if ( sender_messages.empty() ) {
+      return;
+    }
+
+    TCPReceiverMessage receiver_message = receiver_.send();
+    receiver_message.ECE = ecn_ and ( receiver_message.ECE or sender_messages.front().SYN ); // (SYN: ECN setup)
+    const uint64_t bytes_pushed = receiver_.writer().bytes_pushed();
+    const uint64_t remaining = window_right_edge_ > bytes_pushed ? window_right_edge_ - bytes_pushed : 0;
+    // Never move the right edge back (RFC 9293 3.8.6.2.2). Under memory pressure, TCPReceiver::send() offers no
+    // more than the memory the stream already holds, but the Reassembler still accepts all that fits in the
+    // stream, so what was offered before stays offered.
+    receiver_message.window_size = std::max<uint64_t>(
+      receiver_message.window_size, std::min( remaining, receiver_.writer().available_capacity() ) );
+    if ( cfg_.sws_avoidance ) {
+      // Receiver-side SWS avoidance (RFC 1122 4.2.3.3): keep the right edge where it was until it can move
+      // by at least min(MSS, capacity / 2); send_window_update() announces it once it can.
+      const uint64_t threshold = std::min<uint64_t>( cfg_.mss, receiver_.reader().capacity() / 2 );
+      if ( receiver_message.window_size > remaining and receiver_message.window_size < remaining + threshold ) {
+        receiver_message.window_size = remaining;
+      }
+    }
+    window_right_edge_ = bytes_pushed + receiver_message.window_size;
+
+    if ( sender_messages.size() == 1 ) {
+      const TCPMessage message { .sender = borrow( sender_messages.front() ), .receiver = borrow( receiver_message ) };
+      transmit( std::span { &message, 1 } );
+    } else {
+      batch_.clear();
+      for ( const auto& sender_message : sender_messages ) {
+        batch_.push_back( { .sender = borrow( sender_message ), .receiver = borrow( receiver_message ) } );
+      }
+      transmit( std::span<const TCPMessage> { batch_ } );
+      batch_.clear();
+    }
     need_send_ = false;
+    ack_pending_ = false;
+    bytes_since_ack_ = 0;
+  }
+
+  uint64_t window_right_edge_ {}; // stream index just past the last window we advertised
+
+  // Can `next` be appended to `merged`? Only plain data segments that follow each other exactly, carrying the
+  // same acknowledgment, window and ECN marks, are merged (a FIN may end the run), up to the largest IP payload.
+  static bool can_coalesce( const TCPMessage& merged, const TCPMessage& next )
+  {
+    const TCPSenderMessage& a = merged.sender;
+    const TCPSenderMessage& b = next.sender;
+    const TCPReceiverMessage& a_ack = merged.receiver;
+    const TCPReceiverMessage& b_ack = next.receiver;
+    return not( a.SYN or a.FIN or a.RST or b.SYN or b.RST ) and not a.payload.empty() and not b.payload.empty()
+           and b.seqno == a.seqno + static_cast<uint32_t>( a.payload.size() )
+           and a.payload.size() + b.payload.size() <= UINT16_MAX and a_ack.ackno == b_ack.ackno
+           and a_ack.window_size == b_ack.window_size and a_ack.RST == b_ack.RST and a_ack.ECE == b_ack.ECE
+           and a.ecn == b.ecn and not b.CWR;
+  }
+
+  // Buffer autotuning (when TCPConfig::recv_capacity_max or send_capacity_max is set)
+  uint64_t rcv_rtt_ms_ {};       // receive-side RTT estimate: how long one advertised window takes to arrive
+  uint64_t rcv_rtt_start_ms_ {}; // when the current measurement started
+  uint64_t rcv_rtt_end_ {};      // stream index that ends the current measurement (0 if none is running)
+  uint64_t copied_start_ms_ {};  // when the current RTT's count of bytes read by the application started
+  uint64_t copied_start_ {};     // bytes popped from the inbound stream at that time
+  uint64_t copied_space_ {};     // most bytes the application has read in one RTT
+
+  /*
+   * Right-size the buffers (like Linux's receive buffer autotuning). The receive capacity grows to twice what
+   * the application read in an RTT, whenever that is a new maximum, so that the window never limits a reader
+   * that keeps up; the send capacity tracks the peer's window. Both are capped by their ceilings, and shrink
+   * back to the configured capacities after TCPConfig::BUFFER_IDLE_TIMEOUT without traffic.
+   */
+  void autotune_buffers( const TCPTransmitFunction auto& transmit )
+  {
+    const bool tune_recv = cfg_.recv_capacity_max > cfg_.recv_capacity;
+    const bool tune_send = cfg_.send_capacity_max > cfg_.send_capacity;
+    if ( not tune_recv and not tune_send ) {
+      return;
+    }
+
+    Reader& inbound = receiver_.reader();
+    Writer& outbound = sender_.writer();
+    const bool idle = cumulative_time_ >= time_of_last_receipt_ + TCPConfig::BUFFER_IDLE_TIMEOUT
+                      and sender_.sequence_numbers_in_flight() == 0
+                      and std::as_const( sender_ ).reader().bytes_buffered() == 0;
+    if ( idle ) {
+      if ( tune_send ) {
+        outbound.set_capacity( cfg_.send_capacity );
+      }
+      // (The receive capacity never shrinks below what the window we advertised still needs.)
+      const uint64_t pushed = receiver_.writer().bytes_pushed();
+      const uint64_t advertised = window_right_edge_ > pushed ? window_right_edge_ - inbound.bytes_popped() : 0;
+      const uint64_t recv_target = std::max( cfg_.recv_capacity, advertised );
+      if ( tune_recv and inbound.capacity() > recv_target ) {
+        inbound.set_capacity( recv_target );
+        copied_space_ = 0;
+        rcv_rtt_end_ = 0;
+        if ( has_ackno() and not receiver_.writer().is_closed() ) {
+          send( sender_.make_empty_message(), transmit ); // the peer has nothing in flight; tell it the new window
+        }
+      }
+      return;
+    }
+
+    if ( tune_send ) {
+      const uint64_t target = std::min<uint64_t>( cfg_.send_capacity_max,
+                                                  TCPConfig::SEND_BUFFER_FACTOR * sender_.peer_window() );
+      if ( target > outbound.capacity() ) {
+        outbound.set_capacity( target );
+      }
+    }
+
+    if ( not tune_recv or not has_ackno() or receiver_.writer().is_closed() ) {
+      return;
+    }
+
+    // Time how long it takes for the data to reach the right edge of the window we advertised.
+    const uint64_t bytes_pushed = receiver_.writer().bytes_pushed();
+    if ( rcv_rtt_end_ == 0 ) {
+      if ( window_right_edge_ > bytes_pushed ) {
+        rcv_rtt_start_ms_ = cumulative_time_;
+        rcv_rtt_end_ = window_right_edge_;
+      }
+    } else if ( bytes_pushed >= rcv_rtt_end_ ) {
+      const uint64_t sample = std::max<uint64_t>( cumulative_time_ - rcv_rtt_start_ms_, 1 );
+      rcv_rtt_ms_ = rcv_rtt_ms_ == 0 ? sample : ( 7 * rcv_rtt_ms_ + sample ) / 8;
+      rcv_rtt_end_ = 0;
+    }
+
+    // Once per RTT, see how much the application read.
+    if ( rcv_rtt_ms_ > 0 and cumulative_time_ >= copied_start_ms_ + rcv_rtt_ms_ ) {
+      const uint64_t copied = inbound.bytes_popped() - copied_start_;
+      if ( copied > copied_space_ ) {
+        copied_space_ = copied;
+        const uint64_t target = std::min<uint64_t>( cfg_.recv_capacity_max, 2 * copied );
+        if ( target > inbound.capacity() ) {
+          inbound.set_capacity( target );
+        }
+      }
+      copied_start_ = inbound.bytes_popped();
+      copied_start_ms_ = cumulative_time_;
+    }
   }
 
   bool linger_after_streams_finish_ { true }; // one peer may need to linger to make sure all closure conditions met
   uint64_t cumulative_time_ {};
   uint64_t time_of_last_receipt_ {};
+
+  /*
+   * Once the outbound stream has been sent and acknowledged to its end, and the inbound stream received and read
+   * to its end, all that the rest of the connection (its lingering, like TIME_WAIT) needs is the sequence numbers
+   * and timers. Free the streams' buffers and the reusable message storage then, rather than holding them for
+   * 10 * rt_timeout; at a high rate of new connections, lingering ones would otherwise hold most of the memory.
+   *
+   * An open connection whose streams are drained (all sent bytes acknowledged, all received bytes read) frees
+   * them too, once nothing has arrived for BUFFER_RELEASE_TIMEOUT: the streams allocate again only when there
+   * are bytes to hold, so an idle connection costs little more than the TCPPeer itself. (Freeing them whenever
+   * a stream drains would cost a busy connection an allocation for nearly every read.) Past the hard limit of
+   * the process's MemoryBudget, they are freed as soon as the streams are drained.
+   */
+  bool buffers_released_ {};
+  bool streams_drained() const
+  {
+    return sender_.sequence_numbers_in_flight() == 0 and sender_.reader().bytes_buffered() == 0
+           and receiver_.reader().bytes_buffered() == 0 and receiver_.reassembler().count_bytes_pending() == 0;
+  }
+  bool holds_buffers() const
+  {
+    return sender_.reader().memory_usage() > 0 or receiver_.reader().memory_usage() > 0 or outbox_.size() > 1
+           or ( not outbox_.empty() and string_memory_usage( outbox_.front().payload ) > 0 )
+           or batch_.capacity() > 0;
+  }
+  void release_idle_buffers()
+  {
+    if ( buffers_released_ or not streams_drained() ) {
+      return;
+    }
+    const bool finished = std::as_const( sender_ ).reader().is_finished() and receiver_.reader().is_finished();
+    const bool waited = cumulative_time_ >= time_of_last_receipt_ + TCPConfig::BUFFER_RELEASE_TIMEOUT
+                        or MemoryBudget::process().pressure() == MemoryBudget::Pressure::Hard;
+    if ( not finished and ( not waited or not holds_buffers() ) ) {
+      return;
+    }
+    buffers_released_ = finished;
+    sender_.shrink_to_fit();
+    receiver_.shrink_to_fit();
+    std::vector<TCPSenderMessage> {}.swap( outbox_ );
+    std::vector<TCPMessage> {}.swap( batch_ );
+  }
 };
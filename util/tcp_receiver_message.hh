@@ -17,6 +17,9 @@
  *    the <cstdint> header).
  *
  * 3) The RST (reset) flag. If set, the stream has suffered an error and the connection should be aborted.
+ *
+ * 4) The ECE (ECN-Echo) flag (RFC 3168). If set, the receiver has seen a datagram marked Congestion Experienced
+ *    and the sender should reduce its congestion window. On a SYN, it asks for (or agrees to) ECN.
  */
 
 struct TCPReceiverMessage
@@ -24,4 +27,5 @@ struct TCPReceiverMessage
   std::optional<Wrap32> ackno {};
   uint16_t window_size {};
   bool RST {};
+  bool ECE {};
 };
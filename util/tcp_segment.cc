@@ -40,6 +40,8 @@ void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum
     message.receiver->ackno.reset(); // no ACK
   }
 
+  message.sender->CWR = octet & 0b1000'0000;
+  message.receiver->ECE = octet & 0b0100'0000;
   message.sender->RST = message.receiver->RST = octet & 0b0000'0100;
   message.sender->SYN = octet & 0b0000'0010;
   message.sender->FIN = octet & 0b0000'0001;
@@ -48,12 +50,40 @@ void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum
   parser.integer( udinfo.cksum );
   parser.integer( raw16 ); // urgent pointer
 
-  // skip any options or anything extra in the header
   if ( data_offset < ( HEADER_LENGTH >> 2 ) ) {
     parser.set_error();
     return;
   }
-  parser.remove_prefix( ( data_offset * 4 ) - HEADER_LENGTH );
+
+  // options: keep a Fast Open cookie, skip anything else
+  message.sender->fast_open.reset();
+  size_t options_length = ( data_offset * 4 ) - HEADER_LENGTH;
+  while ( options_length > 0 and not parser.has_error() ) {
+    uint8_t kind {};
+    parser.integer( kind );
+    options_length--;
+    if ( kind == 0 ) { // end of option list
+      break;
+    }
+    if ( kind == 1 ) { // no-operation (padding)
+      continue;
+    }
+
+    uint8_t length {};
+    parser.integer( length );
+    if ( length < 2 or length - 1U > options_length ) {
+      parser.set_error();
+      return;
+    }
+    options_length -= length - 1U;
+    if ( kind == OPTION_FAST_OPEN and message.sender->SYN and length - 2U <= FAST_OPEN_COOKIE_MAX_LENGTH ) {
+      message.sender->fast_open.emplace( length - 2U, 0 );
+      parser.string( message.sender->fast_open.value() );
+    } else {
+      parser.remove_prefix( length - 2U );
+    }
+  }
+  parser.remove_prefix( options_length );
 
   parser.concatenate_all_remaining( message.sender->payload );
 }
@@ -65,20 +95,46 @@ public:
 };
 
 void TCPSegment::serialize( Serializer& serializer ) const
+{
+  serialize_header( serializer );
+  serializer.buffer( message.sender->payload );
+}
+
+void TCPSegment::serialize_header( Serializer& serializer ) const
 {
   serializer.integer( udinfo.src_port );
   serializer.integer( udinfo.dst_port );
   serializer.integer( Wrap32Serializable { message.sender->seqno }.raw_value() );
   serializer.integer( Wrap32Serializable { message.receiver->ackno.value_or( Wrap32 { 0 } ) }.raw_value() );
-  serializer.integer( uint8_t { ( HEADER_LENGTH >> 2 ) << 4 } ); // data offset
+  serializer.integer( static_cast<uint8_t>( ( header_length() >> 2 ) << 4 ) ); // data offset
   const bool reset = message.sender->RST or message.receiver->RST;
-  const uint8_t flags = ( message.receiver->ackno.has_value() ? 0b0001'0000U : 0 ) | ( reset ? 0b0000'0100U : 0 )
+  const uint8_t flags = ( message.sender->CWR ? 0b1000'0000U : 0 ) | ( message.receiver->ECE ? 0b0100'0000U : 0 )
+                        | ( message.receiver->ackno.has_value() ? 0b0001'0000U : 0 ) | ( reset ? 0b0000'0100U : 0 )
                         | ( message.sender->SYN ? 0b0000'0010U : 0 ) | ( message.sender->FIN ? 0b0000'0001U : 0 );
   serializer.integer( flags );
   serializer.integer( message.receiver->window_size );
   serializer.integer( udinfo.cksum );
   serializer.integer( uint16_t { 0 } ); // urgent pointer
-  serializer.buffer( message.sender->payload );
+
+  if ( message.sender->fast_open.has_value() ) {
+    const std::string& cookie = message.sender->fast_open.value();
+    serializer.integer( OPTION_FAST_OPEN );
+    serializer.integer( static_cast<uint8_t>( 2 + cookie.size() ) );
+    for ( const char c : cookie ) {
+      serializer.integer( static_cast<uint8_t>( c ) );
+    }
+    for ( size_t pad = 2 + cookie.size(); pad % 4; pad++ ) {
+      serializer.integer( uint8_t { 0 } ); // end of option list
+    }
+  }
+}
+
+size_t TCPSegment::header_length() const
+{
+  if ( not message.sender->fast_open.has_value() ) {
+    return HEADER_LENGTH;
+  }
+  return HEADER_LENGTH + ( ( 2 + message.sender->fast_open->size() + 3 ) & ~size_t { 3 } );
 }
 
 void TCPSegment::compute_checksum( uint32_t datagram_layer_pseudo_checksum )
@@ -103,12 +159,21 @@ string TCPSegment::to_string() const
   if ( not message.sender->payload.empty() ) {
     ss << " payload=\"" << pretty_print( message.sender->payload ) << "\"";
   }
+  if ( message.sender->fast_open.has_value() ) {
+    ss << " TFO<" << pretty_print( message.sender->fast_open.value() ) << ">";
+  }
   if ( message.sender->FIN ) {
     ss << " +FIN";
   }
   if ( message.sender->RST or message.receiver->RST ) {
     ss << " +RST";
   }
+  if ( message.sender->CWR ) {
+    ss << " +CWR";
+  }
+  if ( message.receiver->ECE ) {
+    ss << " +ECE";
+  }
   auto ackno = message.receiver->ackno;
   if ( ackno.has_value() ) {
     ss << " ACK<" << Wrap32Serializable { *ackno }.raw_value() << ">";
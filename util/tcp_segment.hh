@@ -24,11 +24,18 @@ struct TCPSegment
 
   void parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum );
   void serialize( Serializer& serializer ) const;
+  void serialize_header( Serializer& serializer ) const; // everything except the payload
 
   void compute_checksum( uint32_t datagram_layer_pseudo_checksum );
 
   static constexpr uint8_t HEADER_LENGTH = 20; // TCP header length, not including options
 
+  static constexpr uint8_t OPTION_FAST_OPEN = 34;        // TCP Fast Open cookie option kind (RFC 7413)
+  static constexpr uint8_t FAST_OPEN_COOKIE_MAX_LENGTH = 16;
+
+  // TCP header length including options (a multiple of 4)
+  size_t header_length() const;
+
   // Return a string containing a summary in human-readable format
   std::string to_string() const;
 };
@@ -2,6 +2,7 @@
 
 #include "wrapping_integers.hh"
 
+#include <optional>
 #include <string>
 
 /*
@@ -20,6 +21,15 @@
  * 4) The FIN flag. If set, the payload represents the ending of the byte stream.
  *
  * 5) The RST (reset) flag. If set, the stream has suffered an error and the connection should be aborted.
+ *
+ * A SYN may also carry a TCP Fast Open option (RFC 7413), which is not part of the sequence space: an empty
+ * cookie asks the peer for one; on a SYN that answers another SYN, the cookie is granted to the peer; on a
+ * SYN with payload, it is the cookie that lets the receiver accept the payload before the handshake completes.
+ *
+ * Explicit Congestion Notification (RFC 3168) adds the CWR flag, set when the sender has reduced its congestion
+ * window in response to an ECN-Echo (or, on a SYN, to ask for ECN), and the ECN field of the IP header that
+ * carries the message, which is not part of TCP: the sender marks its data ECN-capable (ECT), and a router may
+ * change that to Congestion Experienced (CE) instead of dropping the datagram.
  */
 
 struct TCPSenderMessage
@@ -32,6 +42,11 @@ struct TCPSenderMessage
 
   bool RST {};
 
+  std::optional<std::string> fast_open {}; // TCP Fast Open cookie (SYN only)
+
+  bool CWR {};    // Congestion Window Reduced
+  uint8_t ecn {}; // ECN field of the IP header (IPv4Header::ECN_*)
+
   // How many sequence numbers does this segment use?
   size_t sequence_length() const { return SYN + payload.size() + FIN; }
 };
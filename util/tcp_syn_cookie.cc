@@ -0,0 +1,57 @@
+#include "tcp_syn_cookie.hh"
+#include "random.hh"
+
+using namespace std;
+
+namespace {
+uint32_t raw( Wrap32 seqno )
+{
+  return static_cast<uint32_t>( seqno.unwrap( Wrap32 { 0 }, 0 ) );
+}
+
+// Layout of a cookie: 5 bits of timestamp, 1 bit for ECN, and 26 bits of hash
+constexpr uint32_t TIME_SHIFT = 27;
+constexpr uint32_t TIME_MASK = 0x1f;
+constexpr uint32_t ECN_BIT = 1U << 26U;
+constexpr uint32_t HASH_MASK = ECN_BIT - 1;
+
+uint32_t cookie_hash( const array<uint64_t, 2>& key,
+                      const TCPFourTuple& tuple,
+                      uint32_t client_isn,
+                      bool ecn,
+                      uint64_t period )
+{
+  uint64_t hash = mix64( key[0] ^ tuple.hash() );
+  hash = mix64( hash ^ key[1] ^ ( uint64_t { client_isn } << 32U ) ^ ( period << 1U ) ^ uint64_t { ecn } );
+  return static_cast<uint32_t>( hash ) & HASH_MASK;
+}
+} // namespace
+
+SynCookieGenerator::SynCookieGenerator() : key_( random_key() ) {}
+
+Wrap32 SynCookieGenerator::cookie( const TCPFourTuple& tuple, Wrap32 client_isn, bool ecn, uint64_t now_ms ) const
+{
+  const uint64_t period = now_ms / PERIOD_MS;
+  const uint32_t time_bits = static_cast<uint32_t>( period & TIME_MASK ) << TIME_SHIFT;
+  return Wrap32 { time_bits | ( ecn ? ECN_BIT : 0 ) | cookie_hash( key_, tuple, raw( client_isn ), ecn, period ) };
+}
+
+//! \details The cookie carries only the low bits of its period, so it is checked against the current period
+//! and the one before (a cookie from any other period is rejected).
+optional<bool> SynCookieGenerator::check( const TCPFourTuple& tuple,
+                                          Wrap32 client_isn,
+                                          Wrap32 isn,
+                                          uint64_t now_ms ) const
+{
+  const uint32_t value = raw( isn );
+  const bool ecn = value & ECN_BIT;
+  const uint64_t now_period = now_ms / PERIOD_MS;
+  for ( uint64_t age = 0; age <= 1 and age <= now_period; age++ ) {
+    const uint64_t period = now_period - age;
+    if ( ( ( value >> TIME_SHIFT ) & TIME_MASK ) == ( period & TIME_MASK )
+         and ( value & HASH_MASK ) == cookie_hash( key_, tuple, raw( client_isn ), ecn, period ) ) {
+      return ecn;
+    }
+  }
+  return {};
+}
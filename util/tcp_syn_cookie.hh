@@ -0,0 +1,40 @@
+#pragma once
+
+#include "tcp_over_ip.hh"
+#include "wrapping_integers.hh"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+/*
+ * SYN cookies (RFC 4987 3.6).
+ *
+ * When a listener's queue of half-open connections is full, it can still answer a SYN without remembering it:
+ * the initial sequence number of its SYN-ACK is a cookie, a keyed hash of the four-tuple, the client's initial
+ * sequence number and a coarse timestamp. The ACK that completes the handshake acknowledges the cookie plus
+ * one, so the listener can check it and rebuild the connection then. Cookies expire after one to two periods.
+ */
+
+//! Computes and checks the SYN cookies of a listener
+class SynCookieGenerator
+{
+  std::array<uint64_t, 2> key_;
+
+public:
+  static constexpr uint64_t PERIOD_MS = 64000; //!< Granularity of the timestamp in a cookie
+
+  //! Use a random secret key
+  SynCookieGenerator();
+
+  //! Use the given secret key
+  explicit SynCookieGenerator( const std::array<uint64_t, 2>& key ) : key_( key ) {}
+
+  //! The initial sequence number for a SYN-ACK that answers a SYN with `client_isn` at time `now_ms`,
+  //! remembering whether the SYN asked for ECN
+  Wrap32 cookie( const TCPFourTuple& tuple, Wrap32 client_isn, bool ecn, uint64_t now_ms ) const;
+
+  //! Is `isn` a cookie that this generator issued recently, for a SYN with `client_isn` on `tuple`?
+  //! \returns whether that SYN asked for ECN, or nothing if `isn` is not a valid cookie
+  std::optional<bool> check( const TCPFourTuple& tuple, Wrap32 client_isn, Wrap32 isn, uint64_t now_ms ) const;
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+ * A hierarchical timing wheel (Varghese and Lauck, 1987; like the Linux kernel's timer wheel).
+ *
+ * Timers are kept in LEVELS wheels of SLOTS slots each. A slot of level 0 holds the timers due at one instant
+ * of the coming SLOTS; a slot of level 1, those due in one span of SLOTS instants after that; and so on, each
+ * level SLOTS times coarser than the one below. Adding a timer and advancing the time by one instant are O(1)
+ * (apart from the timers that expire, or move down a level as their time approaches), however many timers are
+ * waiting, so only the items whose timers expire are ever touched.
+ *
+ * Time is in whatever unit the caller counts in (TCPMinnowStack uses milliseconds). A timer cannot be
+ * cancelled: the caller ignores an expired timer that it no longer wants, e.g. by remembering when its item's
+ * current timer is due.
+ */
+template<class T>
+class TimerWheel
+{
+public:
+  static constexpr size_t SLOT_BITS = 6;
+  static constexpr size_t SLOTS = 1 << SLOT_BITS;
+  static constexpr size_t LEVELS = 4; //!< Timers further than SLOTS^LEVELS ahead are placed again later
+
+  //! Start the clock at `now`
+  explicit TimerWheel( uint64_t now ) : now_( now ) {}
+
+  uint64_t now() const { return now_; }
+
+  //! How many timers are waiting (including ones their callers no longer want)
+  size_t size() const { return size_; }
+
+  //! Add a timer for `item` that expires at time `when` (if that has passed already, at the next advance())
+  void schedule( uint64_t when, T item )
+  {
+    insert( Entry { when, std::move( item ) } );
+    ++size_;
+  }
+
+  //! Move the clock forward to `now`, calling `expire( when, item )` for each timer that expires by then
+  //! (in order of expiry time). `expire` may schedule more timers.
+  void advance( uint64_t now, const auto& expire )
+  {
+    fire( due_, expire );
+    while ( now_ < now ) {
+      if ( size_ == 0 ) {
+        now_ = now;
+        break;
+      }
+      ++now_;
+      cascade();
+      fire( due_, expire );
+      fire( slots_[0][now_ & MASK], expire );
+    }
+  }
+
+private:
+  static constexpr uint64_t MASK = SLOTS - 1;
+
+  struct Entry
+  {
+    uint64_t when;
+    T item;
+  };
+
+  uint64_t now_;
+  size_t size_ {};
+  std::array<std::array<std::vector<Entry>, SLOTS>, LEVELS> slots_ {};
+  std::vector<Entry> due_ {};    //!< Timers added for a time that had already come
+  std::vector<Entry> firing_ {}; //!< The timers being expired (storage is reused)
+
+  //! Place a timer in the finest level whose span around now_ includes its time
+  void insert( Entry&& entry )
+  {
+    if ( entry.when <= now_ ) {
+      due_.push_back( std::move( entry ) );
+      return;
+    }
+    for ( size_t level = 0; level < LEVELS; level++ ) {
+      const size_t span_bits = SLOT_BITS * ( level + 1 );
+      if ( ( entry.when >> span_bits ) == ( now_ >> span_bits ) ) {
+        slots_[level][( entry.when >> ( SLOT_BITS * level ) ) & MASK].push_back( std::move( entry ) );
+        return;
+      }
+    }
+    // Beyond the top level: park it in top-level slot 0, which comes round just as the top level starts its
+    // next turn (and holds no timer of this turn, since those are all in later slots than now_'s).
+    slots_[LEVELS - 1][0].push_back( std::move( entry ) );
+  }
+
+  //! Whenever a level comes round to its next slot, spread that slot's timers over the levels below
+  void cascade()
+  {
+    size_t top = 0;
+    while ( top + 1 < LEVELS and ( now_ & ( ( uint64_t { 1 } << ( SLOT_BITS * ( top + 1 ) ) ) - 1 ) ) == 0 ) {
+      ++top;
+    }
+    for ( size_t level = top; level > 0; level-- ) {
+      firing_.clear();
+      std::swap( firing_, slots_[level][( now_ >> ( SLOT_BITS * level ) ) & MASK] );
+      for ( auto& entry : firing_ ) {
+        insert( std::move( entry ) );
+      }
+    }
+  }
+
+  void fire( std::vector<Entry>& slot, const auto& expire )
+  {
+    if ( slot.empty() ) {
+      return;
+    }
+    firing_.clear();
+    std::swap( firing_, slot );
+    size_ -= firing_.size();
+    for ( auto& entry : firing_ ) {
+      expire( entry.when, std::move( entry.item ) );
+    }
+  }
+};
@@ -9,16 +9,19 @@ class TunTapFD : public FileDescriptor
 {
 public:
   //! Open an existing persistent [TUN or TAP
-  //! device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-  explicit TunTapFD( const std::string& devname, bool is_tun );
+  //! device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt). With `multi_queue`, attach one
+  //! more queue of a multi-queue device (each open attaches another).
+  explicit TunTapFD( const std::string& devname, bool is_tun, bool multi_queue = false );
 };
 
 //! A FileDescriptor to a [Linux TUN](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
 class TunFD : public TunTapFD
 {
 public:
-  //! Open an existing persistent [TUN device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-  explicit TunFD( const std::string& devname ) : TunTapFD( devname, true ) {}
+  //! Open an existing persistent [TUN device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt)
+  //! (or, with `multi_queue`, one more queue of one).
+  explicit TunFD( const std::string& devname, bool multi_queue = false ) : TunTapFD( devname, true, multi_queue )
+  {}
 };
 
 //! A FileDescriptor to a [Linux TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
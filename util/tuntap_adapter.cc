@@ -1,6 +1,8 @@
 #include "tuntap_adapter.hh"
 #include "helpers.hh"
 
+#include <array>
+
 using namespace std;
 
 optional<TCPMessage> TCPOverIPv4OverTunFdAdapter::read()
@@ -19,7 +21,47 @@ optional<TCPMessage> TCPOverIPv4OverTunFdAdapter::read()
 
 void TCPOverIPv4OverTunFdAdapter::write( const TCPMessage& seg )
 {
-  _tun.write( serialize( wrap_tcp_in_ip( seg ) ) );
+  write( span { &seg, 1 } );
+}
+
+//! \details Each datagram is serialized into the same reused header buffer and written with a single
+//! writev() of the headers and the (uncopied) payload. Segments longer than config().mss are cut into
+//! wire-sized datagrams here (segmentation offload). A TUN device takes exactly one datagram per write,
+//! so the batch still costs one system call per datagram, but nothing is allocated along the way.
+void TCPOverIPv4OverTunFdAdapter::write( span<const TCPMessage> batch )
+{
+  for ( const auto& seg : batch ) {
+    segment_tcp_in_ip( seg, _headers, [&]( string_view headers, string_view payload ) {
+      if ( payload.empty() ) {
+        _tun.write( headers );
+      } else {
+        _tun.write( array<string_view, 2> { headers, payload } );
+      }
+    } );
+  }
+}
+
+optional<InternetDatagram> IPv4OverTunFdDevice::read()
+{
+  vector<string> strs( 3 );
+  strs[0].resize( IPv4Header::LENGTH );
+  strs[1].resize( TCPSegment::HEADER_LENGTH );
+  _tun.read( strs );
+
+  InternetDatagram ip_dgram;
+  if ( parse( ip_dgram, move( strs ) ) ) {
+    return ip_dgram;
+  }
+  return {};
+}
+
+void IPv4OverTunFdDevice::write( string_view headers, string_view payload )
+{
+  if ( payload.empty() ) {
+    _tun.write( headers );
+  } else {
+    _tun.write( array<string_view, 2> { headers, payload } );
+  }
 }
 
 //! Specialize LossyFdAdapter to TCPOverIPv4OverTunFdAdapter
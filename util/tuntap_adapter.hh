@@ -6,12 +6,17 @@
 #include "tun.hh"
 
 #include <optional>
+#include <span>
+#include <string>
+#include <string_view>
 #include <utility>
 
 template<class T>
-concept TCPDatagramAdapter = requires( T a, TCPMessage seg ) {
+concept TCPDatagramAdapter = requires( T a, TCPMessage seg, std::span<const TCPMessage> batch ) {
   { a.write( seg ) } -> std::same_as<void>;
 
+  { a.write( batch ) } -> std::same_as<void>;
+
   { a.read() } -> std::same_as<std::optional<TCPMessage>>;
 };
 
@@ -20,6 +25,7 @@ class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter
 {
 private:
   TunFD _tun;
+  std::string _headers {}; //!< Serialized headers of the datagram being written (storage is reused)
 
 public:
   //! Construct from a TunFD
@@ -31,6 +37,9 @@ public:
   //! Creates an IPv4 datagram from a TCP segment and writes it to the TUN device
   void write( const TCPMessage& seg );
 
+  //! Creates IPv4 datagrams from a batch of TCP segments and writes them to the TUN device, in order
+  void write( std::span<const TCPMessage> batch );
+
   //! Access the underlying TUN device
   explicit operator TunFD&() { return _tun; }
 
@@ -41,5 +50,36 @@ public:
   FileDescriptor& fd() { return _tun; }
 };
 
+//! A source and sink of raw IPv4 datagrams, for a stack that demultiplexes them among many connections
+template<class T>
+concept IPv4DatagramDevice = requires( T d, std::string_view headers, std::string_view payload ) {
+  { d.read() } -> std::same_as<std::optional<InternetDatagram>>;
+
+  { d.write( headers, payload ) } -> std::same_as<void>;
+
+  { d.fd() } -> std::same_as<FileDescriptor&>;
+};
+
+//! \brief IPv4 datagrams of any connection, read from and written to a TUN device
+class IPv4OverTunFdDevice
+{
+private:
+  TunFD _tun;
+
+public:
+  //! Construct from a TunFD
+  explicit IPv4OverTunFdDevice( TunFD&& tun ) : _tun( std::move( tun ) ) {}
+
+  //! Attempts to read and parse an IPv4 datagram
+  std::optional<InternetDatagram> read();
+
+  //! Writes one datagram: serialized headers followed by the payload
+  void write( std::string_view headers, std::string_view payload );
+
+  //! Access underlying file descriptor
+  FileDescriptor& fd() { return _tun; }
+};
+
 static_assert( TCPDatagramAdapter<TCPOverIPv4OverTunFdAdapter> );
+static_assert( IPv4DatagramDevice<IPv4OverTunFdDevice> );
 static_assert( TCPDatagramAdapter<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>> );